@@ -3,7 +3,10 @@
 
 param(
     [switch]$Clean,
-    [switch]$Verbose
+    [switch]$Verbose,
+    [switch]$Bench,     # Add the 'B' parser benchmark command (erases the app area)
+    [switch]$Auth,      # Accept signed uploads only (BL_AUTH, key in src/bl_auth_key.h)
+    [switch]$Small      # 8KB bootloader, application at 0x2000 (BL_SMALL, see src/bl_shared.h)
 )
 
 $ErrorActionPreference = "Continue"
@@ -36,6 +39,24 @@ $CFLAGS = @(
     "-I`"$ScriptDir\mcc_generated_files`"",
     "-I`"$ScriptDir\mcc_generated_files\memory`""
 )
+if ($Bench) { $CFLAGS += "-DBL_BENCH" }
+if ($Auth) { $CFLAGS += "-DBL_AUTH" }
+if ($Small) { $CFLAGS += "-DBL_SMALL" }
+
+# Assembler flags (ivt_forward.s picks the application IVT base with .ifdef)
+$ASFLAGS = @()
+if ($Small) { $ASFLAGS += "-Wa,--defsym,BL_SMALL=1" }
+
+# MCC modules the bootloader never calls, and bl_spi.c (its only user,
+# bl_nor.c, is compiled out); left out of the 8KB image because the link
+# keeps every object (--no-gc-sections). bl_spi.c also defines the SPI1 ISR
+# that ivt_forward.s only references in the full build.
+$SmallExclude = @("spi1.c", "bl_spi.c", "tmr2.c", "ext_int.c", "system.c", "example_mcc_usb_cdc.c")
+
+# Highest program memory address the image may use (BL_SERIAL_ADDRESS - 1:
+# the serial number words sit right below the application, and the first
+# boot programs them over whatever is there)
+$ImageLimit = if ($Small) { 0x1FF7 } else { 0x3FF7 }
 
 # Ensure XC16 is available
 if (-not (Test-Path "$XC16Path\xc16-gcc.exe")) {
@@ -67,6 +88,7 @@ foreach ($dir in $SrcDirs) {
     $fullDir = Join-Path $ScriptDir $dir
     if (Test-Path $fullDir) {
         $found = Get-ChildItem -Path $fullDir -Filter "*.c" -File
+        if ($Small) { $found = $found | Where-Object { $SmallExclude -notcontains $_.Name } }
         if ($found) { $SourceFiles += $found }
         $found = Get-ChildItem -Path $fullDir -Filter "*.s" -File
         if ($found) { $SourceFiles += $found }
@@ -99,7 +121,7 @@ foreach ($src in $SourceFiles) {
     }
 
     if ($src.Extension -eq ".s") {
-        $null = & "$XC16Path\xc16-gcc.exe" -c "-mcpu=$MCU" -omf=elf -o "$objPath" "$($src.FullName)" 2>&1
+        $null = & "$XC16Path\xc16-gcc.exe" -c "-mcpu=$MCU" -omf=elf $ASFLAGS -o "$objPath" "$($src.FullName)" 2>&1
     } else {
         $null = & "$XC16Path\xc16-gcc.exe" $CFLAGS -o "$objPath" "$($src.FullName)" 2>&1
     }
@@ -125,11 +147,16 @@ Write-Host "Compiled $($ObjectFiles.Count) objects" -ForegroundColor Green
 Write-Host "`nLinking..." -ForegroundColor Yellow
 $OutputElf = Join-Path $DistDir "$ProjectName.X.elf"
 $OutputHex = Join-Path $DistDir "$ProjectName.X.hex"
+$OutputMap = Join-Path $DistDir "$ProjectName.X.map"     # tools/ram_budget.py
 
-# Use STANDARD linker script - custom IVT is broken
-$LinkerScript = "C:\Program Files\Microchip\xc16\v2.10\support\PIC24F\gld\p24FJ64GB002.gld"
+# Repo linker script: IVT forwarders, serial number words and the fixed
+# persistent windows the application relies on (src/bl_shared.h). It
+# INCLUDEs p24FJ64GB002_sfr.gld, found through -L linker.
+$LinkerScript = Join-Path $ScriptDir "linker\bootloader_p24FJ64GB002.gld"
+if ($Small) { $LinkerScript = Join-Path $ScriptDir "linker\bootloader_small_p24FJ64GB002.gld" }
 $linkArgs = @("-mcpu=$MCU", "-omf=elf", "-legacy-libc", "-o", $OutputElf)
-$linkArgs += "-Wl,--script=`"$LinkerScript`",--heap=256,--stack=1024,--report-mem,--check-sections,--data-init,--pack-data,--handles,--no-gc-sections,--fill-upper=0,--stackguard=16,--no-force-link,--smart-io,-L`"$ScriptDir\linker`""
+$linkArgs += "-Wl,--script=`"$LinkerScript`",--heap=0,--stack=1024,--report-mem,--check-sections,--data-init,--pack-data,--handles,--no-gc-sections,--fill-upper=0,--stackguard=16,--no-force-link,--smart-io,-L`"$ScriptDir\linker`""
+$linkArgs += "-Wl,-Map=`"$OutputMap`""
 $linkArgs += $ObjectFiles
 
 $linkResult = & "$XC16Path\xc16-gcc.exe" @linkArgs 2>&1
@@ -154,12 +181,78 @@ $null = & "$XC16Path\xc16-bin2hex.exe" $OutputElf -a -omf=elf 2>&1
 
 Start-Sleep -Milliseconds 100
 
+# The persistent windows are application ABI (BL_HANDOFF_ADDRESS,
+# BL_ENTRY_REQUEST_ADDRESS, BL_INSTALL_REPORT_ADDRESS, BL_BOOT_LOG_ADDRESS);
+# a script that leaves them to orphan placement must not produce an image.
+$PersistSections = [ordered]@{ ".bl_persist" = 0x1200; ".app_persist" = 0x1240; ".bl_log" = 0x1280 }
+$mapText = Get-Content $OutputMap
+foreach ($name in $PersistSections.Keys) {
+    $row = $mapText | Select-String -Pattern ("^\s*" + [regex]::Escape($name) + "\s+0x([0-9a-fA-F]+)\s") |
+        Select-Object -First 1
+    $address = if ($row) { [Convert]::ToInt32($row.Matches[0].Groups[1].Value, 16) } else { -1 }
+    if ($address -ne $PersistSections[$name]) {
+        Write-Error ("{0} is not at 0x{1:X4} in {2}" -f $name, $PersistSections[$name], $OutputMap)
+        exit 1
+    }
+}
+
+if (Test-Path $OutputHex) {
+    # Check the HEX as well as the linker script's program region: nothing
+    # may reach the serial number words or the application area.
+    $upper = 0
+    $lastAddress = 0
+    $vectorBytes = @{}      # reset vector and IVT, by HEX byte address
+    foreach ($line in Get-Content $OutputHex) {
+        $count = [Convert]::ToInt32($line.Substring(1, 2), 16)
+        $offset = [Convert]::ToInt32($line.Substring(3, 4), 16)
+        $type = [Convert]::ToInt32($line.Substring(7, 2), 16)
+        if ($type -eq 4) {
+            $upper = [Convert]::ToInt32($line.Substring(9, 4), 16) * 0x10000
+        } elseif ($type -eq 0 -and $count -gt 0) {
+            $byteAddress = $upper + $offset + $count - 1
+            if ($byteAddress -lt 0x1000000) {
+                $lastAddress = [Math]::Max($lastAddress, [int][Math]::Floor($byteAddress / 2))
+            }
+            for ($i = 0; $i -lt $count -and $upper + $offset + $i -lt 0x200; $i++) {
+                $vectorBytes[$upper + $offset + $i] = [Convert]::ToInt32($line.Substring(9 + 2 * $i, 2), 16)
+            }
+        }
+    }
+    Write-Host ("  Program memory end: 0x{0:X4} (limit 0x{1:X4})" -f $lastAddress, $ImageLimit) -ForegroundColor Gray
+    if ($lastAddress -gt $ImageLimit) {
+        Write-Error ("Bootloader image ends at 0x{0:X4}, past 0x{1:X4}" -f $lastAddress, $ImageLimit)
+        exit 1
+    }
+
+    # Each IVT entry the linker script routes to a forwarder in ivt_forward.s
+    # (vector 18, SPI1, among them) must reach it in the image as linked.
+    $forwarders = & "$XC16Path\xc16-nm.exe" $OutputElf 2>&1 |
+        Select-String -Pattern "^([0-9a-fA-F]+)\s+\w\s+__bl_fwd_ivt_(\d+)$"
+    foreach ($m in $forwarders) {
+        $target = [Convert]::ToInt32($m.Matches[0].Groups[1].Value, 16)
+        $vector = [int]$m.Matches[0].Groups[2].Value
+        $entry = 2 * (0x4 + 2 * $vector)
+        $value = 0
+        for ($i = 2; $i -ge 0; $i--) { $value = $value * 256 + [int]$vectorBytes[$entry + $i] }
+        if ($value -ne $target) {
+            Write-Error ("IVT vector {0} points at 0x{1:X4}, not its forwarder at 0x{2:X4}" -f $vector, $value, $target)
+            exit 1
+        }
+    }
+    Write-Host ("  IVT forwarders: {0} vectors checked" -f @($forwarders).Count) -ForegroundColor Gray
+    if (@($forwarders).Count -eq 0) {
+        Write-Error "No IVT forwarders in $OutputElf"
+        exit 1
+    }
+}
+
 if (Test-Path $OutputHex) {
     $hexSize = (Get-Item $OutputHex).Length
     Write-Host "`n========================================" -ForegroundColor Green
     Write-Host " BUILD SUCCESSFUL" -ForegroundColor Green
     Write-Host " Output: $OutputHex" -ForegroundColor Green
     Write-Host " Size: $hexSize bytes" -ForegroundColor Green
+    Write-Host " Map:  $OutputMap" -ForegroundColor Green
     Write-Host "========================================" -ForegroundColor Green
 } else {
     Write-Error "HEX file not generated"
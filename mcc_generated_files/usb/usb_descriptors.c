@@ -145,6 +145,7 @@ state according to the definition in the USB specification.
 /** INCLUDES *******************************************************/
 #include "usb.h"
 #include "usb_device_cdc.h"
+#include "../../src/bl_serial.h"
 
 /** CONSTANTS ******************************************************/
 #if defined(__18CXX)
@@ -282,7 +283,8 @@ const uint8_t *const USB_SD_Ptr[USB_NUM_STRING_DESCRIPTORS]=
 {
     (const uint8_t *const)&sd000,
     (const uint8_t *const)&sd001,
-    (const uint8_t *const)&sd002
+    (const uint8_t *const)&sd002,
+    (const uint8_t *const)&blSerialDescriptor   // RAM, filled by BL_SerialInitialize()
 };
 
 #if defined(__18CXX)
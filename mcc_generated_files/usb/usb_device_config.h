@@ -134,7 +134,7 @@ please contact mla_licensing@microchip.com
 
 #define USB_SUPPORT_DEVICE
 
-#define USB_NUM_STRING_DESCRIPTORS 3  //Set this number to match the total number of string descriptors that are implemented in the usb_descriptors.c file
+#define USB_NUM_STRING_DESCRIPTORS 4  //Set this number to match the total number of string descriptors that are implemented in the usb_descriptors.c file
 
 /*******************************************************************
  * Event disable options                                           
@@ -151,6 +151,15 @@ please contact mla_licensing@microchip.com
 //#define USB_DISABLE_SET_CONFIGURATION_HANDLER
 //#define USB_DISABLE_TRANSFER_COMPLETE_HANDLER 
 
+// BL_SMALL: drop the callbacks the bootloader ignores (usb_device_events.c).
+// Suspend/wakeup stay (disabling them is not compliant), SOF stays (it runs
+// the status stage timeouts), error/EP0/configuration are used.
+#ifdef BL_SMALL
+#define USB_DISABLE_TRANSFER_TERMINATED_HANDLER
+#define USB_DISABLE_SET_DESCRIPTOR_HANDLER
+#define USB_DISABLE_TRANSFER_COMPLETE_HANDLER
+#endif
+
 
 /** DEVICE CLASS USAGE *********************************************/
 #define USB_USE_CDC
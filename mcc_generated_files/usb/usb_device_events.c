@@ -24,6 +24,9 @@ please contact mla_licensing@microchip.com
 #include <stdint.h>
 #include "usb_device.h"
 #include "usb_device_cdc.h"
+#include "../../src/bl_counters.h"
+#include "../../src/bl_prof.h"
+#include "../../src/bl_shared.h"
 
 /*******************************************************************
  * Function:        bool USER_USB_CALLBACK_EVENT_HANDLER(
@@ -86,6 +89,7 @@ bool USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, uint16_t size
             break;
 
         case EVENT_BUS_ERROR:
+            blCounters.usbBusErrors++;
             break;
 
         case EVENT_TRANSFER_TERMINATED:
@@ -99,23 +103,25 @@ bool USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, uint16_t size
 
 /* USB_INTERRUPT mode ISR - required for USB enumeration.
  * This ISR handles USB events and must be active for reliable USB operation.
- * When blVectorToApp is set, forwards to app's USB1 handler at 0x415C
+ * When blVectorToApp is set, forwards to app's USB1 handler at APP_USB1_VECTOR
  */
 #if defined(USB_INTERRUPT)
 
 // Forward declaration - defined in main.c
 extern volatile uint16_t blVectorToApp;
 
-// App's USB1 vector address: 0x4004 + (86 * 4) = 0x4004 + 0x158 = 0x415C
-#define APP_USB1_VECTOR 0x415C
+// App's USB1 vector address: BL_APP_START + 0x4 + (86 * 4), 0x415C (0x215C for BL_SMALL)
+#define APP_USB1_VECTOR BL_APP_START + 0x15C
 
 void __attribute__((interrupt,auto_psv)) _USB1Interrupt()
 {
     if (blVectorToApp)
     {
         // Forward to app's USB1 vector
-        asm("goto 0x415C");
+        asm("goto " BL_STR(APP_USB1_VECTOR));
     }
+    PROF_BEGIN(PROF_USB_ISR);
     USBDeviceTasks();
+    PROF_END(PROF_USB_ISR);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,17 @@
+/*
+ * Host simulator stand-in for mcc_generated_files/mcc.h
+ *
+ * Found ahead of the real header because the sim build puts -Isim first.
+ * sim.h itself is force-included (-include sim.h) so the XC16 intrinsics it
+ * maps are visible to every header, including bl_shared.h.
+ */
+
+#ifndef MCC_H
+#define MCC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usb/usb.h"
+#include "mcc_generated_files/memory/flash.h"
+
+#endif // MCC_H
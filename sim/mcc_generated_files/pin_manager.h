@@ -0,0 +1,15 @@
+/*
+ * Host simulator stand-in for mcc_generated_files/pin_manager.h
+ *
+ * Only the SPI NOR chip select (RB13), wired to sim_spinor.c.
+ */
+
+#ifndef _PIN_MANAGER_H
+#define _PIN_MANAGER_H
+
+#include "sim.h"
+
+#define IO_RB13_SetHigh()       SIM_NorSelect(false)
+#define IO_RB13_SetLow()        SIM_NorSelect(true)
+
+#endif // _PIN_MANAGER_H
@@ -0,0 +1,32 @@
+/*
+ * Host simulator stand-in for the MCC USB device stack (usb.h).
+ *
+ * The simulated device is always attached and configured.
+ */
+
+#ifndef USB_H
+#define USB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    DETACHED_STATE      = 0x00,
+    ATTACHED_STATE      = 0x01,
+    POWERED_STATE       = 0x02,
+    DEFAULT_STATE       = 0x04,
+    ADR_PENDING_STATE   = 0x08,
+    ADDRESS_STATE       = 0x10,
+    CONFIGURED_STATE    = 0x20
+} USB_DEVICE_STATE;
+
+#define USBGetDeviceState()     CONFIGURED_STATE
+#define USBIsDeviceSuspended()  false
+
+static inline void USBDeviceInit(void) { }
+static inline void USBDeviceAttach(void) { }
+static inline void USBDeviceDetach(void) { }
+static inline void USBDeviceTasks(void) { }
+
+#endif // USB_H
@@ -0,0 +1,22 @@
+/*
+ * Host simulator stand-in for the MCC CDC function driver
+ * (usb_device_cdc.h). Implemented over a pty in sim/sim_cdc.c.
+ */
+
+#ifndef USBCDC_H
+#define USBCDC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CDC_DATA_OUT_EP_SIZE    64
+#define CDC_DATA_IN_EP_SIZE     64
+
+uint8_t getsUSBUSART(uint8_t *buffer, uint8_t len);
+void putUSBUSART(uint8_t *data, uint8_t length);
+void putsUSBUSART(char *data);
+void putrsUSBUSART(const char *data);
+void CDCTxService(void);
+bool USBUSARTIsTxTrfReady(void);
+
+#endif // USBCDC_H
@@ -0,0 +1,80 @@
+/*
+ * Host Simulator Interface
+ *
+ * Native (Linux) build of src/bootloader.c. The MCC drivers are replaced by:
+ *   sim_flash.c  file-backed 24-bit program memory behind memory/flash.h
+ *   sim_cdc.c    USB CDC calls mapped onto a pseudo-terminal
+ *   sim_spinor.c bl_spi.c + chip select ending in a file-backed SPI NOR
+ *   sim_main.c   reset/jump handling and the bootloader main loop
+ *
+ * Build with "make sim"; see README.md for usage.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// XC16 intrinsics used by the bootloader sources.
+#define asm(x)                  SIM_Asm(x)
+#define __builtin_disi(x)       ((void)(x))
+#define Nop()                   ((void)0)
+
+// Program memory geometry (PIC24FJ64GB002: 22K instructions, 0x0000-0xABFF).
+#define SIM_FLASH_END_PC        0xAC00UL
+#define SIM_FLASH_INSTRUCTIONS  (SIM_FLASH_END_PC / 2)
+
+// Programming time model in microseconds (0 = instantaneous).
+typedef struct
+{
+    uint32_t eraseUs;       // page erase
+    uint32_t rowUs;         // row program
+    uint32_t wordUs;        // single word program
+} SimFlashTiming_t;
+
+typedef struct
+{
+    uint32_t erases;
+    uint32_t rows;
+    uint32_t words;
+    uint32_t alignErrors;   // misaligned page/row address or locked flash
+    uint32_t zeroToOne;     // instructions whose write tried to set a 0 bit
+    uint64_t busyUs;        // simulated programming time
+} SimFlashStats_t;
+
+// sim_flash.c (path NULL: anonymous, not persisted)
+bool SIM_FlashOpen(const char* path, const SimFlashTiming_t* timing);
+void SIM_FlashClose(void);
+const SimFlashStats_t* SIM_FlashStats(void);
+
+typedef struct
+{
+    uint32_t programs;      // page programs
+    uint32_t erases;        // sector erases
+    uint32_t notEnabled;    // program/erase without write enable, ignored
+    uint32_t zeroToOne;     // bytes whose program tried to set a 0 bit
+    uint64_t readBytes;
+} SimNorStats_t;
+
+// sim_spinor.c (not opened: no NOR fitted, reads 0xFF)
+bool SIM_NorOpen(const char* path);
+void SIM_NorClose(void);
+const SimNorStats_t* SIM_NorStats(void);    // NULL if not opened
+void SIM_NorSelect(bool select);            // RB13 chip select, true = low
+// Write a file into the NOR at 'offset', erasing 'size' bytes there first
+// (what an application does before it requests an install)
+bool SIM_NorLoad(uint32_t offset, uint32_t size, const char* path);
+
+// sim_cdc.c
+bool SIM_CdcOpen(const char* linkPath);
+void SIM_CdcClose(void);
+const char* SIM_CdcPortName(void);
+uint64_t SIM_CdcRxBytes(void);
+uint64_t SIM_CdcTxBytes(void);
+
+// sim_main.c
+void SIM_Asm(const char* insn);
+uint32_t SIM_Entropy(void);     // stands in for power-up SRAM (bl_serial.c)
+
+#endif // SIM_H
@@ -0,0 +1,56 @@
+/*
+ * Host Benchmark Runner
+ *
+ * Runs BL_BenchRun (src/bl_bench.c) natively against the simulated flash
+ * held in anonymous memory. Flash timing defaults to zero so the numbers
+ * are parser/row-assembly CPU cost only; -E/-R/-W add the timing model.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include "bootloader.h"
+#include "bl_bench.h"
+#include "bl_serial.h"
+#include "sim.h"
+
+void SIM_Asm(const char* insn)
+{
+    fprintf(stderr, "bench: unexpected asm(\"%s\")\n", insn);
+    exit(1);
+}
+
+static void PrintLine(const char* text)
+{
+    fputs(text, stdout);
+}
+
+int main(int argc, char** argv)
+{
+    SimFlashTiming_t timing = { 0, 0, 0 };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "E:R:W:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'E': timing.eraseUs = strtoul(optarg, NULL, 0); break;
+            case 'R': timing.rowUs = strtoul(optarg, NULL, 0); break;
+            case 'W': timing.wordUs = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-E erase_us] [-R row_us] [-W word_us]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (!SIM_FlashOpen(NULL, &timing))
+    {
+        return 1;
+    }
+    BL_TimebaseStart();
+    BL_SerialInitialize();
+    Bootloader_Initialize();
+    BL_BenchRun(PrintLine);
+    SIM_FlashClose();
+    return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * Simulated USB CDC Function
+ *
+ * Maps the MCC CDC API used by the bootloader onto a pseudo-terminal so a
+ * host tool can talk to the simulator exactly like a /dev/ttyACMx port.
+ * Reads are delivered in CDC_DATA_OUT_EP_SIZE chunks, as the bulk OUT
+ * endpoint would. Transmit is always ready.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "sim.h"
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+
+static int ptyMaster = -1;
+static int ptySlave = -1;      // held open so host close/reopen does not hang up the master
+static char ptyName[128];
+static char linkName[256];
+static uint64_t rxBytes = 0;
+static uint64_t txBytes = 0;
+
+bool SIM_CdcOpen(const char* linkPath)
+{
+    struct termios tio;
+
+    ptyMaster = posix_openpt(O_RDWR | O_NOCTTY);
+    if (ptyMaster < 0 || grantpt(ptyMaster) != 0 || unlockpt(ptyMaster) != 0 ||
+        ptsname_r(ptyMaster, ptyName, sizeof(ptyName)) != 0)
+    {
+        perror("pty");
+        return false;
+    }
+
+    ptySlave = open(ptyName, O_RDWR | O_NOCTTY);
+    if (ptySlave < 0 || tcgetattr(ptySlave, &tio) != 0)
+    {
+        perror(ptyName);
+        return false;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(ptySlave, TCSANOW, &tio);
+
+    fcntl(ptyMaster, F_SETFL, fcntl(ptyMaster, F_GETFL) | O_NONBLOCK);
+
+    linkName[0] = '\0';
+    if (linkPath != NULL)
+    {
+        unlink(linkPath);
+        if (symlink(ptyName, linkPath) != 0)
+        {
+            perror(linkPath);
+            return false;
+        }
+        snprintf(linkName, sizeof(linkName), "%s", linkPath);
+    }
+    return true;
+}
+
+void SIM_CdcClose(void)
+{
+    // Give the host up to 1 s to read the last response (e.g. "+Jumping...")
+    // before the hangup discards it.
+    for (int i = 0; i < 100 && ptySlave >= 0; i++)
+    {
+        int pending = 0;
+        if (ioctl(ptySlave, FIONREAD, &pending) != 0 || pending == 0)
+        {
+            break;
+        }
+        usleep(10000);
+    }
+
+    if (linkName[0] != '\0')
+    {
+        unlink(linkName);
+        linkName[0] = '\0';
+    }
+    if (ptySlave >= 0)
+    {
+        close(ptySlave);
+        ptySlave = -1;
+    }
+    if (ptyMaster >= 0)
+    {
+        close(ptyMaster);
+        ptyMaster = -1;
+    }
+}
+
+const char* SIM_CdcPortName(void)
+{
+    return (linkName[0] != '\0') ? linkName : ptyName;
+}
+
+uint64_t SIM_CdcRxBytes(void)
+{
+    return rxBytes;
+}
+
+uint64_t SIM_CdcTxBytes(void)
+{
+    return txBytes;
+}
+
+uint8_t getsUSBUSART(uint8_t *buffer, uint8_t len)
+{
+    struct pollfd pfd = { ptyMaster, POLLIN, 0 };
+    ssize_t n;
+
+    if (len > CDC_DATA_OUT_EP_SIZE)
+    {
+        len = CDC_DATA_OUT_EP_SIZE;
+    }
+
+    // Block briefly so an idle main loop does not spin a host core.
+    if (poll(&pfd, 1, 1) <= 0)
+    {
+        return 0;
+    }
+    n = read(ptyMaster, buffer, len);
+    if (n <= 0)
+    {
+        return 0;
+    }
+    rxBytes += (uint64_t)n;
+    return (uint8_t)n;
+}
+
+void putUSBUSART(uint8_t *data, uint8_t length)
+{
+    while (length > 0)
+    {
+        ssize_t n = write(ptyMaster, data, length);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+            {
+                struct pollfd pfd = { ptyMaster, POLLOUT, 0 };
+                poll(&pfd, 1, 10);
+                continue;
+            }
+            return;
+        }
+        txBytes += (uint64_t)n;
+        data += n;
+        length -= (uint8_t)n;
+    }
+}
+
+void putsUSBUSART(char *data)
+{
+    putUSBUSART((uint8_t*)data, (uint8_t)strlen(data));
+}
+
+void putrsUSBUSART(const char *data)
+{
+    putUSBUSART((uint8_t*)data, (uint8_t)strlen(data));
+}
+
+void CDCTxService(void)
+{
+}
+
+bool USBUSARTIsTxTrfReady(void)
+{
+    return true;
+}
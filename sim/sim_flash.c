@@ -0,0 +1,251 @@
+/*
+ * Simulated Program Flash
+ *
+ * Implements mcc_generated_files/memory/flash.h on top of a memory-mapped
+ * file (or anonymous memory when no path is given) holding the PIC24 program memory as packed 24-bit little-endian
+ * instructions (3 bytes per PC address pair). The model enforces what the
+ * real NVM controller enforces:
+ *   - page erase only on 1024 PC-unit boundaries, row write only on 128
+ *   - programming can only clear bits (new = old & data); writes that need
+ *     a 0 bit set again are counted in SimFlashStats_t.zeroToOne
+ *   - nothing happens unless FLASH_Unlock() was given FLASH_UNLOCK_KEY
+ * and charges a configurable busy time per operation, like RTSP stalls the
+ * CPU on target.
+ */
+
+#include "sim.h"
+#include "mcc_generated_files/memory/flash.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FLASH_FILE_SIZE     (SIM_FLASH_INSTRUCTIONS * 3UL)
+#define ERASED_WORD         0x00FFFFFFUL
+
+static uint8_t* flashMem = NULL;
+static int flashFd = -1;
+static uint32_t unlockKey = 0;
+static SimFlashTiming_t flashTiming;
+static SimFlashStats_t flashStats;
+
+static void Busy(uint32_t us)
+{
+    if (us == 0)
+    {
+        return;
+    }
+    flashStats.busyUs += us;
+
+    struct timespec ts = { us / 1000000UL, (long)(us % 1000000UL) * 1000L };
+    while (nanosleep(&ts, &ts) != 0) { ; }
+}
+
+static bool InRange(uint32_t address)
+{
+    return address < SIM_FLASH_END_PC;
+}
+
+static uint32_t Get(uint32_t address)
+{
+    const uint8_t* p = &flashMem[(address / 2) * 3];
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+static void Put(uint32_t address, uint32_t value)
+{
+    uint8_t* p = &flashMem[(address / 2) * 3];
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+}
+
+static void Program(uint32_t address, uint32_t data)
+{
+    uint32_t old = Get(address);
+    data &= ERASED_WORD;
+
+    // Writing 1s is a no-op on NVM; 0xFFFFFF is row padding. Anything else
+    // that needs a 0 bit turned back into 1 is lost without an erase.
+    if ((data & ~old) && data != ERASED_WORD)
+    {
+        if (flashStats.zeroToOne++ == 0)
+        {
+            fprintf(stderr, "sim: flash 0->1 write at 0x%05lX (has %06lX, wrote %06lX)\n",
+                    (unsigned long)address, (unsigned long)old, (unsigned long)data);
+        }
+    }
+    Put(address, old & data);
+}
+
+static bool CheckOp(uint32_t address, uint32_t alignment)
+{
+    if (flashMem == NULL || unlockKey != FLASH_UNLOCK_KEY ||
+        !InRange(address) || (address & (alignment - 1)) != 0)
+    {
+        flashStats.alignErrors++;
+        return false;
+    }
+    return true;
+}
+
+bool SIM_FlashOpen(const char* path, const SimFlashTiming_t* timing)
+{
+    struct stat st;
+    bool fresh;
+
+    flashTiming = *timing;
+    memset(&flashStats, 0, sizeof(flashStats));
+
+    if (path == NULL)
+    {
+        // Throwaway flash in anonymous memory (benchmarks).
+        flashMem = mmap(NULL, FLASH_FILE_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (flashMem == MAP_FAILED)
+        {
+            flashMem = NULL;
+            perror("mmap");
+            return false;
+        }
+        memset(flashMem, 0xFF, FLASH_FILE_SIZE);
+        return true;
+    }
+
+    flashFd = open(path, O_RDWR | O_CREAT, 0644);
+    if (flashFd < 0 || fstat(flashFd, &st) != 0)
+    {
+        perror(path);
+        return false;
+    }
+    fresh = ((unsigned long)st.st_size != FLASH_FILE_SIZE);
+    if (fresh && ftruncate(flashFd, FLASH_FILE_SIZE) != 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    flashMem = mmap(NULL, FLASH_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, flashFd, 0);
+    if (flashMem == MAP_FAILED)
+    {
+        flashMem = NULL;
+        perror("mmap");
+        return false;
+    }
+    if (fresh)
+    {
+        memset(flashMem, 0xFF, FLASH_FILE_SIZE);
+    }
+    return true;
+}
+
+void SIM_FlashClose(void)
+{
+    if (flashMem != NULL)
+    {
+        msync(flashMem, FLASH_FILE_SIZE, MS_SYNC);
+        munmap(flashMem, FLASH_FILE_SIZE);
+        flashMem = NULL;
+    }
+    if (flashFd >= 0)
+    {
+        close(flashFd);
+        flashFd = -1;
+    }
+}
+
+const SimFlashStats_t* SIM_FlashStats(void)
+{
+    return &flashStats;
+}
+
+void FLASH_Unlock(uint32_t key)
+{
+    unlockKey = key;
+}
+
+void FLASH_Lock(void)
+{
+    unlockKey = 0;
+}
+
+bool FLASH_ErasePage(uint32_t address)
+{
+    if (!CheckOp(address, FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS; i += 2)
+    {
+        Put(address + i, ERASED_WORD);
+    }
+    flashStats.erases++;
+    Busy(flashTiming.eraseUs);
+    return true;
+}
+
+uint32_t FLASH_ReadWord24(uint32_t address)
+{
+    return (flashMem != NULL && InRange(address)) ? Get(address & ~1UL) : 0;
+}
+
+uint16_t FLASH_ReadWord16(uint32_t address)
+{
+    return (uint16_t)FLASH_ReadWord24(address);
+}
+
+bool FLASH_WriteWord24(uint32_t address, uint32_t Data)
+{
+    if (!CheckOp(address, 2))
+    {
+        return false;
+    }
+    Program(address, Data);
+    flashStats.words++;
+    Busy(flashTiming.wordUs);
+    return true;
+}
+
+bool FLASH_WriteWord16(uint32_t address, uint16_t Data)
+{
+    return FLASH_WriteWord24(address, 0x00FF0000UL | Data);
+}
+
+bool FLASH_WriteRow24(uint32_t address, uint32_t *data)
+{
+    if (!CheckOp(address, FLASH_WRITE_ROW_SIZE_IN_PC_UNITS))
+    {
+        return false;
+    }
+    for (uint16_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+    {
+        Program(address + i * 2U, data[i]);
+    }
+    flashStats.rows++;
+    Busy(flashTiming.rowUs);
+    return true;
+}
+
+bool FLASH_WriteRow16(uint32_t address, uint16_t *data)
+{
+    uint32_t row[FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS];
+
+    for (uint16_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+    {
+        row[i] = 0x00FF0000UL | data[i];
+    }
+    return FLASH_WriteRow24(address, row);
+}
+
+uint16_t FLASH_GetErasePageOffset(uint32_t address)
+{
+    return (uint16_t)(address & (FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS - 1));
+}
+
+uint32_t FLASH_GetErasePageAddress(uint32_t address)
+{
+    return address & ~((uint32_t)FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS - 1);
+}
@@ -0,0 +1,261 @@
+/*
+ * Host Simulator Entry Point
+ *
+ * Stands in for src/main.c: emulates RESET with setjmp/longjmp so the
+ * persistent variables (sim_persist.c) survive like they do on target, and
+ * runs the bootloader main loop.
+ *
+ * The simulator always comes up in the bootloader (as if the application had
+ * posted an entry request). A jump to the application is logged and ends the
+ * run, or with -s re-enters the bootloader on the same pty. With -t the
+ * next starts of the application end in a trap reset instead; like main.c,
+ * the bootloader then starts it again, or restores the golden image
+ * (bl_golden.h) once it has failed often enough. With -i the next start
+ * of the application stages an image file in the NOR install area and
+ * requests an install (bl_ota.h) instead.
+ */
+
+#include <getopt.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bootloader.h"
+#include "bl_serial.h"
+#include "bl_counters.h"
+#include "bl_bootlog.h"
+#include "bl_timebase.h"
+#include "bl_stage.h"
+#include "bl_golden.h"
+#include "bl_ota.h"
+#include "sim.h"
+
+// Defined in sim_persist.c (main.c on target); not in bootloader.h.
+extern volatile uint16_t blVectorToApp;
+
+#define SIM_RCON_POR    0x0003U     // POR | BOR
+#define SIM_RCON_SWR    0x0040U     // software RESET instruction
+#define SIM_RCON_TRAPR  0x8000U     // trap conflict reset
+
+// longjmp values
+#define SIM_RESET_SWR   1
+#define SIM_RESET_TRAP  2
+
+static jmp_buf resetPoint;
+static volatile sig_atomic_t stopRequested = 0;
+static bool stayResident = false;
+static unsigned long trapsLeft = 0;
+static const char* installPath = NULL;
+
+void SIM_Asm(const char* insn)
+{
+    if (strcmp(insn, "RESET") == 0 || strcmp(insn, "reset") == 0)
+    {
+        longjmp(resetPoint, 1);
+    }
+    fprintf(stderr, "sim: ignoring asm(\"%s\")\n", insn);
+}
+
+static void OnSignal(int sig)
+{
+    (void)sig;
+    stopRequested = 1;
+}
+
+static bool IsValidApplication(void)
+{
+    uint32_t resetVector = FLASH_ReadWord24(APP_START_ADDRESS);
+    return !(resetVector == 0xFFFFFF || resetVector == 0x000000);
+}
+
+// Control leaves for the application. With -t it traps and resets; with -s
+// it posts an entry request, which resets back into the bootloader.
+static void StartApplication(uint8_t path)
+{
+    blStubToAppCount++;
+    BL_BootLogBegin(path, blRconAtEntry, appStage);
+    BL_BootLogLeave();
+    BL_GoldenLaunch();
+    fprintf(stderr, "sim: jump to application at 0x%04lX\n", (unsigned long)APP_START_ADDRESS);
+    if (installPath != NULL)
+    {
+        // What an application that received an image over its own link does
+        if (SIM_NorLoad(BL_OTA_NOR_BASE, BL_OTA_NOR_SIZE, installPath))
+        {
+            blEntryRequest = BL_INSTALL_REQUEST_MAGIC;
+        }
+        installPath = NULL;
+        longjmp(resetPoint, SIM_RESET_SWR);
+    }
+    if (trapsLeft > 0U)
+    {
+        trapsLeft--;
+        appTrapCount++;
+        fprintf(stderr, "sim: application trapped (appTrapCount=%u)\n", appTrapCount);
+        longjmp(resetPoint, SIM_RESET_TRAP);
+    }
+    if (!stayResident)
+    {
+        stopRequested = 1;
+        return;
+    }
+    longjmp(resetPoint, SIM_RESET_SWR);
+}
+
+static void PrintStats(void)
+{
+    const SimFlashStats_t* fs = SIM_FlashStats();
+
+    fprintf(stderr,
+            "sim: rx=%llu tx=%llu bytes; erase=%lu row=%lu word=%lu; "
+            "busy=%llu us; align_err=%lu zero_to_one=%lu\n",
+            (unsigned long long)SIM_CdcRxBytes(), (unsigned long long)SIM_CdcTxBytes(),
+            (unsigned long)fs->erases, (unsigned long)fs->rows, (unsigned long)fs->words,
+            (unsigned long long)fs->busyUs,
+            (unsigned long)fs->alignErrors, (unsigned long)fs->zeroToOne);
+
+    const SimNorStats_t* ns = SIM_NorStats();
+    if (ns != NULL)
+    {
+        fprintf(stderr,
+                "sim: nor program=%lu erase=%lu read=%llu bytes; not_enabled=%lu zero_to_one=%lu\n",
+                (unsigned long)ns->programs, (unsigned long)ns->erases,
+                (unsigned long long)ns->readBytes,
+                (unsigned long)ns->notEnabled, (unsigned long)ns->zeroToOne);
+    }
+}
+
+static void Usage(const char* argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-f flash.bin] [-n nor.bin] [-l link] [-E erase_us] [-R row_us] [-W word_us] [-s] [-t n] [-i ota.bin]\n"
+            "  -f  program memory image (created erased if missing), default blsim_flash.bin\n"
+            "  -n  fit a 1 MB SPI NOR with this image (created erased if missing); default none\n"
+            "  -l  create a symlink to the pty at this path (e.g. /tmp/ttyBL0)\n"
+            "  -E/-R/-W  page erase / row write / word write time, default 20000/1600/45 us\n"
+            "  -s  stay resident: re-enter the bootloader after a jump to the app\n"
+            "  -t  the next n starts of the app end in a trap reset\n"
+            "  -i  the next start of the app stages this install area image (tools/ota_image.py)\n"
+            "      and requests an install\n",
+            argv0);
+}
+
+int main(int argc, char** argv)
+{
+    const char* flashPath = "blsim_flash.bin";
+    const char* linkPath = NULL;
+    const char* norPath = NULL;
+    SimFlashTiming_t timing = { 20000UL, 1600UL, 45UL };
+    int reset;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:n:l:E:R:W:st:i:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': flashPath = optarg; break;
+            case 'n': norPath = optarg; break;
+            case 'l': linkPath = optarg; break;
+            case 'E': timing.eraseUs = strtoul(optarg, NULL, 0); break;
+            case 'R': timing.rowUs = strtoul(optarg, NULL, 0); break;
+            case 'W': timing.wordUs = strtoul(optarg, NULL, 0); break;
+            case 's': stayResident = true; break;
+            case 't': trapsLeft = strtoul(optarg, NULL, 0); break;
+            case 'i': installPath = optarg; break;
+            default:  Usage(argv[0]); return 2;
+        }
+    }
+
+    if (!SIM_FlashOpen(flashPath, &timing) || !SIM_CdcOpen(linkPath) ||
+        (norPath != NULL && !SIM_NorOpen(norPath)))
+    {
+        return 1;
+    }
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    printf("%s\n", SIM_CdcPortName());
+    fflush(stdout);
+
+    reset = setjmp(resetPoint);
+    FLASH_Lock();               // the unlock key is RAM that C startup clears
+    blRconAtEntry = (reset == SIM_RESET_TRAP) ? SIM_RCON_TRAPR :
+                    (reset == SIM_RESET_SWR) ? SIM_RCON_SWR : SIM_RCON_POR;
+
+    // Entry policy (mirrors main.c).
+    blVectorToApp = 0;
+    BL_TimebaseStart();
+    blHandoff.magic = 0;
+    blLastRcon = blRconAtEntry;
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+    bool goldenDue = BL_GoldenBootCheck(blRconAtEntry);
+#endif
+
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+    if (blEntryRequest == BL_INSTALL_REQUEST_MAGIC)
+    {
+        blEntryRequest = 0;
+        BL_StageInitialize();
+        Bootloader_InstallStaged();
+        fprintf(stderr, "sim: install result=%u crc=%08lX pages erased=%u skipped=%u rows=%u\n",
+                blInstallReport.result, (unsigned long)blInstallReport.crc,
+                blInstallReport.pagesErased, blInstallReport.pagesSkipped,
+                blInstallReport.rowsWritten);
+        BL_BootLogBegin(BL_BOOT_PATH_INSTALL, blRconAtEntry, appStage);
+        BL_BootLogLeave();
+        blJumpMagic = BL_JUMP_MAGIC_VALUE;
+        longjmp(resetPoint, SIM_RESET_SWR);
+    }
+#endif
+
+    if (blJumpMagic == BL_JUMP_MAGIC_VALUE)
+    {
+        blJumpMagic = 0;
+        if (IsValidApplication())
+        {
+            StartApplication(BL_BOOT_PATH_JUMP);
+        }
+    }
+    else if (reset == SIM_RESET_TRAP)
+    {
+        // Not a host request: main.c starts the application again
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+        if (goldenDue)
+        {
+            BL_StageInitialize();
+            if (Bootloader_RestoreGolden())
+            {
+                BL_BootLogBegin(BL_BOOT_PATH_GOLDEN, blRconAtEntry, appStage);
+                BL_BootLogLeave();
+                fprintf(stderr, "sim: golden image restored\n");
+                blJumpMagic = BL_JUMP_MAGIC_VALUE;
+                longjmp(resetPoint, SIM_RESET_SWR);
+            }
+        }
+#endif
+        if (IsValidApplication())
+        {
+            StartApplication(BL_BOOT_PATH_APP);
+        }
+    }
+
+    // Otherwise the application posted an entry request.
+    blEntryRequest = 0;
+    BL_BootLogBegin(BL_BOOT_PATH_REQUEST, blRconAtEntry, appStage);
+    BL_SerialInitialize();
+    Bootloader_Initialize();
+    Bootloader_ClearHostActivity();
+
+    while (!stopRequested)
+    {
+        blCounters.mainLoops++;
+        Bootloader_ProcessCommand();
+    }
+
+    PrintStats();
+    SIM_CdcClose();
+    SIM_FlashClose();
+    SIM_NorClose();
+    return 0;
+}
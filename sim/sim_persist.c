@@ -0,0 +1,42 @@
+/*
+ * Simulated Persistent RAM
+ *
+ * Host definitions of the .bl_persist/.app_persist variables that live in
+ * src/main.c on target. Plain globals survive the simulated RESET because it
+ * does not re-run C startup.
+ */
+
+#include <time.h>
+#include <unistd.h>
+#include "bootloader.h"
+
+volatile uint16_t blJumpMagic;
+volatile uint16_t blJumpAttempted;
+volatile uint16_t blJumpReturnCount;
+volatile uint16_t blLastRcon;
+volatile uint16_t blRconAtEntry;
+volatile uint16_t blSawResetStubMagic;
+volatile uint16_t blStubToAppCount;
+volatile uint16_t blVectorToApp;
+volatile uint16_t blEntryRequest;
+volatile BlHandoff_t blHandoff;
+
+volatile uint16_t appTrapCode;
+volatile uint16_t appTrapCount;
+volatile uint16_t appTrapIntcon1;
+volatile uint16_t appTrapRcon;
+volatile uint16_t appBootCount;
+volatile uint16_t appStage;
+volatile uint16_t appLastRcon;
+
+// Power-up SRAM stand-in for the serial number seed: differs per process.
+uint32_t SIM_Entropy(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_nsec ^ ((uint32_t)ts.tv_sec << 20) ^ ((uint32_t)getpid() << 8);
+}
+
+// SFR stand-ins (sim/xc.h).
+volatile uint16_t DISICNT;
@@ -0,0 +1,311 @@
+/*
+ * Simulated SPI NOR Flash
+ *
+ * Byte-level model of a 1 MB JEDEC serial NOR (W25Q80: ID EF 40 14) on the
+ * far side of the SPI1 engine (stands in for src/bl_spi.c, same API and
+ * clock selection) and the RB13 chip select, so src/bl_nor.c runs
+ * unchanged. Memory is a memory-mapped file like
+ * sim_flash.c. The model enforces what a real part does:
+ *   - 02/20 do nothing unless 06 (write enable) came first; WEL clears
+ *     when the command ends
+ *   - page program wraps inside its 256-byte page and can only clear bits
+ *     (writes that need a 0 bit set again are counted in zeroToOne)
+ *   - sector erase acts when chip select goes high
+ * It is never busy, and transfers take no bus time: asynchronous transfers
+ * complete (and call back) before BL_SpiTransferAsync returns. With no NOR
+ * opened MISO reads 0xFF, as with no part fitted.
+ */
+
+#include "sim.h"
+#include "bl_spi.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NOR_SIZE            (1UL << 20)
+#define NOR_PAGE_SIZE       256UL
+#define NOR_SECTOR_SIZE     4096UL
+
+#define CMD_READ_ID         0x9FU
+#define CMD_READ            0x03U
+#define CMD_PAGE_PROGRAM    0x02U
+#define CMD_SECTOR_ERASE    0x20U
+#define CMD_READ_STATUS     0x05U
+#define CMD_WRITE_ENABLE    0x06U
+#define CMD_WRITE_DISABLE   0x04U
+
+#define STATUS_WEL          0x02U
+
+static const uint8_t norId[3] = { 0xEF, 0x40, 0x14 };
+
+static uint8_t* norMem = NULL;
+static int norFd = -1;
+static SimNorStats_t norStats;
+
+static bool spiEnabled = false;
+static uint32_t spiClock = 0;
+
+static bool selected = false;
+static bool writeEnabled = false;
+static uint8_t command;
+static uint32_t count;          // bytes clocked since chip select went low
+static uint32_t address;
+
+bool SIM_NorOpen(const char* path)
+{
+    struct stat st;
+    bool fresh;
+
+    memset(&norStats, 0, sizeof(norStats));
+
+    norFd = open(path, O_RDWR | O_CREAT, 0644);
+    if (norFd < 0 || fstat(norFd, &st) != 0)
+    {
+        perror(path);
+        return false;
+    }
+    fresh = ((unsigned long)st.st_size != NOR_SIZE);
+    if (fresh && ftruncate(norFd, NOR_SIZE) != 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    norMem = mmap(NULL, NOR_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, norFd, 0);
+    if (norMem == MAP_FAILED)
+    {
+        norMem = NULL;
+        perror("mmap");
+        return false;
+    }
+    if (fresh)
+    {
+        memset(norMem, 0xFF, NOR_SIZE);
+    }
+    return true;
+}
+
+void SIM_NorClose(void)
+{
+    if (norMem != NULL)
+    {
+        msync(norMem, NOR_SIZE, MS_SYNC);
+        munmap(norMem, NOR_SIZE);
+        norMem = NULL;
+    }
+    if (norFd >= 0)
+    {
+        close(norFd);
+        norFd = -1;
+    }
+}
+
+bool SIM_NorLoad(uint32_t offset, uint32_t size, const char* path)
+{
+    FILE* f;
+    size_t n;
+
+    if (norMem == NULL || offset + size > NOR_SIZE)
+    {
+        fprintf(stderr, "sim: no NOR fitted for %s (-n)\n", path);
+        return false;
+    }
+    f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    memset(&norMem[offset], 0xFF, size);
+    n = fread(&norMem[offset], 1, size, f);
+    fclose(f);
+    fprintf(stderr, "sim: %lu bytes of %s written to NOR 0x%06lX\n",
+            (unsigned long)n, path, (unsigned long)offset);
+    return true;
+}
+
+const SimNorStats_t* SIM_NorStats(void)
+{
+    return (norMem != NULL) ? &norStats : NULL;
+}
+
+// End of a command: chip select went high.
+static void Finish(void)
+{
+    if (count < 4U || (command != CMD_PAGE_PROGRAM && command != CMD_SECTOR_ERASE))
+    {
+        return;
+    }
+    if (!writeEnabled)
+    {
+        norStats.notEnabled++;
+        return;
+    }
+    if (command == CMD_SECTOR_ERASE)
+    {
+        memset(&norMem[address & (NOR_SIZE - NOR_SECTOR_SIZE)], 0xFF, NOR_SECTOR_SIZE);
+        norStats.erases++;
+    }
+    else
+    {
+        norStats.programs++;
+    }
+    writeEnabled = false;
+}
+
+void SIM_NorSelect(bool select)
+{
+    if (norMem != NULL && selected && !select)
+    {
+        Finish();
+    }
+    if (select && !selected)
+    {
+        count = 0;
+    }
+    selected = select;
+}
+
+static void Program(uint8_t data)
+{
+    uint32_t offset = (address & (NOR_SIZE - NOR_PAGE_SIZE)) |
+                      ((address + count - 4U) & (NOR_PAGE_SIZE - 1UL));
+    uint8_t old = norMem[offset];
+
+    if (!writeEnabled)
+    {
+        return;
+    }
+    if ((data & ~old) != 0U && norStats.zeroToOne++ == 0U)
+    {
+        fprintf(stderr, "sim: NOR 0->1 write at 0x%06lX (has %02X, wrote %02X)\n",
+                (unsigned long)offset, old, data);
+    }
+    norMem[offset] = old & data;
+}
+
+uint32_t BL_SpiOpen(uint8_t mode, uint32_t hz)
+{
+    (void)mode;
+    spiEnabled = true;
+    return BL_SpiSetClock(hz);
+}
+
+void BL_SpiClose(void)
+{
+    spiEnabled = false;
+}
+
+// Fcy / (primary * secondary), primary 1/4/16/64, secondary 1..8, not 1:1
+uint32_t BL_SpiSetClock(uint32_t hz)
+{
+    static const uint8_t primaryDivider[4] = { 64U, 16U, 4U, 1U };
+    uint32_t best = BL_SPI_MIN_HZ;
+    uint32_t sck;
+
+    for (uint8_t ppre = 0; ppre < 4U; ppre++)
+    {
+        for (uint8_t secondary = 1; secondary <= 8U; secondary++)
+        {
+            if (primaryDivider[ppre] == 1U && secondary == 1U)
+            {
+                continue;
+            }
+            sck = BL_SPI_FCY_HZ / ((uint16_t)primaryDivider[ppre] * secondary);
+            if (sck <= hz && sck > best)
+            {
+                best = sck;
+            }
+        }
+    }
+    spiClock = best;
+    return best;
+}
+
+uint32_t BL_SpiClock(void)
+{
+    return spiClock;
+}
+
+uint8_t BL_SpiExchange(uint8_t data)
+{
+    uint8_t out = 0xFFU;
+
+    if (norMem == NULL || !selected || !spiEnabled)
+    {
+        return out;
+    }
+
+    if (count == 0U)
+    {
+        command = data;
+        address = 0;
+        if (command == CMD_WRITE_ENABLE)
+        {
+            writeEnabled = true;
+        }
+        else if (command == CMD_WRITE_DISABLE)
+        {
+            writeEnabled = false;
+        }
+    }
+    else if (command == CMD_READ_ID)
+    {
+        out = (count <= sizeof(norId)) ? norId[count - 1U] : 0xFFU;
+    }
+    else if (command == CMD_READ_STATUS)
+    {
+        out = writeEnabled ? STATUS_WEL : 0U;
+    }
+    else if (command == CMD_READ || command == CMD_PAGE_PROGRAM || command == CMD_SECTOR_ERASE)
+    {
+        if (count < 4U)
+        {
+            address = ((address << 8) | data) & (NOR_SIZE - 1UL);
+        }
+        else if (command == CMD_READ)
+        {
+            out = norMem[(address + count - 4U) & (NOR_SIZE - 1UL)];
+            norStats.readBytes++;
+        }
+        else if (command == CMD_PAGE_PROGRAM)
+        {
+            Program(data);
+        }
+    }
+    count++;
+    return out;
+}
+
+void BL_SpiTransfer(const uint8_t* tx, uint8_t* rx, uint16_t length)
+{
+    uint8_t in;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        in = BL_SpiExchange((tx != NULL) ? tx[i] : BL_SPI_FILL);
+        if (rx != NULL)
+        {
+            rx[i] = in;
+        }
+    }
+}
+
+bool BL_SpiTransferAsync(const uint8_t* tx, uint8_t* rx, uint16_t length,
+                         BlSpiDone_t done, void* context)
+{
+    BL_SpiTransfer(tx, rx, length);
+    if (done != NULL)
+    {
+        done(context);
+    }
+    return true;
+}
+
+bool BL_SpiBusy(void)
+{
+    return false;
+}
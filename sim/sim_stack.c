@@ -0,0 +1,18 @@
+/*
+ * Simulated Stack High-Water Mark
+ *
+ * The host stack says nothing about the PIC24 one, so nothing is painted
+ * and the status record reports size = peak = 0 (unknown).
+ */
+
+#include "bl_stack.h"
+
+void BL_StackPaint(void)
+{
+}
+
+void BL_StackUsage(BlStackUsage_t* out)
+{
+    out->size = 0;
+    out->peak = 0;
+}
@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""
+Host Simulator Regression Test
+
+Runs the upload paths of tools/upload_firmware.py against the host
+simulator (make sim, make sim-auth) and checks the simulated program memory
+against the image after each one, so protocol changes can be checked in CI
+without a PIC24:
+
+  - plain uploads in basic, packed and windowed mode
+  - an in-place patch ('W' plus one page rewrite) and delta updates ('D')
+    there and back
+  - on the BL_AUTH simulator: the tool refuses an unsigned image, the
+    bootloader itself rejects unsigned records sent anyway and leaves no
+    reset vector, and a signed image (development key) is programmed
+
+The test images are generated from a fixed seed. Prints the tool output of
+a failing step and exits non-zero if any step failed.
+
+Usage:
+    python sim/sim_test.py build/sim/bootloader_sim [build/sim/bootloader_sim_auth]
+    make sim-test
+"""
+
+import argparse
+import contextlib
+import io
+import random
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent / "tools"))
+
+from ota_image import APP_DATA, APP_END, APP_START                          # noqa: E402
+from sign_image import sign                                                  # noqa: E402
+from upload_firmware import (ROW_INSTRUCTIONS, BootloaderUploader, pack_records,  # noqa: E402
+                             patch_firmware, send_image, upload_firmware)
+
+SEED = 0x24F64
+ROW_PC_UNITS = ROW_INSTRUCTIONS * 2
+PAGE_PC_UNITS = 8 * ROW_PC_UNITS
+DEV_KEY = b"PIC24 bootloader development key"     # BL_AUTH_KEY, src/bl_auth_key.h
+SIM_TIMING = ["-E", "0", "-R", "0", "-W", "0"]
+
+
+def make_image(rng: random.Random, rows: int) -> dict[int, int]:
+    """'rows' rows of random instructions from APP_START, keyed like hex_image()."""
+    image: dict[int, int] = {}
+    for pc in range(APP_START, APP_START + rows * ROW_PC_UNITS, 2):
+        word = rng.getrandbits(24)
+        image.update({2 * pc: word & 0xFF, 2 * pc + 1: (word >> 8) & 0xFF,
+                      2 * pc + 2: word >> 16, 2 * pc + 3: 0})
+    return image
+
+
+def get_word(image: dict[int, int], pc: int) -> int:
+    return image[2 * pc] | (image[2 * pc + 1] << 8) | (image[2 * pc + 2] << 16)
+
+
+def set_word(image: dict[int, int], pc: int, word: int):
+    image.update({2 * pc: word & 0xFF, 2 * pc + 1: (word >> 8) & 0xFF, 2 * pc + 2: word >> 16, 2 * pc + 3: 0})
+
+
+def patch_target(rng: random.Random, image: dict[int, int]) -> dict[int, int]:
+    """'image' with bits cleared in some instructions ('W') and one row that sets bits (page rewrite)."""
+    target = dict(image)
+    pcs = sorted({(a // 4) * 2 for a in image})
+    for pc in rng.sample(pcs, 24):
+        set_word(target, pc, get_word(image, pc) & rng.getrandbits(24))
+    row = pcs[len(pcs) // 2] - pcs[len(pcs) // 2] % ROW_PC_UNITS
+    for pc in range(row, row + ROW_PC_UNITS, 2):
+        set_word(target, pc, rng.getrandbits(24))
+    return target
+
+
+def delta_target(rng: random.Random, image: dict[int, int]) -> dict[int, int]:
+    """'image' with a block moved by a few instructions (copy ops) and fresh literals."""
+    target = dict(image)
+    pcs = sorted({(a // 4) * 2 for a in image})
+    start = pcs[len(pcs) // 4]
+    for pc in range(start, start + PAGE_PC_UNITS, 2):
+        if pc + 10 in pcs:
+            set_word(target, pc, get_word(image, pc + 10))
+    for pc in rng.sample(pcs, 16):
+        set_word(target, pc, rng.getrandbits(24))
+    return target
+
+
+def write_hex(path: Path, records: list[str]) -> Path:
+    path.write_text("\n".join(records) + "\n")
+    return path
+
+
+def flash_mismatch(flash: Path, image: dict[int, int]) -> str | None:
+    """First application area instruction where the simulated flash differs from 'image', or None."""
+    data = flash.read_bytes()
+    for pc in range(APP_START, APP_END + 2, 2):
+        if pc in APP_DATA:
+            continue
+        got = int.from_bytes(data[(pc // 2) * 3:(pc // 2) * 3 + 3], "little")
+        want = get_word(image, pc) if 2 * pc in image else 0xFFFFFF
+        if got != want:
+            return f"0x{pc:05X}: flash {got:06X}, image {want:06X}"
+    return None
+
+
+class Simulator:
+    """One bootloader_sim process on a fresh flash file, resident (-s)."""
+
+    def __init__(self, binary: Path, flash: Path):
+        self.flash = flash
+        self.log = tempfile.TemporaryFile()
+        self.proc = subprocess.Popen([str(binary), "-f", str(flash), "-s"] + SIM_TIMING,
+                                     stdout=subprocess.PIPE, stderr=self.log, text=True)
+        self.port = self.proc.stdout.readline().strip()
+        if not self.port:
+            raise RuntimeError(f"{binary} did not report a pty")
+
+    def close(self):
+        self.proc.terminate()
+        try:
+            self.proc.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            self.proc.kill()
+            self.proc.wait()
+        self.log.close()
+
+
+class Runner:
+    def __init__(self):
+        self.failed = 0
+
+    def step(self, name: str, action, sim: Simulator, expect_ok: bool = True,
+             image: dict[int, int] | None = None, check=None) -> bool:
+        """Run one tool call; check its result and the flash against 'image' or with 'check()'."""
+        out = io.StringIO()
+        with contextlib.redirect_stdout(out):
+            ok = action()
+        problem = None
+        if ok != expect_ok:
+            problem = "tool reported success" if ok else "tool reported failure"
+        elif image is not None:
+            problem = flash_mismatch(sim.flash, image)
+        elif check is not None:
+            problem = check()
+        print(f"{'PASS' if problem is None else 'FAIL'}  {name}" + (f": {problem}" if problem else ""))
+        if problem is not None:
+            self.failed += 1
+            print(out.getvalue())
+        return problem is None
+
+
+def test_plain(runner: Runner, binary: Path, work: Path, rng: random.Random):
+    image = make_image(rng, 40)
+    hexfile = write_hex(work / "app.hex", pack_records(image, 16))
+    patched = patch_target(rng, image)
+    patch_hex = write_hex(work / "patch.hex", pack_records(patched, 16))
+    moved = delta_target(rng, patched)
+    delta_hex = write_hex(work / "delta.hex", pack_records(moved, 16))
+
+    sim = Simulator(binary, work / "flash.bin")
+    try:
+        for mode in ("basic", "packed", "windowed"):
+            runner.step(f"upload {mode}", lambda: upload_firmware(hexfile, sim.port, jump_to_app=False,
+                                                                  mode=mode), sim, image=image)
+        runner.step("patch", lambda: patch_firmware(patch_hex, sim.port, jump_to_app=False),
+                    sim, image=patched)
+        runner.step("delta", lambda: patch_firmware(delta_hex, sim.port, jump_to_app=False, delta=True,
+                                                    base=patch_hex), sim, image=moved)
+        runner.step("delta back", lambda: patch_firmware(hexfile, sim.port, jump_to_app=False, delta=True),
+                    sim, image=image)
+    finally:
+        sim.close()
+
+
+def send_unchecked(port: str, records: list[str]) -> bool:
+    """Upload 'records' without the tool's checks: what the bootloader alone does with them."""
+    uploader = BootloaderUploader(port=port, verbose=False)
+    if not uploader.connect():
+        return False
+    try:
+        send_image(uploader, records, jump=False)
+        return True
+    except RuntimeError as e:
+        print(e)
+        return False
+    finally:
+        uploader.disconnect()
+
+
+def reset_vector_erased(flash: Path) -> str | None:
+    data = flash.read_bytes()
+    word = int.from_bytes(data[(APP_START // 2) * 3:(APP_START // 2) * 3 + 3], "little")
+    return None if word == 0xFFFFFF else f"reset vector programmed ({word:06X})"
+
+
+def test_auth(runner: Runner, binary: Path, work: Path, rng: random.Random):
+    image = make_image(rng, 24)
+    unsigned_hex = write_hex(work / "auth.hex", pack_records(image, 16))
+    signed_hex = write_hex(work / "auth.signed.hex", sign(image, DEV_KEY)[0])
+
+    sim = Simulator(binary, work / "flash_auth.bin")
+    try:
+        # The tool refuses it up front; the erase never happens
+        runner.step("auth: unsigned refused by the tool",
+                    lambda: upload_firmware(unsigned_hex, sim.port, jump_to_app=False),
+                    sim, expect_ok=False, image={})
+        runner.step("auth: unsigned rejected by the bootloader",
+                    lambda: send_unchecked(sim.port, pack_records(image, 16)),
+                    sim, expect_ok=False, check=lambda: reset_vector_erased(sim.flash))
+        for mode in ("basic", "windowed"):
+            runner.step(f"auth: signed {mode}", lambda: upload_firmware(signed_hex, sim.port, jump_to_app=False,
+                                                                        mode=mode), sim, image=image)
+    finally:
+        sim.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Regression test of the upload paths on the host simulator")
+    parser.add_argument("sim", type=Path, help="build/sim/bootloader_sim")
+    parser.add_argument("sim_auth", type=Path, nargs="?", help="build/sim/bootloader_sim_auth (optional)")
+    args = parser.parse_args()
+
+    runner = Runner()
+    rng = random.Random(SEED)
+    with tempfile.TemporaryDirectory(prefix="blsim_test_") as tmp:
+        work = Path(tmp)
+        test_plain(runner, args.sim, work, rng)
+        if args.sim_auth:
+            test_auth(runner, args.sim_auth, work, rng)
+
+    print("sim-test: " + ("all passed" if runner.failed == 0 else f"{runner.failed} failed"))
+    sys.exit(1 if runner.failed else 0)
+
+
+if __name__ == "__main__":
+    main()
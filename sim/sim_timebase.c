@@ -0,0 +1,32 @@
+/*
+ * Simulated Cycle Timebase
+ *
+ * Host wall-clock time expressed in BL_TIMEBASE_HZ ticks, so code that
+ * converts ticks to time works unchanged. The tick count measures the host,
+ * not a PIC24: compare host numbers only with other host numbers.
+ */
+
+#include <time.h>
+#include "bl_timebase.h"
+
+static struct timespec epoch;
+
+void BL_TimebaseStart(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &epoch);
+}
+
+void BL_TimebaseStop(void)
+{
+}
+
+uint32_t BL_TimebaseNow(void)
+{
+    struct timespec now;
+    uint64_t ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = (uint64_t)(now.tv_sec - epoch.tv_sec) * 1000000000ULL +
+         (uint64_t)(now.tv_nsec - epoch.tv_nsec);
+    return (uint32_t)(ns * (BL_TIMEBASE_HZ / 1000000UL) / 1000ULL);
+}
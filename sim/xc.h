@@ -0,0 +1,14 @@
+/*
+ * Host stand-in for <xc.h>
+ *
+ * Only the SFRs referenced by the portable bootloader sources.
+ */
+
+#ifndef SIM_XC_H
+#define SIM_XC_H
+
+#include <stdint.h>
+
+extern volatile uint16_t DISICNT;
+
+#endif // SIM_XC_H
@@ -0,0 +1,125 @@
+/*
+ * Authenticated Uploads
+ */
+
+#include <string.h>
+#include "bootloader.h"
+#include "bl_auth.h"
+#include "bl_auth_key.h"
+#include "bl_sha256.h"
+#include "bl_counters.h"
+#include "bl_prof.h"
+
+#ifdef BL_AUTH
+
+#define HMAC_IPAD       0x36U
+#define HMAC_OPAD       0x5CU
+#define NO_ROW          0xFFFFFFFFUL
+
+static const uint8_t authKey[BL_SHA256_DIGEST_SIZE] = BL_AUTH_KEY;
+
+static BlSha256_t inner;
+static uint32_t nextRow = NO_ROW;       // lowest row address still allowed, NO_ROW: no session
+static bool vectorHeld;
+static uint32_t vectorRow[FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS];
+static uint8_t mac[BL_AUTH_MAC_SIZE];
+static uint32_t macReceived;            // one bit per MAC byte
+
+// SHA-256 of (key ^ pad) padded to a block, the start of either HMAC hash
+static void KeyBlock(BlSha256_t* ctx, uint8_t pad)
+{
+    uint8_t block[BL_SHA256_BLOCK_SIZE];
+
+    for (uint8_t i = 0; i < BL_SHA256_BLOCK_SIZE; i++)
+    {
+        block[i] = (uint8_t)(((i < sizeof(authKey)) ? authKey[i] : 0U) ^ pad);
+    }
+    BL_Sha256Init(ctx);
+    BL_Sha256Update(ctx, block, BL_SHA256_BLOCK_SIZE);
+}
+
+void BL_AuthBegin(void)
+{
+    KeyBlock(&inner, HMAC_IPAD);
+    nextRow = APP_START_ADDRESS;
+    vectorHeld = false;
+    macReceived = 0;
+}
+
+bool BL_AuthRow(uint32_t address, const uint32_t* words)
+{
+    if (nextRow == NO_ROW)
+    {
+        return false;
+    }
+    if (address < nextRow)
+    {
+        nextRow = NO_ROW;       // out of order or twice: this upload cannot verify
+        return false;
+    }
+    nextRow = address + FLASH_WRITE_ROW_SIZE_IN_PC_UNITS;
+
+    PROF_BEGIN(PROF_AUTH_HASH);
+    BL_Sha256UpdateWords24(&inner, &address, 1U);
+    BL_Sha256UpdateWords24(&inner, words, FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS);
+    PROF_END(PROF_AUTH_HASH);
+
+    if (address == APP_START_ADDRESS)
+    {
+        memcpy(vectorRow, words, sizeof(vectorRow));
+        vectorHeld = true;
+        return false;
+    }
+    return true;
+}
+
+bool BL_AuthMacRecord(uint32_t byteAddress, const uint8_t* data, uint8_t length)
+{
+    uint32_t offset = byteAddress - 2UL * BL_AUTH_MAC_ADDRESS;
+
+    if (byteAddress < 2UL * BL_AUTH_MAC_ADDRESS || offset + length > BL_AUTH_MAC_SIZE)
+    {
+        return false;
+    }
+    memcpy(&mac[offset], data, length);
+    while (length-- != 0U)
+    {
+        macReceived |= 1UL << (offset + length);
+    }
+    return true;
+}
+
+bool BL_AuthFinish(void)
+{
+    BlSha256_t outer;
+    uint8_t digest[BL_SHA256_DIGEST_SIZE];
+    uint8_t differ = 0;
+    bool ok = (nextRow != NO_ROW) && vectorHeld && (macReceived == 0xFFFFFFFFUL);
+
+    if (nextRow != NO_ROW)
+    {
+        PROF_BEGIN(PROF_AUTH_HASH);
+        BL_Sha256Final(&inner, digest);
+        KeyBlock(&outer, HMAC_OPAD);
+        BL_Sha256Update(&outer, digest, sizeof(digest));
+        BL_Sha256Final(&outer, digest);
+        PROF_END(PROF_AUTH_HASH);
+        for (uint8_t i = 0; i < BL_AUTH_MAC_SIZE; i++)
+        {
+            differ |= (uint8_t)(digest[i] ^ mac[i]);    // no early exit
+        }
+    }
+    nextRow = NO_ROW;
+    if (!ok || differ != 0U)
+    {
+        return false;
+    }
+
+    PROF_BEGIN(PROF_FLASH_WRITE_ROW);
+    bool written = FLASH_WriteRow24(APP_START_ADDRESS, vectorRow);
+    PROF_END(PROF_FLASH_WRITE_ROW);
+    blCounters.rowsWritten++;
+    return written && (FLASH_ReadWord24(APP_START_ADDRESS) & 0x00FFFFFFUL) == vectorRow[0];
+}
+
+#endif // BL_AUTH
@@ -0,0 +1,58 @@
+/*
+ * Authenticated Uploads (BL_AUTH builds)
+ *
+ * A direct upload makes the application bootable only if its HMAC-SHA256
+ * (key BL_AUTH_KEY, bl_auth_key.h) checks out. The MAC covers every row the
+ * upload programs, in the order they are committed, which must be ascending:
+ * the row's program address (3 bytes, low byte first), then its 64
+ * instructions, 3 bytes each as the image CRC counts them.
+ * tools/sign_image.py computes the same MAC from the HEX file.
+ *
+ * The hash is updated in the row-commit path (WriteFlashRow, bootloader.c)
+ * before each row is programmed, so the digest is ready when the EOF record
+ * arrives. That is about three SHA-256 blocks per row, fed straight from
+ * the row buffer, and it adds to the row write rather than overlapping it:
+ * RTSP stalls the CPU. The profiler's PROF_AUTH_HASH and the "bench auth"
+ * line of a BL_BENCH build (row_cyc next to flush_cyc) measure it. The row at
+ * APP_START_ADDRESS, which holds the reset vector, is hashed in turn but
+ * held in RAM; BL_AuthFinish programs it only if the MAC matches. Until
+ * then the application area holds no valid application.
+ *
+ * The MAC travels in the signed HEX file as BL_AUTH_MAC_SIZE data bytes at
+ * program address BL_AUTH_MAC_ADDRESS, in configuration space, so
+ * bootloaders without BL_AUTH skip it like any other address outside the
+ * application area.
+ *
+ * Rows are taken only after 'E' erased the whole application area, so an
+ * upload can never clear bits of an application that is still bootable.
+ * Everything else that writes the area is left out of BL_AUTH builds: the
+ * 'W', 'D', 'E<addr>' and 'T' commands, golden images ('G' and the restore
+ * after failed boots) and application-staged installs, which would program
+ * images from the NOR that no MAC covers.
+ */
+
+#ifndef BL_AUTH_H
+#define BL_AUTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(BL_AUTH) && defined(BL_SMALL)
+#error "BL_AUTH needs the full build"
+#endif
+
+#define BL_AUTH_MAC_ADDRESS     0xFE0000UL  // program address; HEX byte address 0x1FC0000
+#define BL_AUTH_MAC_SIZE        32U
+
+// Start an upload session, after the application area was erased.
+void BL_AuthBegin(void);
+// Hash the row at 'address' as it is committed. True if it is to be
+// programmed now; false for the held reset vector row and for rows outside
+// a session or after one out of order.
+bool BL_AuthRow(uint32_t address, const uint32_t* words);
+// Take HEX data at 'byteAddress' if it is part of the MAC.
+bool BL_AuthMacRecord(uint32_t byteAddress, const uint8_t* data, uint8_t length);
+// At the EOF record: check the MAC and program the held row. Ends the session.
+bool BL_AuthFinish(void);
+
+#endif // BL_AUTH_H
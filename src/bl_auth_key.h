@@ -0,0 +1,19 @@
+/*
+ * Upload Authentication Key
+ *
+ * The HMAC-SHA256 key of BL_AUTH builds (bl_auth.h), 32 bytes. This one is
+ * the ASCII text "PIC24 bootloader development key" and signs test images
+ * only: a product build replaces it with its own random key, kept out of
+ * version control like the key file tools/sign_image.py reads.
+ */
+
+#ifndef BL_AUTH_KEY_H
+#define BL_AUTH_KEY_H
+
+#define BL_AUTH_KEY \
+{ \
+    0x50, 0x49, 0x43, 0x32, 0x34, 0x20, 0x62, 0x6F, 0x6F, 0x74, 0x6C, 0x6F, 0x61, 0x64, 0x65, 0x72, \
+    0x20, 0x64, 0x65, 0x76, 0x65, 0x6C, 0x6F, 0x70, 0x6D, 0x65, 0x6E, 0x74, 0x20, 0x6B, 0x65, 0x79, \
+}
+
+#endif // BL_AUTH_KEY_H
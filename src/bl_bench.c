@@ -0,0 +1,344 @@
+/*
+ * Parser / Row Assembly Benchmark
+ *
+ * Corpora (all start at APP_START_ADDRESS and cover BENCH_ROWS rows):
+ *   dense   16-byte records in address order, as XC16 bin2hex emits them
+ *   sparse  one instruction every 16, so most of each row is padding
+ *   ooo     16-byte records alternating between two halves of the range,
+ *           forcing a row flush on every record
+ *   maxlen  56-byte records, the longest that fits RX_BUFFER_SIZE
+ *
+ * Reported per corpus (ticks of BL_TimebaseNow()):
+ *   rec_cyc     Bootloader_ParseHexLine per record, including row flushes
+ *   byte_cyc    the same per programmed byte (3 per instruction)
+ *   hex_cyc     Bootloader_HexToByte per call
+ *   init_cyc    row-buffer 0xFF initialization per row
+ *   flush_cyc   FlushFlashBuffer row write per row
+ *
+ * SPI1 throughput (bl_spi.c, not in BL_SMALL builds), one line per SCK and
+ * transfer style with no chip select asserted:
+ *   byte    BL_SpiExchange per byte (TX, wait for RX, as MCC spi1.c does)
+ *   burst   BL_SpiTransfer, FIFO kept full
+ *   async   BL_SpiTransferAsync from the SPI1 interrupt, main loop waiting
+ * bps is bytes per second of timebase time, util the share of it SCK was
+ * busy (8 bits per byte at the SCK set).
+ *
+ * HMAC (BL_AUTH builds, bl_auth.h), BENCH_ROWS rows:
+ *   row_cyc     BL_AuthRow per row, in series with the row write (flush_cyc
+ *               of the corpora above)
+ *   finish_cyc  BL_AuthFinish, the outer hash and compare at EOF
+ */
+
+#ifdef BL_BENCH
+
+#include "bootloader.h"
+#include "bl_bench.h"
+#include "bl_spi.h"
+#include "bl_auth.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_ROWS              16
+#define BENCH_INSTRUCTIONS      (BENCH_ROWS * FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS)
+#define BENCH_MAX_RECORD_INSN   (HEX_RECORD_MAX_BYTES / 4)
+#define BENCH_HEX_CALLS         1024
+#define BENCH_SPI_CHUNK         256
+#define BENCH_SPI_CHUNKS        4
+
+typedef enum
+{
+    CORPUS_DENSE,
+    CORPUS_SPARSE,
+    CORPUS_OUT_OF_ORDER,
+    CORPUS_MAX_LENGTH,
+    CORPUS_COUNT
+} BenchCorpus_t;
+
+static const char* const corpusName[CORPUS_COUNT] = { "dense", "sparse", "ooo", "maxlen" };
+
+BlBenchRowStats_t blBenchRow;
+
+static char line[RX_BUFFER_SIZE];
+static char report[160];
+static uint32_t seed;
+
+static uint32_t NextInstruction(void)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (seed >> 8) & 0x00FFFFFFUL;
+}
+
+static char* PutHexByte(char* p, uint8_t value)
+{
+    static const char digits[] = "0123456789ABCDEF";
+
+    *p++ = digits[value >> 4];
+    *p++ = digits[value & 0x0F];
+    return p;
+}
+
+static void FormatRecord(uint8_t type, uint16_t address, const uint8_t* data, uint8_t length)
+{
+    uint8_t sum = length + (address >> 8) + (address & 0xFF) + type;
+    char* p = line;
+
+    *p++ = ':';
+    p = PutHexByte(p, length);
+    p = PutHexByte(p, address >> 8);
+    p = PutHexByte(p, address & 0xFF);
+    p = PutHexByte(p, type);
+    for (uint8_t i = 0; i < length; i++)
+    {
+        p = PutHexByte(p, data[i]);
+        sum += data[i];
+    }
+    p = PutHexByte(p, (uint8_t)(~sum + 1));
+    *p = '\0';
+}
+
+// Append " key=<ticks/count>" with two decimals (host ticks are short).
+static char* PutPer(char* p, const char* key, uint32_t ticks, uint32_t count)
+{
+    uint32_t centi = count ? (uint32_t)(((uint64_t)ticks * 100U) / count) : 0;
+
+    return p + sprintf(p, "%s%lu.%02lu", key,
+                       (unsigned long)(centi / 100U), (unsigned long)(centi % 100U));
+}
+
+// Record n of a corpus: PC address and instruction count. Returns false past the end.
+static bool CorpusRecord(BenchCorpus_t corpus, uint16_t n, uint32_t* pc, uint8_t* count)
+{
+    uint32_t base = APP_START_ADDRESS;
+
+    switch (corpus)
+    {
+        case CORPUS_DENSE:
+            *count = 4;
+            *pc = base + (uint32_t)n * 8;
+            return n < BENCH_INSTRUCTIONS / 4;
+
+        case CORPUS_SPARSE:
+            *count = 1;
+            *pc = base + (uint32_t)n * 32;
+            return n < BENCH_INSTRUCTIONS / 16;
+
+        case CORPUS_OUT_OF_ORDER:
+            *count = 4;
+            *pc = base + (uint32_t)(n & 1) * (BENCH_INSTRUCTIONS / 2) * 2 + (uint32_t)(n >> 1) * 8;
+            return n < BENCH_INSTRUCTIONS / 4;
+
+        case CORPUS_MAX_LENGTH:
+            *count = BENCH_MAX_RECORD_INSN;
+            *pc = base + (uint32_t)n * BENCH_MAX_RECORD_INSN * 2;
+            return n < BENCH_INSTRUCTIONS / BENCH_MAX_RECORD_INSN;
+
+        default:
+            return false;
+    }
+}
+
+static void RunCorpus(BenchCorpus_t corpus, BlBenchPrint_t print)
+{
+    uint8_t data[BENCH_MAX_RECORD_INSN * 4];
+    uint32_t parseTicks = 0;
+    uint32_t bytes = 0;
+    uint16_t records = 0;
+    uint32_t pc;
+    uint8_t count;
+    uint32_t t0;
+
+    Bootloader_EraseAppArea();
+    Bootloader_Initialize();
+    memset(&blBenchRow, 0, sizeof(blBenchRow));
+    seed = 1;
+
+    while (CorpusRecord(corpus, records, &pc, &count))
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            uint32_t insn = NextInstruction();
+            data[i * 4 + 0] = (uint8_t)insn;
+            data[i * 4 + 1] = (uint8_t)(insn >> 8);
+            data[i * 4 + 2] = (uint8_t)(insn >> 16);
+            data[i * 4 + 3] = 0;
+        }
+        FormatRecord(HEX_DATA_RECORD, (uint16_t)(pc * 2), data, count * 4);
+
+        t0 = BL_TimebaseNow();
+        Bootloader_ParseHexLine(line);
+        parseTicks += BL_TimebaseNow() - t0;
+
+        bytes += (uint32_t)count * 3;
+        records++;
+    }
+
+    // EOF flushes the last row; its cost belongs to the corpus.
+    FormatRecord(HEX_EOF_RECORD, 0, data, 0);
+    t0 = BL_TimebaseNow();
+    Bootloader_ParseHexLine(line);
+    parseTicks += BL_TimebaseNow() - t0;
+
+    // HexToByte in isolation, over the digits of a full-length data record.
+    FormatRecord(HEX_DATA_RECORD, 0, data, sizeof(data));
+    volatile uint8_t sink = 0;
+    t0 = BL_TimebaseNow();
+    for (uint16_t i = 0; i < BENCH_HEX_CALLS; i++)
+    {
+        sink ^= Bootloader_HexToByte(&line[1 + (i % sizeof(data)) * 2]);
+    }
+    uint32_t hexTicks = BL_TimebaseNow() - t0;
+    (void)sink;
+
+    char* p = report;
+    p += sprintf(p, "bench corpus=%s records=%u bytes=%lu",
+                 corpusName[corpus], records, (unsigned long)bytes);
+    p = PutPer(p, " rec_cyc=", parseTicks, records);
+    p = PutPer(p, " byte_cyc=", parseTicks, bytes);
+    p = PutPer(p, " hex_cyc=", hexTicks, BENCH_HEX_CALLS);
+    p = PutPer(p, " init_cyc=", blBenchRow.rowInitTicks, blBenchRow.rowInits);
+    p = PutPer(p, " flush_cyc=", blBenchRow.flushTicks, blBenchRow.flushes);
+    sprintf(p, " rows=%lu\r\n", (unsigned long)blBenchRow.flushes);
+    print(report);
+}
+
+#ifdef BL_AUTH
+
+static void RunAuth(BlBenchPrint_t print)
+{
+    static uint32_t words[FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS];
+    uint32_t rowTicks;
+    uint32_t finishTicks;
+    uint32_t t0;
+
+    seed = 1;
+    for (uint8_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+    {
+        words[i] = NextInstruction();
+    }
+
+    // Rows after the reset vector row, which BL_AuthRow would copy and hold
+    BL_AuthBegin();
+    t0 = BL_TimebaseNow();
+    for (uint16_t r = 1; r <= BENCH_ROWS; r++)
+    {
+        (void)BL_AuthRow(APP_START_ADDRESS + (uint32_t)r * FLASH_WRITE_ROW_SIZE_IN_PC_UNITS, words);
+    }
+    rowTicks = BL_TimebaseNow() - t0;
+
+    // No MAC arrived: fails after the full check, programs nothing
+    t0 = BL_TimebaseNow();
+    (void)BL_AuthFinish();
+    finishTicks = BL_TimebaseNow() - t0;
+
+    char* p = report;
+    p += sprintf(p, "bench auth rows=%u", BENCH_ROWS);
+    p = PutPer(p, " row_cyc=", rowTicks, BENCH_ROWS);
+    p = PutPer(p, " finish_cyc=", finishTicks, 1);
+    sprintf(p, "\r\n");
+    print(report);
+}
+
+#endif // BL_AUTH
+
+#ifndef BL_SMALL
+
+typedef enum
+{
+    SPI_BYTE,
+    SPI_BURST,
+    SPI_ASYNC,
+    SPI_STYLE_COUNT
+} BenchSpiStyle_t;
+
+static const char* const spiStyleName[SPI_STYLE_COUNT] = { "byte", "burst", "async" };
+
+// MCC spi1.c setting (64:1, 8:1), 1 MHz, 4 MHz (the old NOR setting), maximum
+static const uint32_t spiClocks[] = { 31250UL, 1000000UL, 4000000UL, BL_SPI_MAX_HZ };
+
+static uint8_t spiBuffer[BENCH_SPI_CHUNK];
+
+static void RunSpi(uint32_t hz, BenchSpiStyle_t style, BlBenchPrint_t print)
+{
+    const uint32_t bytes = (uint32_t)BENCH_SPI_CHUNK * BENCH_SPI_CHUNKS;
+    uint32_t sck = BL_SpiSetClock(hz);
+    uint32_t ticks;
+    uint32_t bps;
+    uint32_t t0;
+
+    for (uint16_t i = 0; i < BENCH_SPI_CHUNK; i++)
+    {
+        spiBuffer[i] = (uint8_t)i;
+    }
+
+    t0 = BL_TimebaseNow();
+    for (uint8_t c = 0; c < BENCH_SPI_CHUNKS; c++)
+    {
+        switch (style)
+        {
+            case SPI_BYTE:
+                for (uint16_t i = 0; i < BENCH_SPI_CHUNK; i++)
+                {
+                    spiBuffer[i] = BL_SpiExchange(spiBuffer[i]);
+                }
+                break;
+
+            case SPI_BURST:
+                BL_SpiTransfer(spiBuffer, spiBuffer, BENCH_SPI_CHUNK);
+                break;
+
+            default:
+                BL_SpiTransferAsync(spiBuffer, spiBuffer, BENCH_SPI_CHUNK, NULL, NULL);
+                while (BL_SpiBusy()) { ; }
+                break;
+        }
+    }
+    ticks = BL_TimebaseNow() - t0;
+    if (ticks == 0U)
+    {
+        ticks = 1;
+    }
+
+    bps = (uint32_t)(((uint64_t)bytes * BL_TIMEBASE_HZ) / ticks);
+    sprintf(report, "bench spi hz=%lu mode=%s bytes=%lu cyc=%lu bps=%lu util=%lu%%\r\n",
+            (unsigned long)sck, spiStyleName[style], (unsigned long)bytes,
+            (unsigned long)ticks, (unsigned long)bps,
+            (unsigned long)(((uint64_t)bps * 800U) / sck));
+    print(report);
+}
+
+#endif // BL_SMALL
+
+void BL_BenchRun(BlBenchPrint_t print)
+{
+#ifdef BL_SIM
+    print("bench timebase=host_ns_as_16MHz\r\n");
+#else
+    print("bench timebase=fcy_cycles\r\n");
+#endif
+
+    for (BenchCorpus_t c = 0; c < CORPUS_COUNT; c++)
+    {
+        RunCorpus(c, print);
+    }
+#ifdef BL_AUTH
+    RunAuth(print);
+#endif
+
+#ifndef BL_SMALL
+    // Chip selects stay high: SCK and MOSI run, no device listens
+    BL_SpiOpen(BL_SPI_MODE0, BL_SPI_MAX_HZ);
+    for (uint8_t h = 0; h < sizeof(spiClocks) / sizeof(spiClocks[0]); h++)
+    {
+        for (BenchSpiStyle_t style = 0; style < SPI_STYLE_COUNT; style++)
+        {
+            RunSpi(spiClocks[h], style, print);
+        }
+    }
+#endif
+
+    // Leave no half-valid image behind (and SPI1 set up for the NOR again).
+    Bootloader_EraseAppArea();
+    Bootloader_Initialize();
+}
+
+#endif // BL_BENCH
@@ -0,0 +1,48 @@
+/*
+ * Parser / Row Assembly Benchmark
+ *
+ * Built only with -DBL_BENCH. Feeds synthetic Intel HEX corpora through
+ * Bootloader_ParseHexLine and reports cost per record and per programmed
+ * byte in BL_TimebaseNow() ticks (instruction cycles on target), then times
+ * SPI1 transfers at several clocks. The run erases and programs the
+ * application area.
+ *
+ * Output is one "key=value" line per corpus so runs can be diffed against a
+ * saved baseline.
+ */
+
+#ifndef BL_BENCH_H
+#define BL_BENCH_H
+
+#include <stdint.h>
+#include "bl_timebase.h"
+
+typedef void (*BlBenchPrint_t)(const char* line);
+
+#ifdef BL_BENCH
+
+// Row assembly cost, accumulated inside bootloader.c.
+typedef struct
+{
+    uint32_t rowInitTicks;
+    uint32_t rowInits;
+    uint32_t flushTicks;
+    uint32_t flushes;
+} BlBenchRowStats_t;
+
+extern BlBenchRowStats_t blBenchRow;
+
+#define BL_BENCH_BEGIN(t)               uint32_t t = BL_TimebaseNow()
+#define BL_BENCH_END(t, ticks, count)   do { blBenchRow.ticks += BL_TimebaseNow() - (t); \
+                                             blBenchRow.count++; } while (0)
+
+void BL_BenchRun(BlBenchPrint_t print);
+
+#else
+
+#define BL_BENCH_BEGIN(t)
+#define BL_BENCH_END(t, ticks, count)
+
+#endif // BL_BENCH
+
+#endif // BL_BENCH_H
@@ -0,0 +1,61 @@
+/*
+ * Boot Event Log
+ */
+
+#include <stdbool.h>
+#include "bl_bootlog.h"
+#include "bl_timebase.h"
+
+BlBootLog_t blBootLog __attribute__((persistent, section(".bl_log")));
+
+#define TICKS_PER_MS    (BL_TIMEBASE_HZ / 1000UL)
+
+static bool BootLogValid(void)
+{
+    return (blBootLog.magic == BL_BOOT_LOG_MAGIC) &&
+           (blBootLog.version == BL_BOOT_LOG_VERSION) &&
+           (blBootLog.entries == BL_BOOT_LOG_ENTRIES) &&
+           (blBootLog.head < BL_BOOT_LOG_ENTRIES) &&
+           (blBootLog.count <= BL_BOOT_LOG_ENTRIES);
+}
+
+void BL_BootLogBegin(uint8_t path, uint16_t rcon, uint16_t appStage)
+{
+    BlBootEvent_t* e;
+
+    if (!BootLogValid())
+    {
+        // Power-up RAM contents
+        blBootLog.magic = BL_BOOT_LOG_MAGIC;
+        blBootLog.version = BL_BOOT_LOG_VERSION;
+        blBootLog.entries = BL_BOOT_LOG_ENTRIES;
+        blBootLog.head = BL_BOOT_LOG_ENTRIES - 1U;
+        blBootLog.count = 0;
+        blBootLog.seq = 0;
+    }
+
+    blBootLog.head = (blBootLog.head + 1U) % BL_BOOT_LOG_ENTRIES;
+    if (blBootLog.count < BL_BOOT_LOG_ENTRIES)
+    {
+        blBootLog.count++;
+    }
+
+    e = &blBootLog.event[blBootLog.head];
+    e->rcon = rcon;
+    e->appStage = appStage;
+    e->timeMs = BL_BOOT_TIME_OPEN;
+    e->path = path;
+    e->seq = (uint8_t)blBootLog.seq++;
+}
+
+void BL_BootLogLeave(void)
+{
+    uint32_t ms = BL_TimebaseNow() / TICKS_PER_MS;
+
+    if (blBootLog.count == 0)
+    {
+        return;
+    }
+    blBootLog.event[blBootLog.head].timeMs =
+        (ms < BL_BOOT_TIME_OPEN) ? (uint16_t)ms : (uint16_t)(BL_BOOT_TIME_OPEN - 1U);
+}
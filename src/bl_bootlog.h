@@ -0,0 +1,67 @@
+/*
+ * Boot Event Log
+ *
+ * Ring of the last BL_BOOT_LOG_ENTRIES boots in persistent RAM (.bl_log,
+ * BL_BOOT_LOG_ADDRESS; both linker scripts reserve it). Each entry records
+ * the reset cause, which way the bootloader left, the application's appStage
+ * as it was at the reset, and how long the bootloader ran. A run of
+ * BL_BOOT_PATH_APP entries with a trap/WDT RCON and the same appStage is an
+ * application that keeps resetting at the same point.
+ *
+ * The log survives every reset except a power loss (it is re-initialized
+ * when the header does not check out). 'H' returns the whole BlBootLog_t as
+ * one hex-encoded line (see Bootloader_SendHexBlock).
+ */
+
+#ifndef BL_BOOTLOG_H
+#define BL_BOOTLOG_H
+
+#include <stdint.h>
+
+#define BL_BOOT_LOG_ADDRESS     0x1280U
+#define BL_BOOT_LOG_MAGIC       0x4C42U     // 'BL'
+#define BL_BOOT_LOG_VERSION     1U
+#define BL_BOOT_LOG_ENTRIES     15U         // 8-byte header + 15 * 8 = 128 bytes
+
+// BlBootEvent_t.path
+#define BL_BOOT_PATH_APP        1U          // valid app, started right away
+#define BL_BOOT_PATH_JUMP       2U          // host 'J': reset, then started the app
+#define BL_BOOT_PATH_NO_APP     3U          // no valid app, stayed resident
+#define BL_BOOT_PATH_REQUEST    4U          // app entry request (touch), stayed resident
+#define BL_BOOT_PATH_GOLDEN     5U          // app kept failing: golden image restored, reset to it
+#define BL_BOOT_PATH_INSTALL    6U          // app-staged install ran (BL_INSTALL_REPORT), reset to the app
+
+// BlBootEvent_t.timeMs while the bootloader has not left yet. Still set in
+// an older entry: that boot ended in a reset the bootloader did not issue.
+#define BL_BOOT_TIME_OPEN       0xFFFFU
+
+typedef struct
+{
+    uint16_t rcon;          // RCON at bootloader entry
+    uint16_t appStage;      // appStage left behind by the application
+    uint16_t timeMs;        // C entry to leaving the bootloader, saturates at 0xFFFE
+    uint8_t  path;          // BL_BOOT_PATH_xxx
+    uint8_t  seq;           // boot number since the log was initialized, mod 256
+} BlBootEvent_t;
+
+typedef struct
+{
+    uint16_t magic;         // BL_BOOT_LOG_MAGIC
+    uint8_t  version;       // BL_BOOT_LOG_VERSION
+    uint8_t  entries;       // BL_BOOT_LOG_ENTRIES
+    uint8_t  head;          // index of the newest event
+    uint8_t  count;         // valid events, oldest at head - count + 1
+    uint16_t seq;           // boots logged since the log was initialized
+    BlBootEvent_t event[BL_BOOT_LOG_ENTRIES];
+} BlBootLog_t;
+
+extern BlBootLog_t blBootLog;
+
+// Append this boot. Call once per reset, as soon as the path is known.
+void BL_BootLogBegin(uint8_t path, uint16_t rcon, uint16_t appStage);
+
+// Record the time spent in the bootloader. Call right before leaving
+// (jump to the app or a RESET issued by the bootloader).
+void BL_BootLogLeave(void);
+
+#endif // BL_BOOTLOG_H
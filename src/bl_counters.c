@@ -0,0 +1,27 @@
+/*
+ * Performance Counters
+ */
+
+#include <xc.h>
+#include <string.h>
+#include "bl_counters.h"
+
+BlCounters_t blCounters;
+
+void BL_CountersSnapshot(BlCounters_t* out)
+{
+    __builtin_disi(0x3FFF);
+    *out = blCounters;
+    DISICNT = 0;
+
+    out->version = BL_COUNTERS_VERSION;
+    out->size = sizeof(BlCounters_t);
+    out->reserved = 0;
+}
+
+void BL_CountersClear(void)
+{
+    __builtin_disi(0x3FFF);
+    memset(&blCounters, 0, sizeof(blCounters));
+    DISICNT = 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * Performance Counters
+ *
+ * Cumulative event counts since power-up or the last 'Z' command. 'K'
+ * returns the whole block as one hex-encoded line (see
+ * Bootloader_SendHexBlock), copied with interrupts disabled so a count bumped
+ * by the USB interrupt cannot tear the snapshot.
+ *
+ * The layout is little-endian and append-only: new counters go at the end,
+ * and the host uses 'size' to tell which ones the device has.
+ */
+
+#ifndef BL_COUNTERS_H
+#define BL_COUNTERS_H
+
+#include <stdint.h>
+
+#define BL_COUNTERS_VERSION     1U
+
+typedef struct
+{
+    uint8_t  version;           // BL_COUNTERS_VERSION
+    uint8_t  size;              // sizeof(BlCounters_t)
+    uint16_t reserved;
+    uint32_t recordsParsed;     // HEX records seen by Bootloader_ParseHexLine
+    uint32_t checksumErrors;    // HEX records rejected for a bad checksum
+    uint32_t rowsWritten;       // FLASH_WriteRow24 calls
+    uint32_t pagesErased;       // FLASH_ErasePage calls
+    uint32_t pagesSkipped;      // app pages already blank, not erased
+    uint32_t rxOverruns;        // command lines truncated at RX_BUFFER_SIZE
+    uint32_t txStalls;          // responses that had to wait for the IN endpoint
+    uint32_t usbBusErrors;      // EVENT_BUS_ERROR (USB interrupt)
+    uint32_t mainLoops;         // bootloader main loop iterations
+    uint32_t wordsWritten;      // instructions patched in place ('W')
+} BlCounters_t;
+
+extern BlCounters_t blCounters;
+
+void BL_CountersSnapshot(BlCounters_t* out);
+void BL_CountersClear(void);
+
+#endif // BL_COUNTERS_H
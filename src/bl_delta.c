@@ -0,0 +1,218 @@
+/*
+ * Delta Page Updates
+ */
+
+#include "bootloader.h"
+#include "bl_delta.h"
+#include "bl_crc.h"
+#include "bl_counters.h"
+#include "bl_prof.h"
+
+#ifndef BL_SMALL
+
+#define PAGE_ROWS       (FLASH_ERASE_PAGE_SIZE_IN_INSTRUCTIONS / FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS)
+#define ROW_BYTES       (FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS * 3U)
+#define ERASED_WORD     0x00FFFFFFUL
+#define NO_PAGE         0xFFFFFFFFUL
+
+#define OP_COPY         0x80U
+#define OP_ERASED       0xC0U
+
+static uint8_t* pageBytes;
+static uint32_t pageAddress = NO_PAGE;
+static uint16_t fill;               // instructions rebuilt so far
+
+BlDeltaResult_t BL_DeltaOpen(uint32_t* page, uint32_t address)
+{
+    pageAddress = NO_PAGE;
+    if ((address & (FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS - 1UL)) != 0U ||
+        address < APP_START_ADDRESS || address > APP_END_ADDRESS ||
+        IS_APP_DATA_ADDRESS(address))
+    {
+        return BL_DELTA_ARGS;
+    }
+    pageBytes = (uint8_t*)page;
+    pageAddress = address;
+    fill = 0;
+    return BL_DELTA_OK;
+}
+
+bool BL_DeltaActive(void)
+{
+    return pageAddress != NO_PAGE;
+}
+
+void BL_DeltaCancel(void)
+{
+    pageAddress = NO_PAGE;
+}
+
+static void PutWord(uint32_t word)
+{
+    uint8_t* p = &pageBytes[3U * fill++];
+
+    p[0] = (uint8_t)word;
+    p[1] = (uint8_t)(word >> 8);
+    p[2] = (uint8_t)(word >> 16);
+}
+
+// Copy or erased run: 'count' instructions, from 'source' if not erased
+static bool PutRun(uint16_t count, bool erased, uint32_t source)
+{
+    if (!erased && (source < APP_START_ADDRESS ||
+                    source + 2UL * count > APP_END_ADDRESS + 2UL))
+    {
+        return false;
+    }
+    while (count-- != 0U)
+    {
+        PutWord(erased ? ERASED_WORD : (FLASH_ReadWord24(source) & ERASED_WORD));
+        source += 2;
+    }
+    return true;
+}
+
+BlDeltaResult_t BL_DeltaApply(const uint8_t* ops, uint8_t length)
+{
+    uint8_t i = 0;
+    uint8_t op;
+    uint16_t count;
+    uint16_t left;
+    bool ok = true;
+
+    if (pageAddress == NO_PAGE)
+    {
+        return BL_DELTA_ARGS;
+    }
+    while (ok && i < length)
+    {
+        op = ops[i++];
+        left = FLASH_ERASE_PAGE_SIZE_IN_INSTRUCTIONS - fill;
+        if (op < OP_COPY)
+        {
+            count = (uint16_t)op + 1U;
+            ok = count <= left && 3U * count <= (uint16_t)(length - i);
+            for (; ok && count != 0U; count--, i += 3U)
+            {
+                PutWord((uint32_t)ops[i] | ((uint32_t)ops[i + 1U] << 8) |
+                        ((uint32_t)ops[i + 2U] << 16));
+            }
+            continue;
+        }
+
+        ok = i < length;
+        count = ok ? (uint16_t)((((uint16_t)op & 0x3FU) << 8) | ops[i++]) + 1U : 0U;
+        ok = ok && count <= left;
+        if (op < OP_ERASED)
+        {
+            ok = ok && i + 2U <= length &&
+                 PutRun(count, false, 2UL * ((uint16_t)ops[i] | ((uint16_t)ops[i + 1U] << 8)));
+            i += 2U;
+        }
+        else
+        {
+            ok = ok && PutRun(count, true, 0);
+        }
+    }
+    if (!ok)
+    {
+        pageAddress = NO_PAGE;
+        return BL_DELTA_BAD_OP;
+    }
+    return BL_DELTA_OK;
+}
+
+static bool RowDiffers(uint32_t address, const uint8_t* packed)
+{
+    uint32_t word;
+
+    for (uint8_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++, packed += 3)
+    {
+        word = (uint32_t)packed[0] | ((uint32_t)packed[1] << 8) | ((uint32_t)packed[2] << 16);
+        if ((FLASH_ReadWord24(address + 2U * i) & ERASED_WORD) != word)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Row 'r' of the page, unpacked in place; false if it is all erased
+static bool UnpackRow(uint8_t r, uint32_t* words)
+{
+    const uint8_t* data = &pageBytes[(uint16_t)r * ROW_BYTES];
+    bool erased = true;
+
+    // From the end: word k only overwrites bytes of instructions >= k
+    for (uint8_t k = FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; k-- != 0U; )
+    {
+        words[k] = (uint32_t)data[3U * k] | ((uint32_t)data[3U * k + 1U] << 8) |
+                   ((uint32_t)data[3U * k + 2U] << 16);
+        if (words[k] != ERASED_WORD)
+        {
+            erased = false;
+        }
+    }
+    return !erased;
+}
+
+static bool WriteRow(uint32_t address, uint32_t* words)
+{
+    PROF_BEGIN(PROF_FLASH_WRITE_ROW);
+    bool written = FLASH_WriteRow24(address, words);
+    PROF_END(PROF_FLASH_WRITE_ROW);
+    blCounters.rowsWritten++;
+    for (uint8_t i = 0; written && i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+    {
+        written = (FLASH_ReadWord24(address + 2U * i) & ERASED_WORD) == words[i];
+    }
+    return written;
+}
+
+BlDeltaResult_t BL_DeltaCommit(uint32_t crc)
+{
+    uint32_t address = pageAddress;
+    bool differs = false;
+    uint32_t* words;
+    uint8_t r;
+
+    pageAddress = NO_PAGE;
+    if (address == NO_PAGE || fill != FLASH_ERASE_PAGE_SIZE_IN_INSTRUCTIONS)
+    {
+        return BL_DELTA_ARGS;
+    }
+    if (BL_Crc32Final(BL_Crc32Update(BL_CRC32_INIT, pageBytes, BL_DELTA_PAGE_BYTES)) != crc)
+    {
+        return BL_DELTA_CRC_MISMATCH;
+    }
+    for (r = 0; r < PAGE_ROWS && !differs; r++)
+    {
+        differs = RowDiffers(address + (uint32_t)r * FLASH_WRITE_ROW_SIZE_IN_PC_UNITS,
+                             &pageBytes[(uint16_t)r * ROW_BYTES]);
+    }
+    if (!differs)
+    {
+        return BL_DELTA_UNCHANGED;
+    }
+
+    PROF_BEGIN(PROF_FLASH_ERASE);
+    bool erased = FLASH_ErasePage(address);
+    PROF_END(PROF_FLASH_ERASE);
+    if (!erased)
+    {
+        return BL_DELTA_FLASH_ERROR;
+    }
+    blCounters.pagesErased++;
+    for (r = PAGE_ROWS; r-- != 0U; )
+    {
+        words = (uint32_t*)&pageBytes[(uint16_t)r * ROW_BYTES];
+        if (UnpackRow(r, words) &&
+            !WriteRow(address + (uint32_t)r * FLASH_WRITE_ROW_SIZE_IN_PC_UNITS, words))
+        {
+            return BL_DELTA_FLASH_ERROR;
+        }
+    }
+    return BL_DELTA_OK;
+}
+
+#endif // BL_SMALL
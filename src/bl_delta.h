@@ -0,0 +1,65 @@
+/*
+ * Delta Page Updates
+ *
+ * Rebuilds one application page in RAM from the flash that is there now
+ * plus what the host sends ('D', bootloader.c), then erases and programs
+ * it. A relinked application mostly moves code around, so most of a new
+ * page can be copied from somewhere in the old flash and only the rest
+ * crosses the link.
+ *
+ * The page is assembled packed, 3 bytes per instruction in order, as the
+ * image CRC counts it. Operations, one after the other:
+ *
+ *   0x00..0x7F       literal: (op + 1) instructions follow, 3 bytes each
+ *   0x80..0xBF n     copy: ((op & 0x3F) << 8 | n) + 1 instructions from
+ *        lo hi       program address 2 * (hi << 8 | lo), read from flash
+ *   0xC0..0xFF n     erased: ((op & 0x3F) << 8 | n) + 1 x 0xFFFFFF
+ *
+ * Copies read the flash as it is before this page is erased, the page
+ * itself included, anywhere in [APP_START_ADDRESS, APP_END_ADDRESS].
+ * Pages already rebuilt read as their new contents.
+ *
+ * BL_DeltaCommit needs all FLASH_ERASE_PAGE_SIZE_IN_INSTRUCTIONS
+ * instructions and the CRC-32 of the packed page. A page that already holds
+ * them is not touched. Otherwise the page is erased and its rows are
+ * programmed last to first, so row 0 of the application's first page (the
+ * reset vector) goes in last. Each row is unpacked in place for
+ * FLASH_WriteRow24, into the bytes of the row after it, which is already
+ * programmed; the last row runs BL_DELTA_SPARE_WORDS past the packed page.
+ *
+ * An operation that runs past the page or copies from outside the
+ * application area closes the page; the host starts it again.
+ */
+
+#ifndef BL_DELTA_H
+#define BL_DELTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BL_DELTA_PAGE_BYTES     (FLASH_ERASE_PAGE_SIZE_IN_INSTRUCTIONS * 3UL)
+#define BL_DELTA_SPARE_WORDS    (FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS / 4U)
+// Buffer for BL_DeltaOpen, in words
+#define BL_DELTA_PAGE_WORDS     (BL_DELTA_PAGE_BYTES / 4U + BL_DELTA_SPARE_WORDS)
+
+typedef enum
+{
+    BL_DELTA_OK = 0,
+    BL_DELTA_UNCHANGED,         // the page already held the rebuilt contents
+    BL_DELTA_ARGS,              // no page open, bad address or not complete
+    BL_DELTA_BAD_OP,            // malformed operation, page closed
+    BL_DELTA_CRC_MISMATCH,      // rebuilt page is not what the host expects
+    BL_DELTA_FLASH_ERROR,
+} BlDeltaResult_t;
+
+// Start rebuilding the page at 'address' in 'page' (BL_DELTA_PAGE_WORDS).
+// Any page still open is dropped.
+BlDeltaResult_t BL_DeltaOpen(uint32_t* page, uint32_t address);
+// Apply 'length' bytes of whole operations.
+BlDeltaResult_t BL_DeltaApply(const uint8_t* ops, uint8_t length);
+// Check the page against 'crc' and program it. Closes the page.
+BlDeltaResult_t BL_DeltaCommit(uint32_t crc);
+bool BL_DeltaActive(void);
+void BL_DeltaCancel(void);
+
+#endif // BL_DELTA_H
@@ -0,0 +1,217 @@
+/*
+ * Golden Image Recovery
+ */
+
+#include <string.h>
+#include "bootloader.h"
+#include "bl_golden.h"
+#include "bl_pack.h"
+#include "bl_nor.h"
+#include "bl_crc.h"
+#include "bl_counters.h"
+
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+
+#define APP_ROWS        ((APP_END_ADDRESS + 2UL - APP_START_ADDRESS) / FLASH_WRITE_ROW_SIZE_IN_PC_UNITS)
+#define STREAM_BASE     (BL_GOLDEN_NOR_BASE + BL_GOLDEN_DATA_OFFSET)
+#define STREAM_MAX      (BL_GOLDEN_NOR_SIZE - BL_GOLDEN_DATA_OFFSET)
+
+BlRecovery_t blRecovery __attribute__((persistent, section(".bl_persist")));
+
+static uint32_t RowAddress(uint16_t row)
+{
+    return APP_START_ADDRESS + (uint32_t)row * FLASH_WRITE_ROW_SIZE_IN_PC_UNITS;
+}
+
+static bool HeaderValid(const BlGoldenHeader_t* h)
+{
+    return (h->magic == BL_GOLDEN_MAGIC) && (h->appStart == APP_START_ADDRESS) &&
+           (h->length <= STREAM_MAX);
+}
+
+static uint32_t StreamCrc(uint32_t length, uint8_t* page)
+{
+    uint32_t crc = BL_CRC32_INIT;
+    uint32_t address = STREAM_BASE;
+    uint16_t n;
+
+    while (length != 0U)
+    {
+        n = (length < BL_NOR_PAGE_SIZE) ? (uint16_t)length : BL_NOR_PAGE_SIZE;
+        BL_NorRead(address, page, n);
+        crc = BL_Crc32Update(crc, page, n);
+        address += n;
+        length -= n;
+    }
+    return BL_Crc32Final(crc);
+}
+
+bool BL_GoldenBootCheck(uint16_t rcon)
+{
+    if (blRecovery.magic != BL_RECOVERY_MAGIC || blRecovery.launched > 1U ||
+        blRecovery.restored > 1U)
+    {
+        // Power-up RAM contents
+        memset(&blRecovery, 0, sizeof(blRecovery));
+        blRecovery.magic = BL_RECOVERY_MAGIC;
+        return false;
+    }
+
+    if (blRecovery.launched)
+    {
+        blRecovery.launched = 0;
+        if ((rcon & BL_GOLDEN_FAILED_RESETS) != 0U || appTrapCount != blRecovery.trapCount)
+        {
+            if (blRecovery.failStreak < 0xFFU)
+            {
+                blRecovery.failStreak++;
+            }
+        }
+        else
+        {
+            blRecovery.failStreak = 0;
+            blRecovery.restored = 0;
+        }
+    }
+    if (blRecovery.failStreak < BL_GOLDEN_FAIL_LIMIT || blRecovery.restored)
+    {
+        return false;
+    }
+    blRecovery.restored = 1;    // one attempt per run, whatever its outcome
+    return true;
+}
+
+void BL_GoldenLaunch(void)
+{
+    blRecovery.trapCount = appTrapCount;
+    blRecovery.launched = 1;
+}
+
+bool BL_GoldenAvailable(void)
+{
+    uint8_t capacity = (uint8_t)BL_NorJedecId();
+
+    return BL_StageAvailable() && capacity < 32U &&
+           (1UL << capacity) >= BL_GOLDEN_NOR_BASE + BL_GOLDEN_NOR_SIZE;
+}
+
+BlStageResult_t BL_GoldenSave(uint32_t* rowBuffer, uint32_t* pageBuffer)
+{
+    BlGoldenHeader_t h;
+    BlPackStream_t s;
+    uint8_t* packed = (uint8_t*)rowBuffer;
+    uint16_t row;
+
+    if (!BL_GoldenAvailable())
+    {
+        return BL_STAGE_NO_DEVICE;
+    }
+
+    // Header sector first: from here on there is no golden image
+    for (uint32_t offset = 0; offset < BL_GOLDEN_NOR_SIZE; offset += BL_NOR_SECTOR_SIZE)
+    {
+        if (!BL_NorEraseSector(BL_GOLDEN_NOR_BASE + offset))
+        {
+            return BL_STAGE_NOR_ERROR;
+        }
+    }
+
+    memset(&h, 0, sizeof(h));
+    BL_PackWriteOpen(&s, (uint8_t*)pageBuffer, STREAM_BASE, STREAM_BASE + STREAM_MAX);
+
+    // Row 0 (reset vector) last, as an install writes it. The preserved
+    // application data is not part of the image.
+    for (uint16_t n = 1; n <= APP_ROWS; n++)
+    {
+        row = n % APP_ROWS;
+        if (!IS_APP_DATA_ADDRESS(RowAddress(row)) && BL_PackFlashRow(RowAddress(row), packed))
+        {
+            BL_PackRow(&s, row, packed);
+            h.rows++;
+        }
+    }
+    h.length = BL_PackWriteClose(&s);
+    if (s.error)
+    {
+        return BL_STAGE_NOR_ERROR;
+    }
+
+    h.magic = BL_GOLDEN_MAGIC;
+    h.crc = BL_StageFlashCrc();
+    h.appStart = APP_START_ADDRESS;
+    h.streamCrc = s.crc;
+    if (!BL_NorProgram(BL_GOLDEN_NOR_BASE, &h, sizeof(h)))
+    {
+        return BL_STAGE_NOR_ERROR;
+    }
+    return BL_STAGE_OK;
+}
+
+BlStageResult_t BL_GoldenRestore(uint32_t* rowBuffer, uint32_t* pageBuffer)
+{
+    BlGoldenHeader_t h;
+    BlPackStream_t s;
+    uint16_t row;
+
+    if (!BL_GoldenAvailable())
+    {
+        return BL_STAGE_NO_DEVICE;
+    }
+    BL_NorRead(BL_GOLDEN_NOR_BASE, &h, sizeof(h));
+    if (!HeaderValid(&h))
+    {
+        return BL_STAGE_NO_IMAGE;
+    }
+
+    // Nothing in internal flash changes unless the stream checks out
+    if (StreamCrc(h.length, (uint8_t*)pageBuffer) != h.streamCrc)
+    {
+        return BL_STAGE_CRC_MISMATCH;
+    }
+    if (!Bootloader_EraseAppArea())
+    {
+        return BL_STAGE_FLASH_ERROR;
+    }
+
+    BL_PackReadOpen(&s, (uint8_t*)pageBuffer, STREAM_BASE, h.length);
+    while ((row = BL_PackNextRow(&s)) != BL_PACK_ROW_END)
+    {
+        if (row >= APP_ROWS || !BL_PackReadRow(&s, rowBuffer, true))
+        {
+            return BL_STAGE_CRC_MISMATCH;
+        }
+        if (IS_APP_DATA_ADDRESS(RowAddress(row)))
+        {
+            continue;   // saved before the data range was declared
+        }
+        if (!FLASH_WriteRow24(RowAddress(row), rowBuffer))
+        {
+            return BL_STAGE_FLASH_ERROR;
+        }
+        blCounters.rowsWritten++;
+    }
+
+    if (s.error || BL_StageFlashCrc() != h.crc)
+    {
+        return BL_STAGE_FLASH_ERROR;
+    }
+
+    blRecovery.failStreak = 0;
+    blRecovery.restored = 1;
+    blRecovery.restores++;
+    return BL_STAGE_OK;
+}
+
+void BL_GoldenInfo(BlGoldenInfo_t* out)
+{
+    memset(out, 0, sizeof(*out));
+    out->available = BL_GoldenAvailable();
+    out->failLimit = BL_GOLDEN_FAIL_LIMIT;
+    out->recovery = blRecovery;
+    if (out->available)
+    {
+        BL_NorRead(BL_GOLDEN_NOR_BASE, &out->header, sizeof(out->header));
+    }
+}
+
+#endif // !BL_SMALL && !BL_AUTH
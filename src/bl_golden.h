@@ -0,0 +1,108 @@
+/*
+ * Golden Image Recovery
+ *
+ * A known-good application image kept compressed in the SPI NOR
+ * (BL_GOLDEN_NOR_BASE/BL_GOLDEN_NOR_SIZE in bl_shared.h, behind the staging
+ * slots). 'GS' saves the application currently in internal flash. When the
+ * application then fails BL_GOLDEN_FAIL_LIMIT boots in a row, main.c puts
+ * the golden image back on its own and starts it, so a node that crashes in
+ * a loop recovers without a host.
+ *
+ * A boot counts as failed when the bootloader started the application and
+ * the next reset is a trap, illegal opcode / uninitialized W, configuration
+ * mismatch or watchdog reset (BL_GOLDEN_FAILED_RESETS), or the application
+ * counted a trap (appTrapCount changed). Any other reset ends the run. The
+ * count lives in .bl_persist (BlRecovery_t) and starts over at power-up.
+ * The golden image is restored at most once per run of failures: if it
+ * fails as well (or there is none), the bootloader keeps starting the
+ * application as before. Every restore is a BL_BOOT_PATH_GOLDEN entry in
+ * the boot log.
+ *
+ * NOR layout:
+ *   +0x0000  BlGoldenHeader_t, written last (save)
+ *   +0x1000  PackBits row stream (bl_pack.h) of the rows that are not all
+ *            0xFFFFFF, reset vector row last
+ *
+ * Decoding is a copy loop, so a restore runs at the internal flash
+ * programming rate. 'crc' is the image CRC of bl_stage.h, 'streamCrc' a
+ * CRC-32 over the stream; a restore checks the stream before it erases
+ * anything.
+ *
+ * Commands:
+ *   GS          save the application in internal flash as the golden image
+ *   GR          restore the golden image now
+ *   G           BlGoldenInfo_t as one hex-encoded line
+ */
+
+#ifndef BL_GOLDEN_H
+#define BL_GOLDEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bl_stage.h"
+
+#define BL_GOLDEN_FAIL_LIMIT    3U
+#define BL_GOLDEN_DATA_OFFSET   0x1000UL
+#define BL_GOLDEN_MAGIC         0x4E444C47UL    // "GLDN"
+#define BL_RECOVERY_MAGIC       0x5652U         // 'RV'
+
+// RCON bits of a reset that ends a failed boot
+#define BL_RCON_TRAPR           0x8000U
+#define BL_RCON_IOPUWR          0x4000U
+#define BL_RCON_CM              0x0200U
+#define BL_RCON_WDTO            0x0010U
+#define BL_GOLDEN_FAILED_RESETS (BL_RCON_TRAPR | BL_RCON_IOPUWR | BL_RCON_CM | BL_RCON_WDTO)
+
+typedef struct
+{
+    uint32_t magic;         // BL_GOLDEN_MAGIC, anything else: no golden image
+    uint32_t crc;           // image CRC
+    uint32_t appStart;      // APP_START_ADDRESS the image was saved for
+    uint32_t length;        // stream bytes, including the end marker
+    uint32_t streamCrc;     // CRC-32 of the stream
+    uint16_t rows;          // rows in the stream
+    uint16_t reserved;
+} BlGoldenHeader_t;
+
+// Failed-boot tracking (.bl_persist)
+typedef struct
+{
+    uint16_t magic;         // BL_RECOVERY_MAGIC, re-initialized otherwise
+    uint8_t  launched;      // the application was started on the last boot
+    uint8_t  failStreak;    // failed application boots in a row
+    uint16_t trapCount;     // appTrapCount when the application was started
+    uint16_t restores;      // golden restores since power-up
+    uint8_t  restored;      // golden restore tried during this run of failures
+    uint8_t  reserved;
+} BlRecovery_t;
+
+typedef struct
+{
+    BlGoldenHeader_t header;    // as read from the NOR
+    BlRecovery_t recovery;
+    uint8_t  available;         // NOR large enough for the golden region
+    uint8_t  failLimit;         // BL_GOLDEN_FAIL_LIMIT
+} BlGoldenInfo_t;
+
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+// Every entry, before the application can be started: account for how the
+// last boot ended. True if the golden image is due (main.c restores it).
+bool BL_GoldenBootCheck(uint16_t rcon);
+
+// Right before control goes to the application.
+void BL_GoldenLaunch(void);
+#else
+// BL_SMALL: no NOR. BL_AUTH: no image a MAC does not cover. No recovery.
+#define BL_GoldenBootCheck(rcon)    false
+#define BL_GoldenLaunch()           ((void)0)
+#endif
+
+// NOR probed by BL_StageInitialize. 'rowBuffer' and 'pageBuffer' are
+// scratch space for one row each (FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS words).
+bool BL_GoldenAvailable(void);
+BlStageResult_t BL_GoldenSave(uint32_t* rowBuffer, uint32_t* pageBuffer);
+BlStageResult_t BL_GoldenRestore(uint32_t* rowBuffer, uint32_t* pageBuffer);
+
+void BL_GoldenInfo(BlGoldenInfo_t* out);
+
+#endif // BL_GOLDEN_H
@@ -0,0 +1,142 @@
+/*
+ * CDC Link Self-Test
+ */
+
+#include "mcc_generated_files/usb/usb.h"
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "bl_link.h"
+#include "bl_timebase.h"
+
+#ifndef BL_SMALL
+
+#define LINK_PACKET     64U     // CDC bulk endpoint size
+
+static uint8_t linkBuffer[LINK_PACKET];
+
+// Wait for the IN endpoint to take another transfer. False on idle timeout.
+static bool WaitTxReady(uint32_t since)
+{
+    while (!USBUSARTIsTxTrfReady())
+    {
+        CDCTxService();
+        if ((BL_TimebaseNow() - since) > BL_LINK_IDLE_CYCLES)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sink and echo share the receive loop; echo sends each chunk straight back.
+static bool Receive(uint32_t count, bool echo, BlLinkResult_t* result)
+{
+    bool started = false;
+    uint32_t t0 = BL_TimebaseNow();
+    uint32_t last = t0;
+
+    while (result->bytes < count)
+    {
+        uint8_t n = getsUSBUSART(linkBuffer, sizeof(linkBuffer));
+        uint8_t skip = 0;
+
+        if (n == 0U)
+        {
+            if ((BL_TimebaseNow() - last) > BL_LINK_IDLE_CYCLES)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if (!started)
+        {
+            while (skip < n && (linkBuffer[skip] == '\r' || linkBuffer[skip] == '\n'))
+            {
+                skip++;
+            }
+            if (skip == n)
+            {
+                continue;
+            }
+            started = true;
+            t0 = BL_TimebaseNow();
+        }
+
+        last = BL_TimebaseNow();
+        n -= skip;
+        if (echo)
+        {
+            if (!WaitTxReady(last))
+            {
+                return false;
+            }
+            putUSBUSART(&linkBuffer[skip], n);
+            CDCTxService();
+        }
+        result->bytes += n;
+        result->cycles = last - t0;
+    }
+
+    if (echo && !WaitTxReady(BL_TimebaseNow()))
+    {
+        return false;
+    }
+    result->cycles = BL_TimebaseNow() - t0;
+    return true;
+}
+
+static bool Source(uint32_t count, BlLinkResult_t* result)
+{
+    uint32_t t0;
+
+    for (uint8_t i = 0; i < LINK_PACKET; i++)
+    {
+        linkBuffer[i] = (uint8_t)('0' + (i & 0x3FU));
+    }
+
+    t0 = BL_TimebaseNow();
+    while (result->bytes < count)
+    {
+        uint32_t left = count - result->bytes;
+        uint8_t n = (left < LINK_PACKET) ? (uint8_t)left : (uint8_t)LINK_PACKET;
+
+        if (!WaitTxReady(BL_TimebaseNow()))
+        {
+            return false;
+        }
+        putUSBUSART(linkBuffer, n);
+        CDCTxService();
+        result->bytes += n;
+    }
+
+    // Count the time until the last packet has been taken by the host.
+    if (!WaitTxReady(BL_TimebaseNow()))
+    {
+        return false;
+    }
+    result->cycles = BL_TimebaseNow() - t0;
+    return true;
+}
+
+bool BL_LinkTest(char mode, uint32_t count, BlLinkResult_t* result)
+{
+    result->bytes = 0;
+    result->cycles = 0;
+
+    switch (mode)
+    {
+        case BL_LINK_SINK:
+            return Receive(count, false, result);
+
+        case BL_LINK_ECHO:
+            return Receive(count, true, result);
+
+        case BL_LINK_SOURCE:
+            return Source(count, result);
+
+        default:
+            return false;
+    }
+}
+
+#endif // BL_SMALL
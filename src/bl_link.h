@@ -0,0 +1,40 @@
+/*
+ * CDC Link Self-Test
+ *
+ * Moves raw bytes through getsUSBUSART/putUSBUSART as fast as the CDC stack
+ * allows, with no flash access and no HEX parsing, to give a ceiling for
+ * upload throughput. Started by the 'L' command:
+ *
+ *   LS<n>   sink:   the device reads and discards n bytes
+ *   LO<n>   source: the device sends n bytes of a fixed pattern
+ *   LE<n>   echo:   the device sends every received byte back, n in total
+ *
+ * The device answers "+Link ready" before the transfer and a result line
+ * with its own byte count and elapsed timebase cycles after it. CR/LF bytes
+ * at the very start of a sink/echo stream are dropped (they are the tail of
+ * the command line), so host data must not begin with CR or LF.
+ */
+
+#ifndef BL_LINK_H
+#define BL_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BL_LINK_SINK        'S'
+#define BL_LINK_SOURCE      'O'
+#define BL_LINK_ECHO        'E'
+
+// Abort if no progress is made for this long (timebase cycles, 2 s).
+#define BL_LINK_IDLE_CYCLES (2UL * 16000000UL)
+
+typedef struct
+{
+    uint32_t bytes;     // bytes moved by the device (received or sent)
+    uint32_t cycles;    // BL_TimebaseNow() ticks from first to last byte
+} BlLinkResult_t;
+
+// Returns false on an unknown mode or an idle timeout.
+bool BL_LinkTest(char mode, uint32_t count, BlLinkResult_t* result);
+
+#endif // BL_LINK_H
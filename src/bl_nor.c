@@ -0,0 +1,118 @@
+/*
+ * SPI NOR Flash
+ */
+
+#include <stddef.h>
+#include "bl_nor.h"
+#include "bl_spi.h"
+#include "bl_timebase.h"
+#include "mcc_generated_files/pin_manager.h"
+
+#ifndef BL_SMALL
+
+#define NOR_CMD_READ_ID         0x9FU
+#define NOR_CMD_READ            0x03U
+#define NOR_CMD_PAGE_PROGRAM    0x02U
+#define NOR_CMD_SECTOR_ERASE    0x20U
+#define NOR_CMD_READ_STATUS     0x05U
+#define NOR_CMD_WRITE_ENABLE    0x06U
+
+#define NOR_STATUS_BUSY         0x01U
+
+static uint32_t norJedecId = 0;
+
+static void NorSelect(void)
+{
+    IO_RB13_SetLow();
+}
+
+static void NorDeselect(void)
+{
+    IO_RB13_SetHigh();
+}
+
+// Select and send a command with a 3-byte address; the caller deselects.
+static void NorCommand(uint8_t cmd, uint32_t address)
+{
+    NorSelect();
+    BL_SpiExchange(cmd);
+    BL_SpiExchange((uint8_t)(address >> 16));
+    BL_SpiExchange((uint8_t)(address >> 8));
+    BL_SpiExchange((uint8_t)address);
+}
+
+static void NorWriteEnable(void)
+{
+    NorSelect();
+    BL_SpiExchange(NOR_CMD_WRITE_ENABLE);
+    NorDeselect();
+}
+
+static bool NorWaitReady(uint32_t timeoutCycles)
+{
+    uint32_t start = BL_TimebaseNow();
+    uint8_t status;
+
+    NorSelect();
+    BL_SpiExchange(NOR_CMD_READ_STATUS);
+    do
+    {
+        status = BL_SpiExchange(0);
+    } while ((status & NOR_STATUS_BUSY) &&
+             (BL_TimebaseNow() - start) < timeoutCycles);
+    NorDeselect();
+
+    return (status & NOR_STATUS_BUSY) == 0;
+}
+
+bool BL_NorOpen(void)
+{
+    uint8_t id[3];
+
+    NorDeselect();
+    BL_SpiOpen(BL_SPI_MODE0, BL_NOR_SPI_HZ);
+
+    NorSelect();
+    BL_SpiExchange(NOR_CMD_READ_ID);
+    BL_SpiTransfer(NULL, id, sizeof(id));
+    NorDeselect();
+
+    norJedecId = ((uint32_t)id[0] << 16) | ((uint32_t)id[1] << 8) | id[2];
+    // Floating or shorted MISO reads as all ones or all zeros
+    if (id[0] == 0x00U || id[0] == 0xFFU)
+    {
+        norJedecId = 0;
+    }
+    return norJedecId != 0;
+}
+
+uint32_t BL_NorJedecId(void)
+{
+    return norJedecId;
+}
+
+void BL_NorRead(uint32_t address, void* data, uint16_t length)
+{
+    NorCommand(NOR_CMD_READ, address);
+    BL_SpiTransfer(NULL, (uint8_t*)data, length);
+    NorDeselect();
+}
+
+bool BL_NorProgram(uint32_t address, const void* data, uint16_t length)
+{
+    NorWriteEnable();
+    NorCommand(NOR_CMD_PAGE_PROGRAM, address);
+    BL_SpiTransfer((const uint8_t*)data, NULL, length);
+    NorDeselect();
+    return NorWaitReady(BL_NOR_PROGRAM_CYCLES);
+}
+
+bool BL_NorEraseSector(uint32_t address)
+{
+    NorWriteEnable();
+    NorCommand(NOR_CMD_SECTOR_ERASE, address);
+    NorDeselect();
+    return NorWaitReady(BL_NOR_ERASE_CYCLES);
+}
+
+#endif // BL_SMALL
@@ -0,0 +1,46 @@
+/*
+ * SPI NOR Flash
+ *
+ * Minimal driver for a JEDEC serial NOR (W25Qxx, MX25Lxx, AT25SFxx, ... with
+ * the common 03/02/20/05/06/9F command set and 3-byte addresses) on SPI1,
+ * chip select on RB13 (IO_RB13, active low).
+ *
+ * SPI1 is shared with the LoRa radio. PIN_MANAGER_Initialize leaves the
+ * radio in reset (RA4 low) and nothing else in the bootloader uses SPI1, so
+ * BL_NorOpen takes the module over (bl_spi.c): SPI mode 0 at BL_NOR_SPI_HZ
+ * instead of the MCC setting for the radio. The application reinitializes
+ * SPI1 itself.
+ *
+ * Addresses are NOR byte addresses. A program must stay inside one
+ * BL_NOR_PAGE_SIZE page; erases are by BL_NOR_SECTOR_SIZE sector. Program
+ * and erase wait for the device to finish and fail on a timeout.
+ */
+
+#ifndef BL_NOR_H
+#define BL_NOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BL_NOR_PAGE_SIZE        256U
+#define BL_NOR_SECTOR_SIZE      4096UL
+
+// SPI mode 0 at the fastest SCK SPI1 can do (Fcy / 2); the usual parts
+// take 03 reads up to 50 MHz
+#define BL_NOR_SPI_HZ           8000000UL
+
+// Worst-case busy times from typical datasheets (timebase cycles)
+#define BL_NOR_PROGRAM_CYCLES   (5UL * 16000UL)         // 5 ms
+#define BL_NOR_ERASE_CYCLES     (500UL * 16000UL)       // 500 ms
+
+// Set up SPI1 and read the JEDEC ID. False if no device answers.
+bool BL_NorOpen(void);
+
+// manufacturer << 16 | memory type << 8 | capacity (log2 bytes), 0 if none
+uint32_t BL_NorJedecId(void);
+
+void BL_NorRead(uint32_t address, void* data, uint16_t length);
+bool BL_NorProgram(uint32_t address, const void* data, uint16_t length);
+bool BL_NorEraseSector(uint32_t address);
+
+#endif // BL_NOR_H
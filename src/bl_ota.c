@@ -0,0 +1,330 @@
+/*
+ * Application-Staged Install
+ */
+
+#include <string.h>
+#include "bootloader.h"
+#include "bl_ota.h"
+#include "bl_pack.h"
+#include "bl_nor.h"
+#include "bl_crc.h"
+#include "bl_counters.h"
+#include "bl_prof.h"
+
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+
+#define STREAM_BASE     (BL_OTA_NOR_BASE + BL_OTA_DATA_OFFSET)
+#define STREAM_MAX      (BL_OTA_NOR_SIZE - BL_OTA_DATA_OFFSET)
+#define PAGE_ROWS       (FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS / FLASH_WRITE_ROW_SIZE_IN_PC_UNITS)
+#define ERASED_WORD     0x00FFFFFFUL
+
+// Result of the last install for the application, pinned to
+// BL_INSTALL_REPORT_ADDRESS by the linker script
+volatile BlInstallReport_t blInstallReport __attribute__((persistent, section(".bl_report")));
+
+// Rows of [start, end) in order: decoded from the stream, or erased where
+// the stream has none
+typedef struct
+{
+    BlPackStream_t s;
+    uint16_t next;          // row index the stream holds next
+    bool packed;
+    bool bad;               // malformed, out of order or out of range
+} Source_t;
+
+static void SourceOpen(Source_t* src, const BlOtaManifest_t* m, uint8_t* page)
+{
+    BL_PackReadOpen(&src->s, page, STREAM_BASE, m->length);
+    src->packed = (m->flags & BL_OTA_PACKBITS) != 0U;
+    src->bad = false;
+    src->next = BL_PackNextRow(&src->s);
+}
+
+// Row 'row' into 'words'. Rows must be asked for in ascending order.
+static void SourceRow(Source_t* src, uint16_t row, uint32_t* words)
+{
+    uint8_t i;
+
+    if (src->next != row)
+    {
+        for (i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+        {
+            words[i] = ERASED_WORD;
+        }
+        return;
+    }
+    if (!BL_PackReadRow(&src->s, words, src->packed))
+    {
+        src->bad = true;
+    }
+    src->next = BL_PackNextRow(&src->s);
+    if (src->next <= row)
+    {
+        src->bad = true;            // also catches a repeated row
+    }
+}
+
+static void SourceRewind(Source_t* src, const Source_t* mark)
+{
+    BL_PackRewind(&src->s, &mark->s);
+    src->next = mark->next;
+    src->bad = mark->bad;
+}
+
+static uint32_t RowAddress(const BlOtaManifest_t* m, uint16_t row)
+{
+    return m->start + (uint32_t)row * FLASH_WRITE_ROW_SIZE_IN_PC_UNITS;
+}
+
+static bool RowErased(const uint32_t* words)
+{
+    for (uint8_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+    {
+        if (words[i] != ERASED_WORD)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool RowDiffers(uint32_t address, const uint32_t* words)
+{
+    for (uint8_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+    {
+        if ((FLASH_ReadWord24(address + 2U * i) & ERASED_WORD) != words[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t RowCrc(uint32_t crc, const uint32_t* words)
+{
+    for (uint8_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+    {
+        crc = BL_Crc32Update(crc, (const uint8_t*)&words[i], 3);
+    }
+    return crc;
+}
+
+static uint32_t FlashCrc(uint32_t start, uint32_t end)
+{
+    uint32_t crc = BL_CRC32_INIT;
+    uint32_t word;
+
+    for (uint32_t address = start; address < end; address += 2)
+    {
+        word = IS_APP_DATA_ADDRESS(address) ? ERASED_WORD : FLASH_ReadWord24(address);
+        crc = BL_Crc32Update(crc, (const uint8_t*)&word, 3);
+    }
+    return BL_Crc32Final(crc);
+}
+
+static bool OtaAvailable(void)
+{
+    uint8_t capacity = (uint8_t)BL_NorJedecId();
+
+    return BL_StageAvailable() && capacity < 32U &&
+           (1UL << capacity) >= BL_OTA_NOR_BASE + BL_OTA_NOR_SIZE;
+}
+
+static bool ManifestValid(const BlOtaManifest_t* m)
+{
+    const uint32_t pageMask = FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS - 1UL;
+
+    return (m->appStart == APP_START_ADDRESS) &&
+           ((m->start & pageMask) == 0U) && ((m->end & pageMask) == 0U) &&
+           (m->start >= APP_START_ADDRESS) && (m->start < m->end) &&
+           (m->end <= APP_END_ADDRESS + 2UL) &&
+           (m->length <= STREAM_MAX) && ((m->flags & ~BL_OTA_PACKBITS) == 0U);
+}
+
+// Step 2: the whole image, nothing written
+static BlStageResult_t Check(const BlOtaManifest_t* m, uint16_t rows,
+                             uint32_t* rowBuffer, uint8_t* page)
+{
+    Source_t src;
+    uint32_t crc = BL_CRC32_INIT;
+
+    SourceOpen(&src, m, page);
+    for (uint16_t r = 0; r < rows; r++)
+    {
+        SourceRow(&src, r, rowBuffer);
+        if (IS_APP_DATA_ADDRESS(RowAddress(m, r)) && !RowErased(rowBuffer))
+        {
+            src.bad = true;         // the image must leave the data alone
+        }
+        crc = RowCrc(crc, rowBuffer);
+    }
+    if (src.bad || src.next != BL_PACK_ROW_END || src.s.error || src.s.left != 0U)
+    {
+        return BL_STAGE_CRC_MISMATCH;
+    }
+    return (BL_Crc32Final(crc) == m->crc) ? BL_STAGE_OK : BL_STAGE_CRC_MISMATCH;
+}
+
+// Program rows first..first+count-1 from 'src' into freshly erased flash.
+static bool WriteRows(Source_t* src, uint32_t start, uint16_t first, uint16_t count,
+                      uint32_t* rowBuffer)
+{
+    uint32_t address;
+
+    for (uint16_t r = first; r < first + count; r++)
+    {
+        SourceRow(src, r, rowBuffer);
+        if (RowErased(rowBuffer))
+        {
+            continue;
+        }
+        address = start + (uint32_t)r * FLASH_WRITE_ROW_SIZE_IN_PC_UNITS;
+        PROF_BEGIN(PROF_FLASH_WRITE_ROW);
+        bool written = FLASH_WriteRow24(address, rowBuffer);
+        PROF_END(PROF_FLASH_WRITE_ROW);
+        if (!written)
+        {
+            return false;
+        }
+        blInstallReport.rowsWritten++;
+        blCounters.rowsWritten++;
+    }
+    return true;
+}
+
+static bool ErasePage(uint32_t address)
+{
+    PROF_BEGIN(PROF_FLASH_ERASE);
+    bool erased = FLASH_ErasePage(address);
+    PROF_END(PROF_FLASH_ERASE);
+    if (erased)
+    {
+        blInstallReport.pagesErased++;
+        blCounters.pagesErased++;
+    }
+    return erased;
+}
+
+// Step 3
+static BlStageResult_t Program(const BlOtaManifest_t* m, uint16_t rows,
+                               uint32_t* rowBuffer, uint8_t* page)
+{
+    Source_t src;
+    Source_t mark;
+    Source_t vectorMark;
+    bool vectorPending = false;
+    uint32_t address;
+    uint16_t first;
+    bool differs;
+
+    SourceOpen(&src, m, page);
+    for (first = 0; first < rows; first += PAGE_ROWS)
+    {
+        address = RowAddress(m, first);
+        mark = src;
+        differs = false;
+        for (uint16_t r = first; r < first + PAGE_ROWS; r++)
+        {
+            SourceRow(&src, r, rowBuffer);
+            if (!differs && !IS_APP_DATA_ADDRESS(address))
+            {
+                differs = RowDiffers(RowAddress(m, r), rowBuffer);
+            }
+        }
+        if (!differs)
+        {
+            blInstallReport.pagesSkipped++;
+            blCounters.pagesSkipped++;
+            continue;
+        }
+
+        if (!ErasePage(address))
+        {
+            return BL_STAGE_FLASH_ERROR;
+        }
+        if (address == APP_START_ADDRESS)
+        {
+            // No valid application from here until the end
+            vectorMark = mark;
+            vectorPending = true;
+            continue;
+        }
+        SourceRewind(&src, &mark);
+        if (!WriteRows(&src, m->start, first, PAGE_ROWS, rowBuffer))
+        {
+            return BL_STAGE_FLASH_ERROR;
+        }
+    }
+
+    if (vectorPending)
+    {
+        // Rows 1.. of the first page, then row 0 with the reset vector
+        SourceRewind(&src, &vectorMark);
+        SourceRow(&src, 0, rowBuffer);
+        if (!WriteRows(&src, m->start, 1, PAGE_ROWS - 1U, rowBuffer))
+        {
+            return BL_STAGE_FLASH_ERROR;
+        }
+        SourceRewind(&src, &vectorMark);
+        if (!WriteRows(&src, m->start, 0, 1, rowBuffer))
+        {
+            return BL_STAGE_FLASH_ERROR;
+        }
+    }
+    return src.bad ? BL_STAGE_CRC_MISMATCH : BL_STAGE_OK;
+}
+
+BlStageResult_t BL_OtaInstall(uint32_t* rowBuffer, uint32_t* pageBuffer)
+{
+    BlOtaManifest_t m;
+    BlStageResult_t result;
+    uint16_t rows;
+
+    if (blInstallReport.magic != BL_INSTALL_REPORT_MAGIC)
+    {
+        blInstallReport.count = 0;  // power-up RAM contents
+    }
+    blInstallReport.magic = 0;
+    blInstallReport.crc = 0;
+    blInstallReport.pagesErased = 0;
+    blInstallReport.pagesSkipped = 0;
+    blInstallReport.rowsWritten = 0;
+    blInstallReport.count++;
+
+    if (!OtaAvailable())
+    {
+        result = BL_STAGE_NO_DEVICE;
+    }
+    else
+    {
+        BL_NorRead(BL_OTA_NOR_BASE, &m, sizeof(m));
+        blInstallReport.crc = m.crc;
+        if (m.magic != BL_OTA_MAGIC)
+        {
+            result = BL_STAGE_NO_IMAGE;
+        }
+        else if (!ManifestValid(&m))
+        {
+            result = BL_STAGE_BAD_MANIFEST;
+        }
+        else
+        {
+            rows = (uint16_t)((m.end - m.start) / FLASH_WRITE_ROW_SIZE_IN_PC_UNITS);
+            result = Check(&m, rows, rowBuffer, (uint8_t*)pageBuffer);
+            if (result == BL_STAGE_OK)
+            {
+                result = Program(&m, rows, rowBuffer, (uint8_t*)pageBuffer);
+            }
+            if (result == BL_STAGE_OK && FlashCrc(m.start, m.end) != m.crc)
+            {
+                result = BL_STAGE_FLASH_ERROR;
+            }
+        }
+    }
+
+    blInstallReport.result = (uint16_t)result;
+    blInstallReport.magic = BL_INSTALL_REPORT_MAGIC;
+    return result;
+}
+
+#endif // !BL_SMALL && !BL_AUTH
@@ -0,0 +1,44 @@
+/*
+ * Application-Staged Install
+ *
+ * Installs an image the application staged in the NOR install area
+ * (BL_OTA_NOR_BASE, BlOtaManifest_t and the request in bl_shared.h). main.c
+ * runs it before the application is started when the entry request holds
+ * BL_INSTALL_REQUEST_MAGIC.
+ *
+ *   1. The manifest must be for this APP_START_ADDRESS, cover whole pages
+ *      inside the application area and fit the install area.
+ *   2. The stream is decoded once without touching flash: rows must come
+ *      in ascending order, inside [start, end), and the image CRC must match.
+ *   3. Page by page, the image is compared with internal flash. Only pages
+ *      that differ are erased and programmed. If the page holding the
+ *      application's reset vector differs, it is erased first and its rows
+ *      are programmed last, row 0 after the others, so an interrupted
+ *      install leaves no valid application behind.
+ *   4. The CRC of [start, end) in internal flash must match again.
+ *
+ * The preserved application data (BL_APP_DATA_START) is neither compared
+ * nor erased. The image must leave it erased, as the CRC counts it.
+ *
+ * Decoding a page twice (compare, then program) rewinds the stream instead
+ * of keeping a page of rows in RAM.
+ *
+ * BL_INSTALL_xxx (bl_shared.h) are the BlStageResult_t values.
+ */
+
+#ifndef BL_OTA_H
+#define BL_OTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bl_shared.h"
+#include "bl_stage.h"
+
+// BL_INSTALL_REPORT, the bootloader's name for it
+extern volatile BlInstallReport_t blInstallReport;
+
+// 'rowBuffer' and 'pageBuffer' are scratch space for one row each
+// (FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS words). Fills BL_INSTALL_REPORT.
+BlStageResult_t BL_OtaInstall(uint32_t* rowBuffer, uint32_t* pageBuffer);
+
+#endif // BL_OTA_H
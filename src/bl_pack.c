@@ -0,0 +1,226 @@
+/*
+ * Packed Row Stream
+ */
+
+#include <string.h>
+#include "bootloader.h"
+#include "bl_pack.h"
+#include "bl_nor.h"
+#include "bl_crc.h"
+
+#ifndef BL_SMALL
+
+#define ERASED_WORD     0x00FFFFFFUL
+
+// PackBits: shortest run worth encoding, longest run and literal
+#define RUN_MIN         3U
+#define RUN_MAX         128U
+#define LITERAL_MAX     128U
+#define PACK_NOP        128U
+
+static void Flush(BlPackStream_t* s)
+{
+    if (s->fill == 0U)
+    {
+        return;
+    }
+    s->crc = BL_Crc32Update(s->crc, s->page, s->fill);
+    if (s->address + s->fill > s->end || !BL_NorProgram(s->address, s->page, s->fill))
+    {
+        s->error = true;
+    }
+    s->address += BL_NOR_PAGE_SIZE;
+    s->fill = 0;
+}
+
+void BL_PackWriteOpen(BlPackStream_t* s, uint8_t* page, uint32_t address, uint32_t end)
+{
+    memset(s, 0, sizeof(*s));
+    s->page = page;
+    s->address = address;
+    s->end = end;
+    s->crc = BL_CRC32_INIT;
+}
+
+void BL_PackPut(BlPackStream_t* s, uint8_t value)
+{
+    s->written++;
+    s->page[s->fill++] = value;
+    if (s->fill == BL_NOR_PAGE_SIZE)
+    {
+        Flush(s);
+    }
+}
+
+static uint8_t RunLength(const uint8_t* data, uint8_t i)
+{
+    uint8_t n = 1;
+
+    while (i + n < BL_PACK_ROW_BYTES && n < RUN_MAX && data[i + n] == data[i])
+    {
+        n++;
+    }
+    return n;
+}
+
+void BL_PackRow(BlPackStream_t* s, uint16_t row, const uint8_t* data)
+{
+    uint8_t i = 0;
+    uint8_t n;
+
+    BL_PackPut(s, (uint8_t)row);
+    BL_PackPut(s, (uint8_t)(row >> 8));
+    while (i < BL_PACK_ROW_BYTES)
+    {
+        n = RunLength(data, i);
+        if (n >= RUN_MIN)
+        {
+            BL_PackPut(s, (uint8_t)(257U - n));
+            BL_PackPut(s, data[i]);
+            i += n;
+            continue;
+        }
+
+        // Literal up to the next run worth encoding
+        n = 1;
+        while (i + n < BL_PACK_ROW_BYTES && n < LITERAL_MAX && RunLength(data, i + n) < RUN_MIN)
+        {
+            n++;
+        }
+        BL_PackPut(s, (uint8_t)(n - 1U));
+        while (n-- != 0U)
+        {
+            BL_PackPut(s, data[i++]);
+        }
+    }
+}
+
+uint32_t BL_PackWriteClose(BlPackStream_t* s)
+{
+    BL_PackPut(s, (uint8_t)BL_PACK_ROW_END);
+    BL_PackPut(s, (uint8_t)(BL_PACK_ROW_END >> 8));
+    Flush(s);
+    s->crc = BL_Crc32Final(s->crc);
+    return s->written;
+}
+
+void BL_PackReadOpen(BlPackStream_t* s, uint8_t* page, uint32_t address, uint32_t length)
+{
+    memset(s, 0, sizeof(*s));
+    s->page = page;
+    s->address = address;
+    s->left = length;
+    s->fill = BL_NOR_PAGE_SIZE;
+}
+
+// Past the end of the stream: PACK_NOP, which no row decodes
+uint8_t BL_PackGet(BlPackStream_t* s)
+{
+    if (s->left == 0U)
+    {
+        s->error = true;
+        return PACK_NOP;
+    }
+    if (s->fill == BL_NOR_PAGE_SIZE)
+    {
+        BL_NorRead(s->address, s->page, BL_NOR_PAGE_SIZE);
+        s->address += BL_NOR_PAGE_SIZE;
+        s->fill = 0;
+    }
+    s->left--;
+    return s->page[s->fill++];
+}
+
+uint16_t BL_PackNextRow(BlPackStream_t* s)
+{
+    uint16_t row = BL_PackGet(s);
+
+    row |= (uint16_t)BL_PackGet(s) << 8;
+    return s->error ? BL_PACK_ROW_END : row;
+}
+
+bool BL_PackReadRow(BlPackStream_t* s, uint32_t* words, bool packed)
+{
+    uint8_t* data = (uint8_t*)words;
+    uint8_t i = 0;
+    uint8_t n;
+    uint8_t count;
+    uint8_t value;
+    uint8_t k;
+
+    while (!packed && i < BL_PACK_ROW_BYTES)
+    {
+        data[i++] = BL_PackGet(s);
+    }
+    while (i < BL_PACK_ROW_BYTES)
+    {
+        n = BL_PackGet(s);
+        if (n < PACK_NOP)
+        {
+            count = (uint8_t)(n + 1U);
+            if (count > BL_PACK_ROW_BYTES - i)
+            {
+                return false;
+            }
+            while (count-- != 0U)
+            {
+                data[i++] = BL_PackGet(s);
+            }
+        }
+        else if (n > PACK_NOP)
+        {
+            count = (uint8_t)(257U - n);
+            if (count > BL_PACK_ROW_BYTES - i)
+            {
+                return false;
+            }
+            value = BL_PackGet(s);
+            memset(&data[i], value, count);
+            i += count;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // 3 bytes per instruction to 4, from the end: word k only overwrites
+    // bytes of instructions >= k, which are already done
+    for (k = FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; k-- != 0U; )
+    {
+        words[k] = (uint32_t)data[3U * k] | ((uint32_t)data[3U * k + 1U] << 8) |
+                   ((uint32_t)data[3U * k + 2U] << 16);
+    }
+    return !s->error;
+}
+
+void BL_PackRewind(BlPackStream_t* s, const BlPackStream_t* mark)
+{
+    // The page buffer has moved on since: read the mark's page again
+    *s = *mark;
+    if (s->fill < BL_NOR_PAGE_SIZE)
+    {
+        BL_NorRead(s->address - BL_NOR_PAGE_SIZE, s->page, BL_NOR_PAGE_SIZE);
+    }
+}
+
+bool BL_PackFlashRow(uint32_t address, uint8_t* packed)
+{
+    bool erased = true;
+    uint32_t word;
+
+    for (uint8_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+    {
+        word = FLASH_ReadWord24(address + 2U * i) & ERASED_WORD;
+        if (word != ERASED_WORD)
+        {
+            erased = false;
+        }
+        *packed++ = (uint8_t)word;
+        *packed++ = (uint8_t)(word >> 8);
+        *packed++ = (uint8_t)(word >> 16);
+    }
+    return !erased;
+}
+
+#endif // BL_SMALL
@@ -0,0 +1,63 @@
+/*
+ * Packed Row Stream
+ *
+ * Program rows as a byte stream in the SPI NOR, shared by the golden image
+ * (bl_golden.h) and application-staged installs (bl_ota.h). Each row is its
+ * row index (2 bytes, little endian, relative to the first row of the
+ * image) and then its 64 instructions as 3 bytes each (low byte first),
+ * either raw (192 bytes) or PackBits-encoded. Row index BL_PACK_ROW_END
+ * ends the stream.
+ *
+ * PackBits: control byte n = 0..127 copies the next n + 1 bytes, n =
+ * 129..255 repeats the next byte 257 - n times (128 is not used). Decoding
+ * is a copy loop, so unpacking costs no more than reading raw rows.
+ *
+ * The stream goes through one BL_NOR_PAGE_SIZE buffer: a NOR page is
+ * programmed when the buffer fills (writer) or read when it runs empty
+ * (reader). The writer keeps a CRC-32 of every byte in 'crc', final after
+ * BL_PackWriteClose.
+ */
+
+#ifndef BL_PACK_H
+#define BL_PACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BL_PACK_ROW_END     0xFFFFU
+#define BL_PACK_ROW_BYTES   (FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS * 3U)
+
+typedef struct
+{
+    uint8_t* page;          // one BL_NOR_PAGE_SIZE buffer
+    uint32_t address;       // NOR address of the next page
+    uint32_t end;           // writer: first NOR address past the stream area
+    uint32_t written;       // writer: stream bytes so far
+    uint32_t left;          // reader: stream bytes not yet consumed
+    uint16_t fill;          // bytes in (writer) / consumed from (reader) page
+    uint32_t crc;
+    bool error;             // NOR error, area full or read past the end
+} BlPackStream_t;
+
+// Writer over the NOR range [address, end), erased by the caller.
+void BL_PackWriteOpen(BlPackStream_t* s, uint8_t* page, uint32_t address, uint32_t end);
+void BL_PackPut(BlPackStream_t* s, uint8_t value);
+void BL_PackRow(BlPackStream_t* s, uint16_t row, const uint8_t* packed);
+// Write the end marker and the last page. Returns the stream length.
+uint32_t BL_PackWriteClose(BlPackStream_t* s);
+
+// Reader over 'length' bytes at 'address'.
+void BL_PackReadOpen(BlPackStream_t* s, uint8_t* page, uint32_t address, uint32_t length);
+uint8_t BL_PackGet(BlPackStream_t* s);
+// Next row index, BL_PACK_ROW_END at the end marker.
+uint16_t BL_PackNextRow(BlPackStream_t* s);
+// Decode one row into 'words' (FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS, phantom
+// byte 0). 'packed': PackBits, otherwise raw. False on a malformed row.
+bool BL_PackReadRow(BlPackStream_t* s, uint32_t* words, bool packed);
+// Go back to a copy of the reader taken earlier.
+void BL_PackRewind(BlPackStream_t* s, const BlPackStream_t* mark);
+
+// Row at program memory 'address' as 3-byte instructions. False if erased.
+bool BL_PackFlashRow(uint32_t address, uint8_t* packed);
+
+#endif // BL_PACK_H
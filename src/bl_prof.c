@@ -0,0 +1,52 @@
+/*
+ * Section Profiler
+ */
+
+#include <xc.h>
+#include <string.h>
+#include "bl_prof.h"
+
+#ifndef BL_SMALL
+
+static BlProfEntry_t profTable[PROF_SECTION_COUNT];
+static uint32_t profEpoch;
+
+void BL_ProfRecord(BlProfSection_t section, uint32_t start)
+{
+    uint32_t ticks = BL_TimebaseNow() - start;
+    BlProfEntry_t* e = &profTable[section];
+
+    if (e->count == 0 || ticks < e->min)
+    {
+        e->min = ticks;
+    }
+    if (ticks > e->max)
+    {
+        e->max = ticks;
+    }
+    e->total += ticks;
+    e->count++;
+}
+
+void BL_ProfSnapshot(BlProfile_t* out)
+{
+    __builtin_disi(0x3FFF);
+    memcpy(out->entry, profTable, sizeof(profTable));
+    out->elapsed = BL_TimebaseNow() - profEpoch;
+    DISICNT = 0;
+
+    out->version = BL_PROF_VERSION;
+    out->sections = PROF_SECTION_COUNT;
+    out->entrySize = sizeof(BlProfEntry_t);
+    out->reserved = 0;
+}
+
+void BL_ProfClear(void)
+{
+    __builtin_disi(0x3FFF);
+    memset(profTable, 0, sizeof(profTable));
+    profEpoch = BL_TimebaseNow();
+    DISICNT = 0;
+}
+
+#endif // BL_SMALL
@@ -0,0 +1,74 @@
+/*
+ * Section Profiler
+ *
+ * PROF_BEGIN/PROF_END bracket a code section and accumulate its duration in
+ * BL_TimebaseNow() ticks (instruction cycles on target) into a per-section
+ * count/total/min/max entry. Durations are wall time: a main-loop section
+ * includes any USB interrupt that preempted it, and PROF_USB_ISR shows how
+ * much that was.
+ *
+ * A section must only be recorded from one context (main loop or the USB
+ * interrupt) so its entry is never updated concurrently.
+ *
+ * 'P' returns a BlProfile_t snapshot as one hex-encoded line (see
+ * Bootloader_SendHexBlock); 'Z' clears the table together with the
+ * performance counters. Totals and 'elapsed' wrap after ~268 s, so clear
+ * before measuring. New sections are appended to the enum.
+ */
+
+#ifndef BL_PROF_H
+#define BL_PROF_H
+
+#include <stdint.h>
+#include "bl_timebase.h"
+
+#define BL_PROF_VERSION     1U
+
+typedef enum
+{
+    PROF_USB_ISR,           // _USB1Interrupt body (USBDeviceTasks in interrupt context)
+    PROF_USB_TASKS,         // USBDeviceTasks called from the main loop (erase)
+    PROF_COMMAND,           // ProcessLine: one command, including its response
+    PROF_HEX_PARSE,         // Bootloader_ParseHexLine, including row flushes
+    PROF_CDC_TX,            // waiting for the IN endpoint and queueing a response
+    PROF_FLASH_ERASE,       // FLASH_ErasePage
+    PROF_FLASH_BLANK,       // blank check of one page before erase
+    PROF_FLASH_WRITE_ROW,   // FLASH_WriteRow24
+    PROF_FLASH_WRITE_WORD,  // FLASH_WriteWord24
+    PROF_AUTH_HASH,         // HMAC of a committed row, and the check at EOF (BL_AUTH builds, bl_auth.h)
+    PROF_SECTION_COUNT
+} BlProfSection_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t total;
+    uint32_t min;
+    uint32_t max;
+} BlProfEntry_t;
+
+typedef struct
+{
+    uint8_t  version;       // BL_PROF_VERSION
+    uint8_t  sections;      // PROF_SECTION_COUNT
+    uint8_t  entrySize;     // sizeof(BlProfEntry_t)
+    uint8_t  reserved;
+    uint32_t elapsed;       // ticks since the table was cleared
+    BlProfEntry_t entry[PROF_SECTION_COUNT];
+} BlProfile_t;
+
+#ifndef BL_SMALL
+#define PROF_BEGIN(s)   uint32_t prof_##s = BL_TimebaseNow()
+#define PROF_END(s)     BL_ProfRecord((s), prof_##s)
+
+void BL_ProfRecord(BlProfSection_t section, uint32_t start);
+void BL_ProfSnapshot(BlProfile_t* out);
+void BL_ProfClear(void);
+#else
+// BL_SMALL: no profiler, 'P' is not answered
+#define PROF_BEGIN(s)   ((void)0)
+#define PROF_END(s)     ((void)0)
+#define BL_ProfClear()  ((void)0)
+#endif
+
+#endif // BL_PROF_H
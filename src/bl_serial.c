@@ -0,0 +1,108 @@
+/*
+ * USB Serial Number
+ */
+
+#ifndef BL_SIM
+#include <xc.h>
+#endif
+#include "mcc_generated_files/memory/flash.h"
+#include "bl_serial.h"
+
+#define ERASED_WORD         0x00FFFFFFUL
+#define SEED_WORDS          128U        // SRAM words sampled below SPLIM
+#define DSC_STRING          0x03U       // USB_DESCRIPTOR_STRING
+
+BlSerialDescriptor_t blSerialDescriptor;
+
+static char serialText[BL_SERIAL_CHARS + 1];
+
+// 32-bit FNV-1a step over one 16-bit word.
+static uint32_t Mix(uint32_t h, uint16_t w)
+{
+    h = (h ^ (w & 0xFFU)) * 16777619UL;
+    h = (h ^ (w >> 8)) * 16777619UL;
+    return h;
+}
+
+// Two independent hashes of the power-up contents of the top of the stack
+// area. SRAM cells settle into a per-die pattern with noise on top, which is
+// enough to keep boards on one station apart.
+static void Seed(uint32_t* hi, uint32_t* lo)
+{
+    uint32_t h1 = 2166136261UL;
+    uint32_t h2 = 0x811C9DC5UL ^ 0x5A5A5A5AUL;
+
+#ifdef BL_SIM
+    uint32_t e = SIM_Entropy();
+    h1 = Mix(Mix(h1, (uint16_t)e), (uint16_t)(e >> 16));
+    h2 = Mix(Mix(h2, (uint16_t)(e >> 16)), (uint16_t)e);
+#else
+    // main() calls this before BL_StackPaint, and nothing has run this deep
+    // in the stack yet.
+    const volatile uint16_t* top = (const volatile uint16_t*)SPLIM;
+    for (uint16_t i = 1U; i <= SEED_WORDS; i++)
+    {
+        h1 = Mix(h1, top[-(int16_t)i]);
+        h2 = Mix(h2, top[-(int16_t)(SEED_WORDS + 1U - i)]);
+    }
+#endif
+
+    *hi = h1 & ERASED_WORD;
+    *lo = h2 & ERASED_WORD;
+    // An all-ones word would read back as "not provisioned".
+    if (*hi == ERASED_WORD) { *hi ^= 1U; }
+    if (*lo == ERASED_WORD) { *lo ^= 1U; }
+}
+
+static void PutHex24(char* out, uint32_t value)
+{
+    for (uint8_t i = 6U; i-- != 0U; )
+    {
+        uint8_t nibble = (uint8_t)(value & 0xFU);
+        out[i] = (char)(nibble < 10U ? '0' + nibble : 'A' - 10 + nibble);
+        value >>= 4;
+    }
+}
+
+void BL_SerialInitialize(void)
+{
+    uint32_t hi = FLASH_ReadWord24(BL_SERIAL_ADDRESS);
+    uint32_t lo = FLASH_ReadWord24(BL_SERIAL_ADDRESS + 2U);
+
+    if (hi == ERASED_WORD)
+    {
+        uint32_t seedHi;
+        uint32_t seedLo;
+
+        Seed(&seedHi, &seedLo);
+
+        // Low word first: 'hi' is the provisioned marker. A low word left
+        // over from an interrupted attempt is kept (it cannot be rewritten).
+        FLASH_Unlock(FLASH_UNLOCK_KEY);
+        if (lo == ERASED_WORD)
+        {
+            FLASH_WriteWord24(BL_SERIAL_ADDRESS + 2U, seedLo);
+        }
+        FLASH_WriteWord24(BL_SERIAL_ADDRESS, seedHi);
+        FLASH_Lock();
+
+        hi = FLASH_ReadWord24(BL_SERIAL_ADDRESS);
+        lo = FLASH_ReadWord24(BL_SERIAL_ADDRESS + 2U);
+    }
+
+    PutHex24(&serialText[0], hi);
+    PutHex24(&serialText[6], lo);
+    serialText[BL_SERIAL_CHARS] = '\0';
+
+    blSerialDescriptor.bLength = sizeof(BlSerialDescriptor_t);
+    blSerialDescriptor.bDscType = DSC_STRING;
+    for (uint8_t i = 0; i < BL_SERIAL_CHARS; i++)
+    {
+        blSerialDescriptor.string[i] = (uint16_t)serialText[i];
+    }
+}
+
+const char* BL_SerialString(void)
+{
+    return serialText;
+}
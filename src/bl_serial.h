@@ -0,0 +1,44 @@
+/*
+ * USB Serial Number
+ *
+ * The PIC24FJ64GB002 has no factory-unique ID (DEVID/DEVREV read the same on
+ * every part), so each board carries a 48-bit serial number in the last two
+ * instruction words of the bootloader area (BL_SERIAL_ADDRESS, kept out of
+ * the bootloader's code region by its linker script).
+ *
+ * The first boot that finds those words erased generates the number from the
+ * power-up contents of unused SRAM and programs it. The bootloader never
+ * erases that page, so the number stays fixed until the part is reprogrammed
+ * with a programmer/debugger.
+ *
+ * It is reported as the USB iSerialNumber string (index 3), so the host
+ * sees a stable per-board name such as /dev/serial/by-id/...-<serial>-if00.
+ */
+
+#ifndef BL_SERIAL_H
+#define BL_SERIAL_H
+
+#include <stdint.h>
+#include "bl_shared.h"
+
+#define BL_SERIAL_ADDRESS       (BL_APP_START - 8UL)    // high 24 bits; low 24 bits at +2
+#define BL_SERIAL_CHARS         12          // hex digits
+
+typedef struct
+{
+    uint8_t  bLength;
+    uint8_t  bDscType;
+    uint16_t string[BL_SERIAL_CHARS];
+} BlSerialDescriptor_t;
+
+// USB string descriptor for iSerialNumber (referenced from USB_SD_Ptr).
+extern BlSerialDescriptor_t blSerialDescriptor;
+
+// Read (or provision) the serial number and fill blSerialDescriptor.
+// Call before USBDeviceInit().
+void BL_SerialInitialize(void);
+
+// Serial number as a NUL-terminated hex string.
+const char* BL_SerialString(void);
+
+#endif // BL_SERIAL_H
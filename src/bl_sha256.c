@@ -0,0 +1,171 @@
+/*
+ * SHA-256
+ */
+
+#include <string.h>
+#include "bl_sha256.h"
+
+#ifdef BL_AUTH
+
+static const uint32_t roundK[64] =
+{
+    0x428A2F98UL, 0x71374491UL, 0xB5C0FBCFUL, 0xE9B5DBA5UL, 0x3956C25BUL, 0x59F111F1UL, 0x923F82A4UL, 0xAB1C5ED5UL,
+    0xD807AA98UL, 0x12835B01UL, 0x243185BEUL, 0x550C7DC3UL, 0x72BE5D74UL, 0x80DEB1FEUL, 0x9BDC06A7UL, 0xC19BF174UL,
+    0xE49B69C1UL, 0xEFBE4786UL, 0x0FC19DC6UL, 0x240CA1CCUL, 0x2DE92C6FUL, 0x4A7484AAUL, 0x5CB0A9DCUL, 0x76F988DAUL,
+    0x983E5152UL, 0xA831C66DUL, 0xB00327C8UL, 0xBF597FC7UL, 0xC6E00BF3UL, 0xD5A79147UL, 0x06CA6351UL, 0x14292967UL,
+    0x27B70A85UL, 0x2E1B2138UL, 0x4D2C6DFCUL, 0x53380D13UL, 0x650A7354UL, 0x766A0ABBUL, 0x81C2C92EUL, 0x92722C85UL,
+    0xA2BFE8A1UL, 0xA81A664BUL, 0xC24B8B70UL, 0xC76C51A3UL, 0xD192E819UL, 0xD6990624UL, 0xF40E3585UL, 0x106AA070UL,
+    0x19A4C116UL, 0x1E376C08UL, 0x2748774CUL, 0x34B0BCB5UL, 0x391C0CB3UL, 0x4ED8AA4AUL, 0x5B9CCA4FUL, 0x682E6FF3UL,
+    0x748F82EEUL, 0x78A5636FUL, 0x84C87814UL, 0x8CC70208UL, 0x90BEFFFAUL, 0xA4506CEBUL, 0xBEF9A3F7UL, 0xC67178F2UL,
+};
+
+#define ROTR(x, n)      (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void Compress(BlSha256_t* ctx)
+{
+    uint32_t w[16];
+    uint32_t v[8];
+    uint32_t t1;
+    uint32_t t2;
+    uint8_t i;
+
+    for (i = 0; i < 16U; i++)
+    {
+        w[i] = ((uint32_t)ctx->block[4U * i] << 24) | ((uint32_t)ctx->block[4U * i + 1U] << 16) |
+               ((uint32_t)ctx->block[4U * i + 2U] << 8) | ctx->block[4U * i + 3U];
+    }
+    for (i = 0; i < 8U; i++)
+    {
+        v[i] = ctx->state[i];
+    }
+    for (i = 0; i < 64U; i++)
+    {
+        if (i >= 16U)
+        {
+            // Schedule word i replaces word i - 16
+            t1 = w[(i + 1U) & 15U];
+            t2 = w[(i + 14U) & 15U];
+            w[i & 15U] += (ROTR(t1, 7) ^ ROTR(t1, 18) ^ (t1 >> 3)) +
+                          (ROTR(t2, 17) ^ ROTR(t2, 19) ^ (t2 >> 10)) + w[(i + 9U) & 15U];
+        }
+        t1 = v[7] + (ROTR(v[4], 6) ^ ROTR(v[4], 11) ^ ROTR(v[4], 25)) +
+             ((v[4] & v[5]) ^ (~v[4] & v[6])) + roundK[i] + w[i & 15U];
+        t2 = (ROTR(v[0], 2) ^ ROTR(v[0], 13) ^ ROTR(v[0], 22)) +
+             ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+        v[7] = v[6];
+        v[6] = v[5];
+        v[5] = v[4];
+        v[4] = v[3] + t1;
+        v[3] = v[2];
+        v[2] = v[1];
+        v[1] = v[0];
+        v[0] = t1 + t2;
+    }
+    for (i = 0; i < 8U; i++)
+    {
+        ctx->state[i] += v[i];
+    }
+    ctx->fill = 0;
+}
+
+void BL_Sha256Init(BlSha256_t* ctx)
+{
+    ctx->state[0] = 0x6A09E667UL;
+    ctx->state[1] = 0xBB67AE85UL;
+    ctx->state[2] = 0x3C6EF372UL;
+    ctx->state[3] = 0xA54FF53AUL;
+    ctx->state[4] = 0x510E527FUL;
+    ctx->state[5] = 0x9B05688CUL;
+    ctx->state[6] = 0x1F83D9ABUL;
+    ctx->state[7] = 0x5BE0CD19UL;
+    ctx->length = 0;
+    ctx->fill = 0;
+}
+
+void BL_Sha256Update(BlSha256_t* ctx, const uint8_t* data, uint16_t length)
+{
+    uint8_t n;
+
+    ctx->length += length;
+    while (length != 0U)
+    {
+        n = (uint8_t)(BL_SHA256_BLOCK_SIZE - ctx->fill);
+        if (n > length)
+        {
+            n = (uint8_t)length;
+        }
+        memcpy(&ctx->block[ctx->fill], data, n);
+        ctx->fill += n;
+        data += n;
+        length -= n;
+        if (ctx->fill == BL_SHA256_BLOCK_SIZE)
+        {
+            Compress(ctx);
+        }
+    }
+}
+
+void BL_Sha256UpdateWords24(BlSha256_t* ctx, const uint32_t* words, uint8_t count)
+{
+    uint8_t* p;
+    uint32_t w;
+
+    ctx->length += 3UL * count;
+    while (count-- != 0U)
+    {
+        w = *words++;
+        if (ctx->fill <= BL_SHA256_BLOCK_SIZE - 3U)
+        {
+            // Whole instruction in this block, the common case
+            p = &ctx->block[ctx->fill];
+            p[0] = (uint8_t)w;
+            p[1] = (uint8_t)(w >> 8);
+            p[2] = (uint8_t)(w >> 16);
+            ctx->fill += 3U;
+            if (ctx->fill == BL_SHA256_BLOCK_SIZE)
+            {
+                Compress(ctx);
+            }
+            continue;
+        }
+        for (uint8_t i = 0; i < 3U; i++, w >>= 8)
+        {
+            ctx->block[ctx->fill++] = (uint8_t)w;
+            if (ctx->fill == BL_SHA256_BLOCK_SIZE)
+            {
+                Compress(ctx);
+            }
+        }
+    }
+}
+
+void BL_Sha256Final(BlSha256_t* ctx, uint8_t* digest)
+{
+    uint32_t bits = ctx->length << 3;   // images are far below 512 MB
+    uint8_t i;
+
+    ctx->block[ctx->fill++] = 0x80;
+    if (ctx->fill > BL_SHA256_BLOCK_SIZE - 8U)
+    {
+        while (ctx->fill < BL_SHA256_BLOCK_SIZE)
+        {
+            ctx->block[ctx->fill++] = 0;
+        }
+        Compress(ctx);
+    }
+    while (ctx->fill < BL_SHA256_BLOCK_SIZE - 4U)
+    {
+        ctx->block[ctx->fill++] = 0;
+    }
+    for (i = 0; i < 4U; i++)
+    {
+        ctx->block[BL_SHA256_BLOCK_SIZE - 1U - i] = (uint8_t)(bits >> (8U * i));
+    }
+    Compress(ctx);
+    for (i = 0; i < BL_SHA256_DIGEST_SIZE; i++)
+    {
+        digest[i] = (uint8_t)(ctx->state[i / 4U] >> (24U - 8U * (i % 4U)));
+    }
+}
+
+#endif // BL_AUTH
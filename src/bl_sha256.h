@@ -0,0 +1,36 @@
+/*
+ * SHA-256
+ *
+ * FIPS 180-4 SHA-256, the value Python's hashlib.sha256() returns. A
+ * context is about 100 bytes of RAM. The compression keeps a 16-word message
+ * schedule on the stack and extends it in place, so the only table is the
+ * 64 round constants.
+ *
+ * Start with BL_Sha256Init, feed data with BL_Sha256Update and finish with
+ * BL_Sha256Final. BL_Sha256UpdateWords24 feeds instructions as held in a
+ * row buffer, 3 bytes each, without packing them first.
+ */
+
+#ifndef BL_SHA256_H
+#define BL_SHA256_H
+
+#include <stdint.h>
+
+#define BL_SHA256_BLOCK_SIZE    64U
+#define BL_SHA256_DIGEST_SIZE   32U
+
+typedef struct
+{
+    uint32_t state[8];
+    uint32_t length;            // bytes so far
+    uint8_t block[BL_SHA256_BLOCK_SIZE];
+    uint8_t fill;               // bytes in 'block'
+} BlSha256_t;
+
+void BL_Sha256Init(BlSha256_t* ctx);
+void BL_Sha256Update(BlSha256_t* ctx, const uint8_t* data, uint16_t length);
+// The low 3 bytes of each of 'count' words, low byte first
+void BL_Sha256UpdateWords24(BlSha256_t* ctx, const uint32_t* words, uint8_t count);
+void BL_Sha256Final(BlSha256_t* ctx, uint8_t* digest);
+
+#endif // BL_SHA256_H
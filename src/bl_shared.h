@@ -0,0 +1,283 @@
+/*
+ * Bootloader / Application Shared Interface
+ *
+ * Fixed-address RAM structures exchanged between the bootloader and the
+ * application across a jump or RESET. This header is self-contained so the
+ * application project (com.X) can include it without the rest of the
+ * bootloader sources.
+ *
+ * Application area: BL_APP_START below, less BL_APP_DATA_START/SIZE.
+ *
+ * Layout of the .bl_persist window (see both linker scripts):
+ *   0x1200  BlHandoff_t   boot handoff descriptor (bootloader -> app)
+ *   0x1210  uint16_t      bootloader entry request (app -> bootloader)
+ *   0x1212+ bootloader-private persistent state
+ *
+ * and of .app_persist:
+ *   0x1240+ application fault diagnostics
+ *   0x1270  BlInstallReport_t  result of a staged install (bootloader -> app)
+ */
+
+#ifndef BL_SHARED_H
+#define BL_SHARED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ---------------------------------------------------------------------------
+// Application area
+//
+// The application's reset instruction is at BL_APP_START and its IVT right
+// behind it; everything below belongs to the bootloader. BL_SMALL builds
+// (build.ps1 -Small) fit the bootloader in 8 KB and give 0x2000-0x3FFF to
+// the application. Both sides must agree: link the application with
+// app_small_p24FJ64GB002.gld and build it with BL_SMALL defined when the
+// board runs a small bootloader.
+// ---------------------------------------------------------------------------
+#ifdef BL_SMALL
+#define BL_APP_START            0x2000      // no suffix: also pasted into asm("goto ...")
+#else
+#define BL_APP_START            0x4000
+#endif
+
+// ---------------------------------------------------------------------------
+// Preserved application data
+//
+// Program memory the application keeps its own data in (calibration,
+// configuration). The bootloader never erases or programs it: not on an
+// upload, a staging or golden install or an application-staged install, and
+// image CRCs count it as erased. Hosts refuse HEX files with content there
+// (upload_firmware.py --strip-data drops it instead), so the application
+// writes the page at run time only. Whole erase pages, PC units; size 0
+// gives the range back to the application code. The application linker
+// scripts keep their code below it.
+// ---------------------------------------------------------------------------
+#define BL_APP_DATA_START       0xA400UL
+#define BL_APP_DATA_SIZE        0x0400UL    // one page
+
+#define BL_STR_(x)              #x
+#define BL_STR(x)               BL_STR_(x)
+
+// ---------------------------------------------------------------------------
+// External staging store
+//
+// On boards with a SPI NOR on SPI1 (chip select RB13) the bootloader keeps
+// two upload slots, a golden image and an install area in these byte ranges
+// of the NOR (see bl_stage.h). The application may use the rest of the
+// device but must not write here, except to stage an install (below).
+// ---------------------------------------------------------------------------
+#define BL_STAGE_NOR_BASE       0x000000UL
+#define BL_STAGE_NOR_SIZE       0x020000UL
+
+// Golden (recovery) image, right behind the staging slots (see bl_golden.h)
+#define BL_GOLDEN_NOR_BASE      0x020000UL
+#define BL_GOLDEN_NOR_SIZE      0x010000UL
+
+// Application-staged install (bl_ota.h), behind the golden image
+#define BL_OTA_NOR_BASE         0x030000UL
+#define BL_OTA_NOR_SIZE         0x010000UL
+
+// ---------------------------------------------------------------------------
+// Boot handoff descriptor
+//
+// Written by the bootloader right before it transfers control to the
+// application. 'flags' lists the subsystems that are already initialized so
+// the application can skip redoing them (most notably the bounded PLL lock
+// wait in CLOCK_Initialize). The bootloader invalidates the descriptor on
+// every entry, so a valid descriptor always belongs to the current boot.
+//
+// Versioning: fields are append-only. 'size' is the size of the structure
+// the bootloader wrote; 'check' only covers the version 1 fields.
+// ---------------------------------------------------------------------------
+#define BL_HANDOFF_ADDRESS      0x1200U
+#define BL_HANDOFF_MAGIC        0x4846U     // 'HF'
+#define BL_HANDOFF_VERSION      1U
+
+// BlHandoff_t.flags
+#define BL_HANDOFF_CLOCK        0x0001U     // FRCPLL selected, FOSC = 32 MHz (CLOCK_Initialize ran)
+#define BL_HANDOFF_PLL_LOCK     0x0002U     // OSCCONbits.LOCK was set at handoff
+#define BL_HANDOFF_PMD          0x0004U     // PMD1..PMD4 = 0 (all peripheral modules powered)
+#define BL_HANDOFF_DIGITAL_IO   0x0008U     // AD1PCFG = 0xFFFF and LED pins RA2/RB14 are outputs;
+                                            // no other pin setup (PIN_MANAGER_Initialize did not run)
+#define BL_HANDOFF_RESET_CAUSE  0x0010U     // 'rcon' holds RCON as sampled at bootloader entry
+
+typedef struct
+{
+    uint16_t magic;         // BL_HANDOFF_MAGIC
+    uint8_t  version;       // BL_HANDOFF_VERSION
+    uint8_t  size;          // sizeof(BlHandoff_t) as written by the bootloader
+    uint16_t flags;         // BL_HANDOFF_xxx
+    uint16_t rcon;          // RCON at bootloader entry (reset cause)
+    uint16_t osccon;        // OSCCON at handoff
+    uint16_t check;         // BL_HandoffCheck() over the fields above
+} BlHandoff_t;
+
+#define BL_HANDOFF  (*(volatile BlHandoff_t*)BL_HANDOFF_ADDRESS)
+
+static inline uint16_t BL_HandoffCheck(const volatile BlHandoff_t* h)
+{
+    return (uint16_t)~(h->magic ^ (((uint16_t)h->version << 8) | h->size) ^
+                       h->flags ^ h->rcon ^ h->osccon);
+}
+
+// Application side: true if the bootloader handed off with every bit in
+// 'flags' already initialized. Example, at the top of the app's main():
+//
+//     if (!BL_HandoffHas(BL_HANDOFF_CLOCK | BL_HANDOFF_PLL_LOCK))
+//     {
+//         CLOCK_Initialize();
+//     }
+static inline bool BL_HandoffHas(uint16_t flags)
+{
+    const volatile BlHandoff_t* h = &BL_HANDOFF;
+
+    return (h->magic == BL_HANDOFF_MAGIC) &&
+           (h->version >= BL_HANDOFF_VERSION) &&
+           (h->size >= sizeof(BlHandoff_t)) &&
+           (h->check == BL_HandoffCheck(h)) &&
+           ((h->flags & flags) == flags);
+}
+
+// Application side: reset cause captured by the bootloader, or 0 if unknown.
+// The bootloader runs first on every reset, so RCON read by the app alone
+// does not tell it whether it was started by POR, a jump or a trap reset.
+static inline uint16_t BL_HandoffResetCause(void)
+{
+    return BL_HandoffHas(BL_HANDOFF_RESET_CAUSE) ? BL_HANDOFF.rcon : 0U;
+}
+
+// ---------------------------------------------------------------------------
+// Bootloader entry request
+//
+// The application writes BL_ENTRY_REQUEST_MAGIC here and resets; the
+// bootloader then stays resident instead of jumping back to the app, so a
+// host can start an upload without anyone touching the board.
+//
+// CDC "touch": a host opens the app's CDC port at BL_TOUCH_BAUD and closes
+// it again. Hook the MCC CDC stack's line coding request in the app:
+//
+//     // usb_device_config.h
+//     #define USB_CDC_SET_LINE_CODING_HANDLER APP_SetLineCodingHandler
+//
+//     void APP_SetLineCodingHandler(void)
+//     {
+//         CDCSetBaudRate(cdc_notice.SetLineCoding.dwDTERate);
+//         BL_CdcLineCodingTouch(cdc_notice.SetLineCoding.dwDTERate);
+//     }
+//
+// and call BL_EntryRequestService() from the app's main loop. The reset is
+// deferred to the main loop so the control transfer status stage completes
+// and the host's baud rate change does not fail.
+// ---------------------------------------------------------------------------
+#define BL_ENTRY_REQUEST_ADDRESS    0x1210U
+#define BL_ENTRY_REQUEST_MAGIC      0xB1E7U
+#define BL_TOUCH_BAUD               1200UL
+
+#define BL_ENTRY_REQUEST  (*(volatile uint16_t*)BL_ENTRY_REQUEST_ADDRESS)
+
+// Application side: call from the SET_LINE_CODING handler (interrupt context
+// in USB_INTERRUPT mode). Returns true if the baud rate was the touch value.
+static inline bool BL_CdcLineCodingTouch(uint32_t dwDTERate)
+{
+    if (dwDTERate != BL_TOUCH_BAUD)
+    {
+        return false;
+    }
+    BL_ENTRY_REQUEST = BL_ENTRY_REQUEST_MAGIC;
+    return true;
+}
+
+// Application side: write the request and reset into the bootloader now.
+static inline void BL_RequestBootloaderEntry(void)
+{
+    BL_ENTRY_REQUEST = BL_ENTRY_REQUEST_MAGIC;
+    __builtin_disi(0x3FFF);
+    __asm__ volatile ("reset");
+    while (1) { ; }
+}
+
+// Application side: call from the main loop. Resets into the bootloader once
+// a touch was seen, after a short delay to let EP0 finish the status stage.
+static inline void BL_EntryRequestService(void)
+{
+    if (BL_ENTRY_REQUEST == BL_ENTRY_REQUEST_MAGIC)
+    {
+        for (volatile uint32_t i = 0; i < 50000UL; i++) { ; }   // ~10 ms
+        BL_RequestBootloaderEntry();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Application-staged install
+//
+// Lets the application update itself with an image it received on its own
+// (e.g. over the radio). It erases BL_OTA_NOR_BASE..+BL_OTA_NOR_SIZE, writes
+// the row stream (bl_pack.h: row index relative to 'start', raw or
+// PackBits rows, end marker) at BL_OTA_NOR_BASE + BL_OTA_DATA_OFFSET, then
+// the manifest at BL_OTA_NOR_BASE, and calls BL_RequestInstall().
+// tools/ota_image.py builds both from a HEX file.
+//
+// The bootloader checks the manifest and the CRC of the whole image before
+// it changes anything, then compares the image with internal flash page by
+// page and erases and programs only the pages that differ, the page with
+// the application's reset vector last. Rows of [start, end) the stream
+// leaves out end up erased; flash outside [start, end) is not touched. The
+// outcome is left in BL_INSTALL_REPORT and the application is started
+// again (if there is a valid one).
+// ---------------------------------------------------------------------------
+#define BL_INSTALL_REQUEST_MAGIC    0x1A57U     // written to BL_ENTRY_REQUEST
+#define BL_OTA_DATA_OFFSET          0x1000UL
+#define BL_OTA_MAGIC                0x4D41544FUL    // "OTAM"
+
+// BlOtaManifest_t.flags
+#define BL_OTA_PACKBITS             0x0001U     // rows are PackBits-encoded
+
+typedef struct
+{
+    uint32_t magic;         // BL_OTA_MAGIC
+    uint32_t appStart;      // BL_APP_START the image was built for
+    uint32_t start;         // first program address, page (0x400) aligned
+    uint32_t end;           // first program address past the image, page aligned
+    uint32_t length;        // stream bytes, including the end marker
+    uint32_t crc;           // CRC-32 of the 3-byte instructions (low byte
+                            // first) of [start, end), 0xFFFFFF where erased
+                            // and in the preserved application data
+    uint16_t flags;         // BL_OTA_xxx
+    uint16_t reserved;
+} BlOtaManifest_t;
+
+#define BL_INSTALL_REPORT_ADDRESS   0x1270U
+#define BL_INSTALL_REPORT_MAGIC     0x5249U     // 'IR'
+
+// BlInstallReport_t.result
+#define BL_INSTALL_OK               0U
+#define BL_INSTALL_NO_DEVICE        1U          // no NOR, or too small
+#define BL_INSTALL_NOR_ERROR        2U
+#define BL_INSTALL_CRC_MISMATCH     3U          // image does not match manifest crc
+#define BL_INSTALL_NO_IMAGE         4U          // no manifest
+#define BL_INSTALL_FLASH_ERROR      5U          // erase/program failed or reads back wrong
+#define BL_INSTALL_BAD_MANIFEST     6U          // range, length, flags or appStart
+
+typedef struct
+{
+    uint16_t magic;         // BL_INSTALL_REPORT_MAGIC
+    uint16_t result;        // BL_INSTALL_xxx
+    uint32_t crc;           // manifest crc of the image it is about
+    uint16_t pagesErased;   // pages that differed
+    uint16_t pagesSkipped;  // pages already holding the image
+    uint16_t rowsWritten;
+    uint16_t count;         // installs attempted since power-up
+} BlInstallReport_t;
+
+#define BL_INSTALL_REPORT  (*(volatile BlInstallReport_t*)BL_INSTALL_REPORT_ADDRESS)
+
+// Application side: stage first, then reset into the bootloader to install.
+static inline void BL_RequestInstall(void)
+{
+    BL_ENTRY_REQUEST = BL_INSTALL_REQUEST_MAGIC;
+    __builtin_disi(0x3FFF);
+    __asm__ volatile ("reset");
+    while (1) { ; }
+}
+
+#endif // BL_SHARED_H
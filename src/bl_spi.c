@@ -0,0 +1,203 @@
+/*
+ * SPI1 Transfer Engine
+ */
+
+#include <xc.h>
+#include <stddef.h>
+#include "bl_spi.h"
+
+#define CON1_MSTEN          0x0020U
+#define CON1_CKP            0x0040U
+#define CON1_CKE            0x0100U
+#define CON2_SPIBEN         0x0001U
+
+// SPI1STAT.SISEL: interrupt when the last bit is shifted out and the TX
+// FIFO is empty, i.e. once per FIFO load
+#define SISEL_TX_DONE       5U
+// Above the USB interrupt (1): a refill is short and keeps SCK busy
+#define SPI_INTERRUPT_PRIORITY  2U
+
+// SPI1CON1.PPRE 00..11
+static const uint8_t primaryDivider[4] = { 64U, 16U, 4U, 1U };
+
+static uint16_t spiModeBits = CON1_MSTEN | CON1_CKE;
+static uint32_t spiClock = 0;
+
+static const uint8_t* asyncTx;
+static uint8_t* asyncRx;
+static uint16_t asyncLength;
+static uint16_t asyncSent;
+static uint16_t asyncReceived;
+static BlSpiDone_t asyncDone;
+static void* asyncContext;
+static volatile bool asyncBusy = false;
+
+uint32_t BL_SpiOpen(uint8_t mode, uint32_t hz)
+{
+    IEC0bits.SPI1IE = 0;
+    SPI1STATbits.SPIEN = 0;
+    asyncBusy = false;
+
+    // CKE = 1: data changes on the active-to-idle edge (CPHA = 0)
+    spiModeBits = CON1_MSTEN | ((mode & 2U) ? CON1_CKP : 0U) | ((mode & 1U) ? 0U : CON1_CKE);
+    SPI1CON2 = CON2_SPIBEN;
+    hz = BL_SpiSetClock(hz);
+
+    SPI1STATbits.SISEL = SISEL_TX_DONE;
+    IPC2bits.SPI1IP = SPI_INTERRUPT_PRIORITY;
+    IFS0bits.SPI1IF = 0;
+    SPI1STATbits.SPIEN = 1;
+    return hz;
+}
+
+void BL_SpiClose(void)
+{
+    IEC0bits.SPI1IE = 0;
+    SPI1STATbits.SPIEN = 0;
+    asyncBusy = false;
+}
+
+uint32_t BL_SpiSetClock(uint32_t hz)
+{
+    uint16_t prescale = 0;              // 64:1, 8:1
+    uint32_t best = BL_SPI_MIN_HZ;
+    uint32_t sck;
+    bool enabled = SPI1STATbits.SPIEN;
+
+    for (uint8_t ppre = 0; ppre < 4U; ppre++)
+    {
+        for (uint8_t secondary = 1; secondary <= 8U; secondary++)
+        {
+            if (primaryDivider[ppre] == 1U && secondary == 1U)
+            {
+                continue;
+            }
+            sck = BL_SPI_FCY_HZ / ((uint16_t)primaryDivider[ppre] * secondary);
+            if (sck <= hz && sck > best)
+            {
+                best = sck;
+                prescale = (uint16_t)(((8U - secondary) << 2) | ppre);
+            }
+        }
+    }
+
+    // SPI1CON1 may only change while the module is off
+    SPI1STATbits.SPIEN = 0;
+    SPI1CON1 = spiModeBits | prescale;
+    SPI1STATbits.SPIEN = enabled;
+
+    spiClock = best;
+    return best;
+}
+
+uint32_t BL_SpiClock(void)
+{
+    return spiClock;
+}
+
+uint8_t BL_SpiExchange(uint8_t data)
+{
+    while (SPI1STATbits.SPITBF) { ; }
+    SPI1BUF = data;
+    while (SPI1STATbits.SRXMPT) { ; }
+    return (uint8_t)SPI1BUF;
+}
+
+void BL_SpiTransfer(const uint8_t* tx, uint8_t* rx, uint16_t length)
+{
+    uint16_t sent = 0;
+    uint16_t received = 0;
+    uint8_t data;
+
+    // At most BL_SPI_FIFO_DEPTH bytes in flight, so the RX FIFO cannot overflow
+    while (received < length)
+    {
+        if (sent < length && (uint16_t)(sent - received) < BL_SPI_FIFO_DEPTH)
+        {
+            SPI1BUF = (tx != NULL) ? tx[sent] : BL_SPI_FILL;
+            sent++;
+        }
+        if (!SPI1STATbits.SRXMPT)
+        {
+            data = (uint8_t)SPI1BUF;
+            if (rx != NULL)
+            {
+                rx[received] = data;
+            }
+            received++;
+        }
+    }
+}
+
+// Collect what came back, then load the FIFO again.
+static void AsyncService(void)
+{
+    uint8_t data;
+
+    while (!SPI1STATbits.SRXMPT)
+    {
+        data = (uint8_t)SPI1BUF;
+        if (asyncRx != NULL)
+        {
+            asyncRx[asyncReceived] = data;
+        }
+        asyncReceived++;
+    }
+    while (asyncSent < asyncLength && (uint16_t)(asyncSent - asyncReceived) < BL_SPI_FIFO_DEPTH)
+    {
+        SPI1BUF = (asyncTx != NULL) ? asyncTx[asyncSent] : BL_SPI_FILL;
+        asyncSent++;
+    }
+}
+
+bool BL_SpiTransferAsync(const uint8_t* tx, uint8_t* rx, uint16_t length,
+                         BlSpiDone_t done, void* context)
+{
+    if (asyncBusy)
+    {
+        return false;
+    }
+    if (length == 0U)
+    {
+        if (done != NULL)
+        {
+            done(context);
+        }
+        return true;
+    }
+
+    asyncTx = tx;
+    asyncRx = rx;
+    asyncLength = length;
+    asyncSent = 0;
+    asyncReceived = 0;
+    asyncDone = done;
+    asyncContext = context;
+    asyncBusy = true;
+
+    // A load that completes before the interrupt is enabled leaves SPI1IF set
+    IFS0bits.SPI1IF = 0;
+    AsyncService();
+    IEC0bits.SPI1IE = 1;
+    return true;
+}
+
+bool BL_SpiBusy(void)
+{
+    return asyncBusy;
+}
+
+void __attribute__((interrupt, auto_psv)) _SPI1Interrupt(void)
+{
+    IFS0bits.SPI1IF = 0;
+    AsyncService();
+    if (asyncReceived == asyncLength)
+    {
+        IEC0bits.SPI1IE = 0;
+        asyncBusy = false;
+        if (asyncDone != NULL)
+        {
+            asyncDone(asyncContext);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * SPI1 Transfer Engine
+ *
+ * Replaces the MCC spi1.c calls for bulk traffic. spi1.c runs SPI1 at
+ * ~31 kHz (PPRE 64:1, SPRE 8:1) and moves one byte per TX/RX poll even
+ * though SPIBEN enables the 8-deep enhanced buffer. Here:
+ *
+ *   - BL_SpiOpen/BL_SpiSetClock pick the fastest prescaler pair at or below
+ *     the requested SCK, up to BL_SPI_MAX_HZ, and return the SCK they set
+ *   - BL_SpiTransfer keeps up to BL_SPI_FIFO_DEPTH bytes in flight, so SCK
+ *     runs back to back instead of idling between bytes
+ *   - BL_SpiTransferAsync runs the same pipeline from the SPI1 interrupt
+ *     (one interrupt per FIFO load) and calls 'done' in interrupt context
+ *     when the last byte is in
+ *
+ * Master, 8-bit, chip selects are the caller's. tx == NULL sends
+ * BL_SPI_FILL, rx == NULL drops what comes back. Only depends on <xc.h>,
+ * so the application can build this file too (e.g. for the LoRa radio);
+ * the bootloader forwards the SPI1 vector to the application (ivt_forward.s).
+ */
+
+#ifndef BL_SPI_H
+#define BL_SPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BL_SPI_FIFO_DEPTH   8U
+#define BL_SPI_FILL         0xFFU
+
+// Fastest SCK: Fcy / 2 (primary and secondary prescaler both 1:1 is not allowed)
+#define BL_SPI_FCY_HZ       16000000UL
+#define BL_SPI_MAX_HZ       (BL_SPI_FCY_HZ / 2UL)
+#define BL_SPI_MIN_HZ       (BL_SPI_FCY_HZ / 512UL)
+
+// SPI modes (CPOL, CPHA), mapped onto CKP/CKE
+#define BL_SPI_MODE0        0U
+#define BL_SPI_MODE1        1U
+#define BL_SPI_MODE2        2U
+#define BL_SPI_MODE3        3U
+
+typedef void (*BlSpiDone_t)(void* context);
+
+// Enable SPI1 as master. Returns the SCK set (see BL_SpiSetClock).
+uint32_t BL_SpiOpen(uint8_t mode, uint32_t hz);
+void BL_SpiClose(void);
+
+// Fastest SCK <= hz (BL_SPI_MIN_HZ if hz is below it); no transfer may be
+// running. Returns the SCK set.
+uint32_t BL_SpiSetClock(uint32_t hz);
+uint32_t BL_SpiClock(void);
+
+uint8_t BL_SpiExchange(uint8_t data);
+void BL_SpiTransfer(const uint8_t* tx, uint8_t* rx, uint16_t length);
+
+// False if a transfer is still running. The buffers must stay valid until
+// 'done' (may be NULL) has been called; it can run before this returns.
+bool BL_SpiTransferAsync(const uint8_t* tx, uint8_t* rx, uint16_t length,
+                         BlSpiDone_t done, void* context);
+bool BL_SpiBusy(void);
+
+#endif // BL_SPI_H
@@ -0,0 +1,35 @@
+/*
+ * Stack High-Water Mark
+ */
+
+#include <xc.h>
+#include "bl_stack.h"
+
+extern uint16_t _SP_init;       // linker: first stack word (__SP_init)
+
+void BL_StackPaint(void)
+{
+    // W15 points at the first free word. This loop makes no calls and runs
+    // with interrupts off, so nothing is pushed while it paints.
+    volatile uint16_t* p = (volatile uint16_t*)WREG15;
+    volatile uint16_t* end = (volatile uint16_t*)SPLIM;
+
+    while (p <= end)
+    {
+        *p++ = BL_STACK_PAINT;
+    }
+}
+
+void BL_StackUsage(BlStackUsage_t* out)
+{
+    const volatile uint16_t* base = (const volatile uint16_t*)&_SP_init;
+    const volatile uint16_t* p = (const volatile uint16_t*)SPLIM;
+
+    while (p > base && *p == BL_STACK_PAINT)
+    {
+        p--;
+    }
+
+    out->size = (uint16_t)(SPLIM + 2U - (uint16_t)base);
+    out->peak = (uint16_t)((uint16_t)p + 2U - (uint16_t)base);
+}
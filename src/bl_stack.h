@@ -0,0 +1,30 @@
+/*
+ * Stack High-Water Mark
+ *
+ * When the bootloader stays resident, main() paints the unused stack with
+ * BL_STACK_PAINT before any interrupt is enabled. The highest word that no longer holds the pattern
+ * is the deepest the stack has been since reset: main loop, every handler
+ * and the USB interrupt on top of them. BL_SerialInitialize seeds from the
+ * SRAM the paint overwrites, so it runs first. 'S' reports it (BlStatus_t
+ * stackSize/stackPeak); tools/ram_budget.py compares it with the map file.
+ *
+ * The PIC24 stack grows up, from __SP_init to SPLIM.
+ */
+
+#ifndef BL_STACK_H
+#define BL_STACK_H
+
+#include <stdint.h>
+
+#define BL_STACK_PAINT      0x5AA5U
+
+typedef struct
+{
+    uint16_t size;          // bytes from __SP_init to SPLIM
+    uint16_t peak;          // bytes used at the deepest point so far
+} BlStackUsage_t;
+
+void BL_StackPaint(void);
+void BL_StackUsage(BlStackUsage_t* out);
+
+#endif // BL_STACK_H
@@ -0,0 +1,327 @@
+/*
+ * External Staging Store
+ */
+
+#include <string.h>
+#include "bootloader.h"
+#include "bl_stage.h"
+#include "bl_nor.h"
+#include "bl_crc.h"
+#include "bl_counters.h"
+
+#ifndef BL_SMALL
+
+#define ROW_BYTES       (FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS * 4U)
+#define APP_ROWS        ((APP_END_ADDRESS + 2UL - APP_START_ADDRESS) / FLASH_WRITE_ROW_SIZE_IN_PC_UNITS)
+#define SLOT_SECTORS    ((BL_STAGE_DATA_OFFSET + APP_ROWS * ROW_BYTES + BL_NOR_SECTOR_SIZE - 1UL) / BL_NOR_SECTOR_SIZE)
+#define ERASED_ROW_WORD 0xFFFFFFFFUL
+#define ERASED_WORD     0x00FFFFFFUL
+
+static bool stageAvailable = false;
+static uint8_t stageReceiving = BL_STAGE_NO_SLOT;
+static bool stageWriteError = false;
+
+static uint32_t SlotBase(uint8_t slot)
+{
+    return BL_STAGE_NOR_BASE + (uint32_t)slot * BL_STAGE_SLOT_SIZE;
+}
+
+static uint32_t SlotRowAddress(uint8_t slot, uint16_t row)
+{
+    return SlotBase(slot) + BL_STAGE_DATA_OFFSET + (uint32_t)row * ROW_BYTES;
+}
+
+static uint32_t FlashRowAddress(uint16_t row)
+{
+    return APP_START_ADDRESS + (uint32_t)row * FLASH_WRITE_ROW_SIZE_IN_PC_UNITS;
+}
+
+static bool HeaderValid(const BlStageHeader_t* h)
+{
+    return (h->magic == BL_STAGE_MAGIC) && (h->appStart == APP_START_ADDRESS);
+}
+
+static void ReadHeaders(BlStageHeader_t* header)
+{
+    for (uint8_t s = 0; s < BL_STAGE_SLOTS; s++)
+    {
+        BL_NorRead(SlotBase(s), &header[s], sizeof(BlStageHeader_t));
+    }
+}
+
+static uint8_t NewestSlot(const BlStageHeader_t* header)
+{
+    uint8_t newest = BL_STAGE_NO_SLOT;
+
+    for (uint8_t s = 0; s < BL_STAGE_SLOTS; s++)
+    {
+        if (HeaderValid(&header[s]) &&
+            (newest == BL_STAGE_NO_SLOT || (int32_t)(header[s].seq - header[newest].seq) > 0))
+        {
+            newest = s;
+        }
+    }
+    return newest;
+}
+
+static bool WriteHeader(uint8_t slot, const BlStageHeader_t* h)
+{
+    return BL_NorEraseSector(SlotBase(slot)) &&
+           BL_NorProgram(SlotBase(slot), h, sizeof(*h));
+}
+
+// Image CRC of a slot, read one row at a time into 'rowBuffer'.
+static uint32_t SlotCrc(uint8_t slot, uint32_t* rowBuffer)
+{
+    uint32_t crc = BL_CRC32_INIT;
+
+    for (uint16_t r = 0; r < APP_ROWS; r++)
+    {
+        if (IS_APP_DATA_ADDRESS(FlashRowAddress(r)))
+        {
+            memset(rowBuffer, 0xFF, ROW_BYTES);     // counts as erased
+        }
+        else
+        {
+            BL_NorRead(SlotRowAddress(slot, r), rowBuffer, ROW_BYTES);
+        }
+        for (uint8_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+        {
+            crc = BL_Crc32Update(crc, (const uint8_t*)&rowBuffer[i], 3);
+        }
+    }
+    return BL_Crc32Final(crc);
+}
+
+uint32_t BL_StageFlashCrc(void)
+{
+    uint32_t crc = BL_CRC32_INIT;
+    uint32_t word;
+
+    for (uint32_t address = APP_START_ADDRESS; address <= APP_END_ADDRESS; address += 2)
+    {
+        word = IS_APP_DATA_ADDRESS(address) ? ERASED_WORD : FLASH_ReadWord24(address);
+        crc = BL_Crc32Update(crc, (const uint8_t*)&word, 3);
+    }
+    return BL_Crc32Final(crc);
+}
+
+static bool RowErased(const uint32_t* words)
+{
+    for (uint8_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+    {
+        if (words[i] != ERASED_ROW_WORD)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BL_StageInitialize(void)
+{
+    uint32_t id;
+    uint8_t capacity;
+
+    stageReceiving = BL_STAGE_NO_SLOT;
+    stageAvailable = false;
+    if (!BL_NorOpen())
+    {
+        return;
+    }
+
+    // JEDEC capacity byte is log2(bytes) on the parts this driver targets
+    id = BL_NorJedecId();
+    capacity = (uint8_t)id;
+    stageAvailable = (capacity >= 17U && capacity < 32U &&
+                      (1UL << capacity) >= BL_STAGE_NOR_BASE + BL_STAGE_NOR_SIZE);
+}
+
+bool BL_StageAvailable(void)
+{
+    return stageAvailable;
+}
+
+bool BL_StageActive(void)
+{
+    return stageReceiving != BL_STAGE_NO_SLOT;
+}
+
+void BL_StageCancel(void)
+{
+    stageReceiving = BL_STAGE_NO_SLOT;
+}
+
+BlStageResult_t BL_StageBegin(void)
+{
+    BlStageHeader_t header[BL_STAGE_SLOTS];
+    uint8_t slot;
+
+    stageReceiving = BL_STAGE_NO_SLOT;
+    if (!stageAvailable)
+    {
+        return BL_STAGE_NO_DEVICE;
+    }
+
+    ReadHeaders(header);
+    slot = NewestSlot(header);
+    slot = (slot == BL_STAGE_NO_SLOT) ? 0U : (uint8_t)((slot + 1U) % BL_STAGE_SLOTS);
+
+    // Header sector first: from here on the slot holds no image
+    for (uint8_t s = 0; s < SLOT_SECTORS; s++)
+    {
+        if (!BL_NorEraseSector(SlotBase(slot) + (uint32_t)s * BL_NOR_SECTOR_SIZE))
+        {
+            return BL_STAGE_NOR_ERROR;
+        }
+    }
+
+    stageWriteError = false;
+    stageReceiving = slot;
+    return BL_STAGE_OK;
+}
+
+void BL_StageWriteRow(uint32_t rowAddress, const uint32_t* words)
+{
+    uint16_t row = (uint16_t)((rowAddress - APP_START_ADDRESS) / FLASH_WRITE_ROW_SIZE_IN_PC_UNITS);
+
+    if (!BL_NorProgram(SlotRowAddress(stageReceiving, row), words, ROW_BYTES))
+    {
+        stageWriteError = true;
+    }
+}
+
+BlStageResult_t BL_StageCommit(uint32_t crc, uint32_t* rowBuffer)
+{
+    BlStageHeader_t header[BL_STAGE_SLOTS];
+    uint8_t slot = stageReceiving;
+    uint8_t newest;
+
+    stageReceiving = BL_STAGE_NO_SLOT;
+    if (slot == BL_STAGE_NO_SLOT)
+    {
+        return BL_STAGE_NO_IMAGE;
+    }
+    if (stageWriteError)
+    {
+        return BL_STAGE_NOR_ERROR;
+    }
+    if (SlotCrc(slot, rowBuffer) != crc)
+    {
+        return BL_STAGE_CRC_MISMATCH;
+    }
+
+    ReadHeaders(header);
+    newest = NewestSlot(header);
+    header[slot].magic = BL_STAGE_MAGIC;
+    header[slot].seq = (newest == BL_STAGE_NO_SLOT) ? 1UL : header[newest].seq + 1UL;
+    header[slot].crc = crc;
+    header[slot].appStart = APP_START_ADDRESS;
+
+    // The header sector was erased by BL_StageBegin
+    if (!BL_NorProgram(SlotBase(slot), &header[slot], sizeof(BlStageHeader_t)))
+    {
+        return BL_STAGE_NOR_ERROR;
+    }
+    return BL_STAGE_OK;
+}
+
+BlStageResult_t BL_StageInstall(bool rollback, uint32_t* rowBuffer)
+{
+    BlStageHeader_t header[BL_STAGE_SLOTS];
+    uint8_t newest;
+    uint8_t slot;
+    uint16_t row;
+
+    stageReceiving = BL_STAGE_NO_SLOT;
+    if (!stageAvailable)
+    {
+        return BL_STAGE_NO_DEVICE;
+    }
+
+    ReadHeaders(header);
+    newest = NewestSlot(header);
+    slot = newest;
+    if (rollback && newest != BL_STAGE_NO_SLOT)
+    {
+        slot = (uint8_t)((newest + 1U) % BL_STAGE_SLOTS);
+        if (!HeaderValid(&header[slot]))
+        {
+            slot = BL_STAGE_NO_SLOT;
+        }
+    }
+    if (slot == BL_STAGE_NO_SLOT)
+    {
+        return BL_STAGE_NO_IMAGE;
+    }
+
+    // The other slot is only the previous image while flash holds the newest
+    if (slot != newest && BL_StageFlashCrc() != header[newest].crc)
+    {
+        return BL_STAGE_NOT_INSTALLED;
+    }
+
+    // Nothing in internal flash changes unless the stored copy checks out
+    if (SlotCrc(slot, rowBuffer) != header[slot].crc)
+    {
+        return BL_STAGE_CRC_MISMATCH;
+    }
+    if (!Bootloader_EraseAppArea())
+    {
+        return BL_STAGE_FLASH_ERROR;
+    }
+
+    // Row 0 (reset vector) last
+    for (uint16_t n = 1; n <= APP_ROWS; n++)
+    {
+        row = n % APP_ROWS;
+        if (IS_APP_DATA_ADDRESS(FlashRowAddress(row)))
+        {
+            continue;
+        }
+        BL_NorRead(SlotRowAddress(slot, row), rowBuffer, ROW_BYTES);
+        if (RowErased(rowBuffer))
+        {
+            continue;
+        }
+        if (!FLASH_WriteRow24(FlashRowAddress(row), rowBuffer))
+        {
+            return BL_STAGE_FLASH_ERROR;
+        }
+        blCounters.rowsWritten++;
+    }
+
+    if (BL_StageFlashCrc() != header[slot].crc)
+    {
+        return BL_STAGE_FLASH_ERROR;
+    }
+
+    // A rolled-back image becomes the newest, so the next upload replaces
+    // the one that was rolled back from
+    if (slot != newest)
+    {
+        header[slot].seq = header[newest].seq + 1UL;
+        if (!WriteHeader(slot, &header[slot]))
+        {
+            return BL_STAGE_NOR_ERROR;
+        }
+    }
+    return BL_STAGE_OK;
+}
+
+void BL_StageInfo(BlStageInfo_t* out)
+{
+    memset(out, 0, sizeof(*out));
+    out->jedecId = BL_NorJedecId();
+    out->newest = BL_STAGE_NO_SLOT;
+    out->receiving = stageReceiving;
+    out->slots = BL_STAGE_SLOTS;
+    out->headerSize = sizeof(BlStageHeader_t);
+    if (stageAvailable)
+    {
+        ReadHeaders(out->slot);
+        out->newest = NewestSlot(out->slot);
+    }
+}
+
+#endif // BL_SMALL
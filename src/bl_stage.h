@@ -0,0 +1,117 @@
+/*
+ * External Staging Store
+ *
+ * Uploads can go to an external SPI NOR (bl_nor.h) instead of internal
+ * flash. A NOR page program takes well under a millisecond where internal
+ * flash stalls 1.6 ms per row and 20 ms per page erase, so the image is
+ * received at USB speed. It is then checked against the host's CRC in the
+ * NOR and only a verified image is copied to internal flash.
+ *
+ * The NOR range BL_STAGE_NOR_BASE/BL_STAGE_NOR_SIZE (bl_shared.h) holds two
+ * slots. An upload always goes to the slot that does not hold the newest
+ * image, so the image before it stays in the other slot as a rollback
+ * source. Slot layout:
+ *
+ *   +0x0000  BlStageHeader_t, written last (commit)
+ *   +0x1000  application area, 4 bytes per instruction in HEX file order
+ *            (low byte first, phantom byte 0): one program row is one NOR
+ *            page. Rows the image does not touch stay erased.
+ *
+ * Image CRC: CRC-32 (bl_crc.h) over the 3 bytes (low byte first) of every
+ * instruction from APP_START_ADDRESS to APP_END_ADDRESS, 0xFFFFFF where the
+ * image has none and throughout the preserved application data
+ * (BL_APP_DATA_START, bl_shared.h), which an install never touches.
+ * Internal flash gives the same CRC after an install.
+ *
+ * Commands:
+ *   TB          begin: erase the older slot; HEX records now go to it
+ *   TC<crc>     commit: flush, CRC the slot (8 hex digits expected) and
+ *               write its header if it matches
+ *   TI          install the newest slot into internal flash
+ *   TR          roll back: install the other slot and make it the newest;
+ *               refused unless internal flash holds the newest slot's image
+ *   T           BlStageInfo_t as one hex-encoded line
+ *
+ * Only staged uploads update the slots. After a direct upload the other
+ * slot is two images back, not the previous one, so 'TR' first compares
+ * the CRC of internal flash with the newest slot's and refuses on a
+ * mismatch.
+ *
+ * An install re-checks the slot CRC before it erases anything, programs the
+ * row holding the application's reset vector last (an interrupted install
+ * leaves no valid application) and compares the CRC of internal flash with
+ * the slot's when done.
+ */
+
+#ifndef BL_STAGE_H
+#define BL_STAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BL_STAGE_SLOTS          2U
+#define BL_STAGE_SLOT_SIZE      0x10000UL
+#define BL_STAGE_DATA_OFFSET    0x1000UL
+#define BL_STAGE_MAGIC          0x47545342UL    // "BSTG"
+#define BL_STAGE_NO_SLOT        0xFFU
+
+typedef struct
+{
+    uint32_t magic;         // BL_STAGE_MAGIC, anything else: no image
+    uint32_t seq;           // newest image has the highest (wrapping compare)
+    uint32_t crc;           // image CRC
+    uint32_t appStart;      // APP_START_ADDRESS the image was staged for
+} BlStageHeader_t;
+
+typedef struct
+{
+    uint32_t jedecId;       // BL_NorJedecId(), 0: no staging store
+    uint8_t  newest;        // slot 'TI' installs, BL_STAGE_NO_SLOT if none
+    uint8_t  receiving;     // slot 'TB' opened, BL_STAGE_NO_SLOT if none
+    uint8_t  slots;         // BL_STAGE_SLOTS
+    uint8_t  headerSize;    // sizeof(BlStageHeader_t)
+    BlStageHeader_t slot[BL_STAGE_SLOTS];   // as read from the NOR
+} BlStageInfo_t;
+
+typedef enum
+{
+    BL_STAGE_OK,
+    BL_STAGE_NO_DEVICE,     // no NOR, or smaller than the staging range
+    BL_STAGE_NOR_ERROR,     // NOR program/erase timed out
+    BL_STAGE_CRC_MISMATCH,  // slot content does not match the expected CRC
+    BL_STAGE_NO_IMAGE,      // no (other) valid slot to install
+    BL_STAGE_FLASH_ERROR,   // internal erase/program failed or reads back wrong
+    BL_STAGE_BAD_MANIFEST,  // staged install: manifest does not fit this bootloader
+    BL_STAGE_NOT_INSTALLED  // rollback: internal flash is not the newest slot's image
+} BlStageResult_t;
+
+#ifndef BL_SMALL
+// Probe the NOR; every entry into the bootloader, staging off.
+void BL_StageInitialize(void);
+bool BL_StageAvailable(void);
+
+// True between 'TB' and 'TC': program rows go to the NOR.
+bool BL_StageActive(void);
+void BL_StageCancel(void);
+#else
+// BL_SMALL: no staging store, 'T' is not answered
+#define BL_StageInitialize()    ((void)0)
+#define BL_StageAvailable()     false
+#define BL_StageActive()        false
+#define BL_StageCancel()        ((void)0)
+#endif
+
+BlStageResult_t BL_StageBegin(void);
+void BL_StageWriteRow(uint32_t rowAddress, const uint32_t* words);
+
+// 'rowBuffer' is scratch space for one row (FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS
+// words); the caller's row buffers are idle at this point.
+BlStageResult_t BL_StageCommit(uint32_t crc, uint32_t* rowBuffer);
+BlStageResult_t BL_StageInstall(bool rollback, uint32_t* rowBuffer);
+
+void BL_StageInfo(BlStageInfo_t* out);
+
+// Image CRC of the application area in internal flash.
+uint32_t BL_StageFlashCrc(void);
+
+#endif // BL_STAGE_H
@@ -0,0 +1,91 @@
+/*
+ * Status Record
+ */
+
+#include <string.h>
+#include "bootloader.h"
+#include "bl_status.h"
+#include "bl_bootlog.h"
+#include "bl_stack.h"
+#include "bl_stage.h"
+#include "bl_golden.h"
+
+#ifdef BL_BENCH
+#define STATUS_CAP_BENCH    BL_CAP_BENCH
+#else
+#define STATUS_CAP_BENCH    0U
+#endif
+
+#ifdef BL_SMALL
+#define STATUS_CAP_FULL     0U
+#define STATUS_CRC          BL_CRC_NONE
+#elif defined(BL_AUTH)
+// No 'W', 'D', 'T' or 'G': every write to the application area is a signed upload
+#define STATUS_CAP_FULL     (BL_CAP_LINK_TEST | BL_CAP_PROFILE | BL_CAP_AUTH)
+#define STATUS_CRC          BL_CRC_CRC32
+#else
+#define STATUS_CAP_FULL     (BL_CAP_LINK_TEST | BL_CAP_PROFILE | BL_CAP_PATCH | BL_CAP_DELTA)
+#define STATUS_CRC          BL_CRC_CRC32
+#endif
+
+void BL_StatusRead(BlStatus_t* out)
+{
+    BlStackUsage_t stack;
+
+    memset(out, 0, sizeof(*out));
+
+    out->schema = BL_STATUS_SCHEMA;
+    out->size = sizeof(BlStatus_t);
+    out->versionMajor = BL_VERSION_MAJOR;
+    out->versionMinor = BL_VERSION_MINOR;
+    out->capabilities = BL_CAP_COUNTERS | BL_CAP_BOOT_LOG | BL_CAP_HEX_WINDOW |
+                        STATUS_CAP_FULL | STATUS_CAP_BENCH;
+#ifndef BL_AUTH
+    if (BL_StageAvailable())
+    {
+        out->capabilities |= BL_CAP_STAGING;
+    }
+#endif
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+    if (BL_GoldenAvailable())
+    {
+        out->capabilities |= BL_CAP_GOLDEN;
+    }
+#endif
+
+    out->appStart = APP_START_ADDRESS;
+    out->appEnd = APP_END_ADDRESS;
+
+    out->stubToAppCount = blStubToAppCount;
+    out->jumpReturnCount = blJumpReturnCount;
+    out->sawResetStub = blSawResetStubMagic;
+    out->lastRcon = blLastRcon;
+    out->lastCmd = blLastCmd;
+    out->cmdCount = blCmdCount;
+    out->bootSeq = blBootLog.seq;
+
+    out->appTrapCode = appTrapCode;
+    out->appTrapCount = appTrapCount;
+    out->appTrapIntcon1 = appTrapIntcon1;
+    out->appTrapRcon = appTrapRcon;
+    out->appBootCount = appBootCount;
+    out->appStage = appStage;
+    out->appLastRcon = appLastRcon;
+
+    memcpy(out->serial, BL_SerialString(), BL_SERIAL_CHARS);
+
+    out->maxLine = RX_BUFFER_SIZE - 1;
+    out->maxRecordBytes = HEX_RECORD_MAX_BYTES;
+    out->windowDepth = HEX_WINDOW_DEPTH;
+    out->rowSize = FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS;
+    out->pageSize = FLASH_ERASE_PAGE_SIZE_IN_INSTRUCTIONS;
+    out->compression = BL_COMPRESSION_NONE;
+    out->crc = STATUS_CRC;
+
+    BL_StackUsage(&stack);
+    out->stackSize = stack.size;
+    out->stackPeak = stack.peak;
+
+    out->appDataStart = APP_DATA_START_ADDRESS;
+    out->appDataSize = BL_APP_DATA_SIZE;
+}
@@ -0,0 +1,93 @@
+/*
+ * Status Record
+ *
+ * Binary form of the bootloader's identity, memory map and diagnostics.
+ * 'S' returns one BlStatus_t as a hex-encoded line (see
+ * Bootloader_SendHexBlock); 'V' only identifies the bootloader.
+ *
+ * Schema rules: 'schema' changes only if an existing field moves or changes
+ * meaning. New fields are appended and the host uses 'size' to tell which
+ * ones the device has. Keep the size a multiple of 4 so the layout is the
+ * same under XC16 and the host simulator.
+ */
+
+#ifndef BL_STATUS_H
+#define BL_STATUS_H
+
+#include <stdint.h>
+#include "bl_serial.h"
+
+#define BL_STATUS_SCHEMA        1U
+
+// BlStatus_t.capabilities: optional commands this build answers
+#define BL_CAP_LINK_TEST        0x0001U     // 'L' (bl_link.h)
+#define BL_CAP_COUNTERS         0x0002U     // 'K', 'Z' (bl_counters.h)
+#define BL_CAP_PROFILE          0x0004U     // 'P' (bl_prof.h)
+#define BL_CAP_BOOT_LOG         0x0008U     // 'H' (bl_bootlog.h)
+#define BL_CAP_BENCH            0x0010U     // 'B' (BL_BENCH builds)
+#define BL_CAP_HEX_WINDOW       0x0020U     // HEX records may be pipelined, up to windowDepth
+#define BL_CAP_STAGING          0x0040U     // 'T' with a SPI NOR fitted (bl_stage.h)
+#define BL_CAP_GOLDEN           0x0080U     // 'G' with a SPI NOR of 256 KB or more (bl_golden.h)
+#define BL_CAP_PATCH            0x0100U     // 'M', 'R', 'W' and 'E<addr>' (in-place patching)
+#define BL_CAP_DELTA            0x0200U     // 'D' (bl_delta.h)
+#define BL_CAP_AUTH             0x0400U     // uploads must be signed (BL_AUTH builds, bl_auth.h)
+
+// BlStatus_t.compression / .crc
+#define BL_COMPRESSION_NONE     0U
+#define BL_CRC_NONE             0U
+#define BL_CRC_CRC32            1U          // bl_crc.h
+
+typedef struct
+{
+    uint8_t  schema;            // BL_STATUS_SCHEMA
+    uint8_t  size;              // sizeof(BlStatus_t)
+    uint8_t  versionMajor;      // BL_VERSION_MAJOR
+    uint8_t  versionMinor;      // BL_VERSION_MINOR
+    uint16_t capabilities;      // BL_CAP_xxx
+    uint16_t reserved;
+
+    // Application area, program memory (PC) addresses
+    uint32_t appStart;          // APP_START_ADDRESS
+    uint32_t appEnd;            // APP_END_ADDRESS, inclusive
+
+    // Bootloader diagnostics (.bl_persist, .bl_log)
+    uint16_t stubToAppCount;    // blStubToAppCount
+    uint16_t jumpReturnCount;   // blJumpReturnCount
+    uint16_t sawResetStub;      // blSawResetStubMagic
+    uint16_t lastRcon;          // blLastRcon
+    uint16_t lastCmd;           // blLastCmd
+    uint16_t cmdCount;          // blCmdCount
+    uint16_t bootSeq;           // boots in the boot event log
+
+    // Application fault fields (.app_persist)
+    uint16_t appTrapCode;
+    uint16_t appTrapCount;
+    uint16_t appTrapIntcon1;
+    uint16_t appTrapRcon;
+    uint16_t appBootCount;
+    uint16_t appStage;
+    uint16_t appLastRcon;
+
+    char     serial[BL_SERIAL_CHARS];   // BL_SerialString(), not NUL-terminated
+
+    // Transfer limits, so the host can pick the fastest mode this build takes
+    uint16_t maxLine;           // longest command line, RX_BUFFER_SIZE - 1
+    uint16_t maxRecordBytes;    // longest HEX data field, HEX_RECORD_MAX_BYTES
+    uint16_t windowDepth;       // HEX records in flight, HEX_WINDOW_DEPTH
+    uint16_t rowSize;           // instructions per program row
+    uint16_t pageSize;          // instructions per erase page
+    uint8_t  compression;       // BL_COMPRESSION_xxx accepted for HEX data
+    uint8_t  crc;               // BL_CRC_xxx engine for verify
+
+    // Stack use (bl_stack.h), 0 if not measured
+    uint16_t stackSize;         // bytes from __SP_init to SPLIM
+    uint16_t stackPeak;         // high-water mark since the bootloader started
+
+    // Preserved application data (bl_shared.h), never erased or programmed
+    uint32_t appDataStart;      // BL_APP_DATA_START
+    uint32_t appDataSize;       // BL_APP_DATA_SIZE in PC units, 0: none
+} BlStatus_t;
+
+void BL_StatusRead(BlStatus_t* out);
+
+#endif // BL_STATUS_H
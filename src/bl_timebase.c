@@ -0,0 +1,45 @@
+/*
+ * Cycle Timebase (TMR2/TMR3, 32-bit mode)
+ */
+
+#include <xc.h>
+#include "bl_timebase.h"
+
+void BL_TimebaseStart(void)
+{
+    T2CON = 0;
+    T3CON = 0;
+    IEC0bits.T3IE = 0;
+    IFS0bits.T3IF = 0;
+
+    TMR3 = 0;
+    TMR2 = 0;
+    PR3 = 0xFFFF;
+    PR2 = 0xFFFF;
+
+    // TCKPS 1:1; TCS FOSC/2; T32 on. TMR3 interrupt stays disabled.
+    T2CONbits.T32 = 1;
+    T2CONbits.TON = 1;
+}
+
+void BL_TimebaseStop(void)
+{
+    T2CON = 0;
+    T3CON = 0;
+    IFS0bits.T3IF = 0;
+}
+
+uint32_t BL_TimebaseNow(void)
+{
+    // Reading TMR2 latches the upper half into TMR3HLD. The USB ISR reads
+    // the timebase too (PROF_USB_ISR), and its TMR2 read between these two
+    // would re-latch TMR3HLD, so mask interrupts for the pair. IPL rather
+    // than DISI: callers may already be inside a __builtin_disi() section.
+    uint16_t ipl = SRbits.IPL;
+    SRbits.IPL = 7;
+    uint16_t lsw = TMR2;
+    uint16_t msw = TMR3HLD;
+    SRbits.IPL = ipl;
+
+    return ((uint32_t)msw << 16) | lsw;
+}
@@ -0,0 +1,25 @@
+/*
+ * Cycle Timebase
+ *
+ * TMR2/TMR3 cascaded into one 32-bit free-running counter clocked at FCY,
+ * so one tick is one instruction cycle (62.5 ns at 16 MIPS) and the counter
+ * wraps after ~268 s. Differences of BL_TimebaseNow() values are valid
+ * across a wrap as long as the interval is shorter than that.
+ *
+ * main() starts it at C entry, so ticks also measure time since reset. The
+ * application owns TMR2/TMR3 after the jump; every path into the app stops
+ * the timebase.
+ */
+
+#ifndef BL_TIMEBASE_H
+#define BL_TIMEBASE_H
+
+#include <stdint.h>
+
+#define BL_TIMEBASE_HZ      16000000UL
+
+void     BL_TimebaseStart(void);
+void     BL_TimebaseStop(void);
+uint32_t BL_TimebaseNow(void);
+
+#endif // BL_TIMEBASE_H
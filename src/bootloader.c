@@ -6,11 +6,25 @@
  */
 
 #include "bootloader.h"
+#include "bl_timebase.h"
+#include "bl_bench.h"
+#include "bl_serial.h"
+#include "bl_link.h"
+#include "bl_counters.h"
+#include "bl_prof.h"
+#include "bl_bootlog.h"
+#include "bl_status.h"
+#include "bl_stage.h"
+#include "bl_golden.h"
+#include "bl_ota.h"
+#include "bl_pack.h"
+#include "bl_crc.h"
+#include "bl_delta.h"
+#include "bl_auth.h"
 #include "mcc_generated_files/mcc.h"
 #include "mcc_generated_files/usb/usb.h"
 #include "mcc_generated_files/usb/usb_device_cdc.h"
 #include <string.h>
-#include <stdio.h>
 
 // Bootloader state
 static BootloaderState_t blState = BL_STATE_IDLE;
@@ -21,27 +35,440 @@ static volatile bool hostActivity = false;
 // Receive buffer
 static char rxBuffer[RX_BUFFER_SIZE];
 static uint16_t rxIndex = 0;
+static bool rxOverrun = false;
 
-// Flash write buffer (must be aligned for row writes)
-static uint32_t flashBuffer[FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS];
-static uint32_t flashBufferAddress = 0xFFFFFFFF;
-static uint16_t flashBufferIndex = 0;
+// Main-loop buffers kept off the stack (bl_stack.h): one CDC OUT packet, the
+// response line, and the binary reply snapshots or the decoded delta
+// operations of one command.
+static uint8_t usbRxPacket[64];
+static char txLine[TX_LINE_SIZE];
+static union
+{
+    BlCounters_t counters;
+#ifndef BL_SMALL
+    BlProfile_t profile;
+    BlStageInfo_t stage;
+    BlGoldenInfo_t golden;
+#ifndef BL_AUTH
+    uint8_t deltaOps[(RX_BUFFER_SIZE - 3) / 2];    // "DD<hex>"
+#endif
+#endif
+    BlStatus_t status;
+} replyBlock;
+
+// Flash write buffers, one row each (must be aligned for row writes). A delta
+// page ('D', bl_delta.h) is rebuilt in the same memory; the rows are flushed
+// first and freed again afterwards.
+#define ROW_FREE    0xFFFFFFFFUL
+#define ERASED_WORD 0x00FFFFFFUL
+typedef struct
+{
+    uint32_t address;       // row address, ROW_FREE if unused
+    uint32_t word[FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS];
+} FlashRow_t;
+
+static union
+{
+    FlashRow_t rows[FLASH_ROW_BUFFERS];
+#ifndef BL_SMALL
+    uint32_t deltaPage[BL_DELTA_PAGE_WORDS];
+#endif
+} flashBuffer;
+static uint8_t flashRowNext = 0;   // oldest row, written out when a new one is needed
 
 // Statistics
 static uint32_t bytesWritten = 0;
 static uint32_t pagesErased = 0;
+// Set by Bootloader_Initialize, which main() calls after USBDeviceInit. The
+// unattended golden restore and staged install erase before either.
+static bool usbRunning = false;
 
 // Diagnostics (must survive RESET; placed in .bl_persist via bootloader linker script)
 volatile uint16_t blLastCmd __attribute__((persistent, section(".bl_persist")));
 volatile uint16_t blCmdCount __attribute__((persistent, section(".bl_persist")));
 
 // Version string (single-line; host tools typically read only one line)
-static const char VERSION_STRING[] = "BLv1.2";
+#define VERSION_STRING      "BLv" BL_STR(BL_VERSION_MAJOR) "." BL_STR(BL_VERSION_MINOR)
 
 // Forward declarations
 static void ProcessLine(const char* line);
 static void FlushFlashBuffer(void);
+static void WriteFlashRow(FlashRow_t* row);
+static FlashRow_t* GetFlashRow(uint32_t rowAddress);
+static void FreeFlashRows(void);
+static void ClearFlashBuffer(uint32_t* words);
+static void SendTxLine(void);
 static bool IsAddressInAppArea(uint32_t address);
+static bool IsPageBlank(uint32_t address);
+static void StrCatDec(char* s, uint32_t value);
+#ifdef BL_BENCH
+static void BenchPrint(const char* line)
+{
+    Bootloader_SendResponse(RSP_OK, line);
+}
+#endif
+
+#ifndef BL_SMALL
+#ifndef BL_AUTH
+// BlStageResult_t as reply text
+static const char* const stageErrors[] =
+{
+    "", "Stage: no device\r\n", "Stage: NOR error\r\n", "Stage: CRC mismatch\r\n",
+    "Stage: no image\r\n", "Stage: flash error\r\n", "Stage: bad manifest\r\n",
+    "Stage: flash is not the newest image\r\n",
+};
+
+// BlPatchResult_t as reply text
+static const char* const patchErrors[] =
+{
+    "", "Patch: range\r\n", "Patch: sets bits\r\n", "Patch: flash error\r\n",
+};
+
+// BlDeltaResult_t as reply text
+static const char* const deltaErrors[] =
+{
+    "", "", "Delta: args\r\n", "Delta: bad op\r\n", "Delta: CRC mismatch\r\n",
+    "Delta: flash error\r\n",
+};
+#endif
+
+// 'bytes' bytes of big-endian hex, e.g. the 6 digits of an address
+static uint32_t HexToValue(const char* hex, uint8_t bytes)
+{
+    uint32_t value = 0;
+
+    while (bytes-- != 0U)
+    {
+        value = (value << 8) | Bootloader_HexToByte(hex);
+        hex += 2;
+    }
+    return value;
+}
+
+// 'rows' whole rows from 'address', all inside the application area
+static bool IsAppRows(uint32_t address, uint16_t rows)
+{
+    return ((address & (FLASH_WRITE_ROW_SIZE_IN_PC_UNITS - 1UL)) == 0U) &&
+           (address >= APP_START_ADDRESS) &&
+           (address + (uint32_t)rows * FLASH_WRITE_ROW_SIZE_IN_PC_UNITS <= APP_END_ADDRESS + 2UL);
+}
+
+#ifndef BL_AUTH
+// "T<sub>": external staging store, see bl_stage.h.
+static void StageCommand(const char* line)
+{
+    BlStageResult_t result;
+    uint32_t crc = 0;
+
+    switch (line[1])
+    {
+        case '\0':
+            BL_StageInfo(&replyBlock.stage);
+            Bootloader_SendHexBlock(CMD_STAGE, &replyBlock.stage, sizeof(replyBlock.stage));
+            return;
+
+        case 'B':
+            FlushFlashBuffer();     // rows buffered so far belong to internal flash
+            result = BL_StageBegin();
+            if (result == BL_STAGE_OK)
+            {
+                blState = BL_STATE_RECEIVING_HEX;
+                Bootloader_SendResponse(RSP_OK, "Staging\r\n");
+                return;
+            }
+            break;
+
+        case 'C':
+            if (strlen(line) != 10U)
+            {
+                Bootloader_SendResponse(RSP_ERROR, "Stage args\r\n");
+                return;
+            }
+            crc = HexToValue(&line[2], 4);
+            FlushFlashBuffer();
+            result = BL_StageCommit(crc, flashBuffer.rows[0].word);
+            if (result == BL_STAGE_OK)
+            {
+                Bootloader_SendResponse(RSP_OK, "Staged\r\n");
+                return;
+            }
+            break;
+
+        case 'I':
+        case 'R':
+            FlushFlashBuffer();
+            result = BL_StageInstall(line[1] == 'R', flashBuffer.rows[0].word);
+            if (result == BL_STAGE_OK)
+            {
+                blState = BL_STATE_COMPLETE;
+                Bootloader_SendResponse(RSP_OK, "Installed\r\n");
+                return;
+            }
+            break;
+
+        default:
+            Bootloader_SendResponse(RSP_UNKNOWN, "Unknown command\r\n");
+            return;
+    }
+    Bootloader_SendResponse(RSP_ERROR, stageErrors[result]);
+}
+
+#endif
+
+#ifndef BL_AUTH
+// "G<sub>": golden image, see bl_golden.h.
+static void GoldenCommand(const char* line)
+{
+    BlStageResult_t result;
+
+    BL_StageCancel();
+    FlushFlashBuffer();
+    switch (line[1])
+    {
+        case '\0':
+            BL_GoldenInfo(&replyBlock.golden);
+            Bootloader_SendHexBlock(CMD_GOLDEN, &replyBlock.golden, sizeof(replyBlock.golden));
+            return;
+
+        case 'S':
+            result = BL_GoldenSave(flashBuffer.rows[0].word, flashBuffer.rows[1].word);
+            if (result == BL_STAGE_OK)
+            {
+                Bootloader_SendResponse(RSP_OK, "Golden saved\r\n");
+                return;
+            }
+            break;
+
+        case 'R':
+            result = BL_GoldenRestore(flashBuffer.rows[0].word, flashBuffer.rows[1].word);
+            if (result == BL_STAGE_OK)
+            {
+                blState = BL_STATE_COMPLETE;
+                Bootloader_SendResponse(RSP_OK, "Golden restored\r\n");
+                return;
+            }
+            break;
+
+        default:
+            Bootloader_SendResponse(RSP_UNKNOWN, "Unknown command\r\n");
+            return;
+    }
+    Bootloader_SendResponse(RSP_ERROR, stageErrors[result]);
+}
+
+bool Bootloader_RestoreGolden(void)
+{
+    // Runs before Bootloader_Initialize
+    FLASH_Unlock(FLASH_UNLOCK_KEY);
+    return BL_GoldenRestore(flashBuffer.rows[0].word, flashBuffer.rows[1].word) == BL_STAGE_OK;
+}
+
+bool Bootloader_InstallStaged(void)
+{
+    FLASH_Unlock(FLASH_UNLOCK_KEY);
+    return BL_OtaInstall(flashBuffer.rows[0].word, flashBuffer.rows[1].word) == BL_STAGE_OK;
+}
+#endif // BL_AUTH
+
+// "L<mode><count>": raw CDC throughput test, see bl_link.h.
+static void LinkTest(const char* line)
+{
+    BlLinkResult_t result;
+    char mode = line[1];
+    uint32_t count = 0;
+    bool ok;
+
+    for (const char* p = &line[2]; *p >= '0' && *p <= '9'; p++)
+    {
+        count = count * 10U + (uint32_t)(*p - '0');
+    }
+    if (count == 0U ||
+        (mode != BL_LINK_SINK && mode != BL_LINK_SOURCE && mode != BL_LINK_ECHO))
+    {
+        Bootloader_SendResponse(RSP_ERROR, "Link args\r\n");
+        return;
+    }
+
+    Bootloader_SendResponse(RSP_OK, "Link ready\r\n");
+    ok = BL_LinkTest(mode, count, &result);
+
+    txLine[0] = ok ? RSP_OK : RSP_ERROR;
+    strcpy(&txLine[1], "Link ? bytes=");
+    txLine[6] = mode;
+    StrCatDec(txLine, result.bytes);
+    strcat(txLine, " cycles=");
+    StrCatDec(txLine, result.cycles);
+    strcat(txLine, "\r\n");
+    SendTxLine();
+}
+
+// "M<addr><n>": CRC-32 of each of n (1..64) rows from 'addr', 3 bytes per
+// instruction as in the image CRC, so a host can find the rows that differ
+// from its image without reading them.
+static void CrcMapCommand(const char* line)
+{
+    uint32_t address = HexToValue(&line[1], 3);
+    uint8_t rows = (uint8_t)HexToValue(&line[7], 1);
+    uint32_t* map = flashBuffer.rows[0].word;
+    uint32_t crc;
+    uint32_t word;
+
+    if (strlen(line) != 9U || rows == 0U || rows > FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS ||
+        !IsAppRows(address, rows))
+    {
+        Bootloader_SendResponse(RSP_ERROR, "Map args\r\n");
+        return;
+    }
+    FlushFlashBuffer();         // buffered rows first; flashBuffer.rows[0] is free then
+    for (uint8_t r = 0; r < rows; r++)
+    {
+        crc = BL_CRC32_INIT;
+        for (uint8_t i = 0; i < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; i++)
+        {
+            word = FLASH_ReadWord24(address);
+            crc = BL_Crc32Update(crc, (const uint8_t*)&word, 3);
+            address += 2;
+        }
+        map[r] = BL_Crc32Final(crc);
+    }
+    Bootloader_SendHexBlock(CMD_CRC_MAP, map, (uint16_t)rows * 4U);
+}
+
+// "R<addr>": one row of the application area, 3 bytes per instruction
+static void ReadRowCommand(const char* line)
+{
+    uint32_t address = HexToValue(&line[1], 3);
+
+    if (strlen(line) != 7U || !IsAppRows(address, 1))
+    {
+        Bootloader_SendResponse(RSP_ERROR, "Read args\r\n");
+        return;
+    }
+    FlushFlashBuffer();
+    BL_PackFlashRow(address, (uint8_t*)flashBuffer.rows[0].word);
+    Bootloader_SendHexBlock(CMD_READ_FLASH, flashBuffer.rows[0].word, BL_PACK_ROW_BYTES);
+}
+
+#ifndef BL_AUTH
+// "W<addr><word>...": up to PATCH_WORDS_MAX consecutive instructions,
+// 6 hex digits each, programmed in place (Bootloader_PatchFlash)
+static void PatchCommand(const char* line)
+{
+    uint16_t length = (uint16_t)strlen(line);
+    uint8_t count = (uint8_t)((length - 7U) / 6U);
+    uint32_t* words = flashBuffer.rows[0].word;
+    BlPatchResult_t result;
+
+    if (length < 13U || (length - 7U) % 6U != 0U)
+    {
+        Bootloader_SendResponse(RSP_ERROR, "Patch args\r\n");
+        return;
+    }
+    FlushFlashBuffer();
+    for (uint8_t i = 0; i < count; i++)
+    {
+        words[i] = HexToValue(&line[7U + 6U * i], 3);
+    }
+    result = Bootloader_PatchFlash(HexToValue(&line[1], 3), words, count);
+    if (result != BL_PATCH_OK)
+    {
+        Bootloader_SendResponse(RSP_ERROR, patchErrors[result]);
+        return;
+    }
+    Bootloader_SendResponse(RSP_OK, "Patched\r\n");
+}
+
+// "E<addr>": erase the one page at 'addr'; HEX records for it follow
+static bool ErasePage(const char* line)
+{
+    uint32_t address = HexToValue(&line[1], 3);
+
+    if (strlen(line) != 7U ||
+        (address & (FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS - 1UL)) != 0U ||
+        !IsAddressInAppArea(address))
+    {
+        return false;
+    }
+    FlushFlashBuffer();
+    PROF_BEGIN(PROF_FLASH_ERASE);
+    bool erased = FLASH_ErasePage(address);
+    PROF_END(PROF_FLASH_ERASE);
+    if (erased)
+    {
+        pagesErased++;
+        blCounters.pagesErased++;
+    }
+    return erased;
+}
+
+static void DeltaClose(void)
+{
+    BL_DeltaCancel();
+    FreeFlashRows();
+}
+
+// "D<sub>": delta page update, see bl_delta.h.
+//   "DO<addr>"   open the page at 'addr'
+//   "DD<ops>"    operations, hex; whole operations per line
+//   "DC<crc>"    program the page if its CRC-32 is 'crc'
+static void DeltaCommand(const char* line)
+{
+    uint16_t length = (uint16_t)strlen(line);
+    BlDeltaResult_t result = BL_DELTA_ARGS;
+
+    if (!BL_DeltaActive())
+    {
+        FlushFlashBuffer();     // buffered rows first; the memory is the page's now
+    }
+    switch (line[1])
+    {
+        case 'O':
+            if (length == 8U)
+            {
+                result = BL_DeltaOpen(flashBuffer.deltaPage, HexToValue(&line[2], 3));
+            }
+            break;
+
+        case 'D':
+            if (length > 2U && (length & 1U) == 0U)
+            {
+                for (uint8_t i = 0; i < (length - 2U) / 2U; i++)
+                {
+                    replyBlock.deltaOps[i] = Bootloader_HexToByte(&line[2U + 2U * i]);
+                }
+                result = BL_DeltaApply(replyBlock.deltaOps, (uint8_t)((length - 2U) / 2U));
+            }
+            break;
+
+        case 'C':
+            if (length == 10U)
+            {
+                result = BL_DeltaCommit(HexToValue(&line[2], 4));
+            }
+            if (result == BL_DELTA_OK || result == BL_DELTA_UNCHANGED)
+            {
+                DeltaClose();
+                Bootloader_SendResponse(RSP_OK, (result == BL_DELTA_OK) ? "Page written\r\n"
+                                                                        : "Page unchanged\r\n");
+                return;
+            }
+            break;
+
+        default:
+            Bootloader_SendResponse(RSP_UNKNOWN, "Unknown command\r\n");
+            return;
+    }
+    if (result != BL_DELTA_OK)
+    {
+        DeltaClose();
+        Bootloader_SendResponse(RSP_ERROR, deltaErrors[result]);
+        return;
+    }
+    Bootloader_SendResponse(RSP_OK, "");
+}
+#endif // BL_AUTH
+#endif
+
 static void RequestResetToApplicationNow(void)
 {
     // Mark that we are attempting a jump. If we ever come back to the
@@ -54,6 +481,7 @@ static void RequestResetToApplicationNow(void)
     USBDeviceDetach();
     for (volatile uint32_t i = 0; i < 200000UL; i++) { ; }
 
+    BL_BootLogLeave();
     asm("RESET");
     while (1) { ; }
 }
@@ -64,11 +492,12 @@ void Bootloader_Initialize(void)
     jumpToApp = false;
     rxIndex = 0;
     extendedAddress = 0;
-    flashBufferAddress = 0xFFFFFFFF;
-    flashBufferIndex = 0;
+    FreeFlashRows();
     bytesWritten = 0;
     pagesErased = 0;
-    
+    usbRunning = true;
+    BL_StageInitialize();
+
     // Unlock flash for programming
     FLASH_Unlock(FLASH_UNLOCK_KEY);
 }
@@ -86,10 +515,9 @@ bool Bootloader_HadHostActivity(void)
 void Bootloader_ProcessCommand(void)
 {
     uint8_t numBytes;
-    uint8_t readBuffer[64];
     
     // Check if data available from USB CDC
-    numBytes = getsUSBUSART(readBuffer, sizeof(readBuffer));
+    numBytes = getsUSBUSART(usbRxPacket, sizeof(usbRxPacket));
     
     if (numBytes == 0)
     {
@@ -101,7 +529,7 @@ void Bootloader_ProcessCommand(void)
     // Process received bytes
     for (uint8_t i = 0; i < numBytes; i++)
     {
-        char c = (char)readBuffer[i];
+        char c = (char)usbRxPacket[i];
         
         // Handle line endings
         if (c == '\r' || c == '\n')
@@ -109,8 +537,11 @@ void Bootloader_ProcessCommand(void)
             if (rxIndex > 0)
             {
                 rxBuffer[rxIndex] = '\0';
+                PROF_BEGIN(PROF_COMMAND);
                 ProcessLine(rxBuffer);
+                PROF_END(PROF_COMMAND);
                 rxIndex = 0;
+                rxOverrun = false;
             }
             continue;
         }
@@ -120,6 +551,11 @@ void Bootloader_ProcessCommand(void)
         {
             rxBuffer[rxIndex++] = c;
         }
+        else if (!rxOverrun)
+        {
+            rxOverrun = true;   // count each truncated line once
+            blCounters.rxOverruns++;
+        }
     }
     
     // Process USB CDC TX
@@ -137,6 +573,12 @@ static void ProcessLine(const char* line)
 
     blLastCmd = (uint16_t)(uint8_t)cmd;
     blCmdCount++;
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+    if (cmd != CMD_DELTA && BL_DeltaActive())
+    {
+        DeltaClose();           // the row buffers are needed again
+    }
+#endif
     
     switch (cmd)
     {
@@ -145,8 +587,16 @@ static void ProcessLine(const char* line)
             break;
             
         case CMD_ERASE_FLASH:
-            // Erase application area
+            // Erase application area, or one page of it ("E<addr>", for a
+            // patch); a direct upload follows
+            BL_StageCancel();
+#if defined(BL_AUTH)
+            if (line[1] == '\0' && Bootloader_EraseAppArea())
+#elif !defined(BL_SMALL)
+            if (line[1] != '\0' ? ErasePage(line) : Bootloader_EraseAppArea())
+#else
             if (Bootloader_EraseAppArea())
+#endif
             {
                 Bootloader_SendResponse(RSP_OK, "Erased\r\n");
                 blState = BL_STATE_RECEIVING_HEX;
@@ -163,10 +613,20 @@ static void ProcessLine(const char* line)
             if (blState == BL_STATE_RECEIVING_HEX || blState == BL_STATE_IDLE)
             {
                 blState = BL_STATE_RECEIVING_HEX;
-                if (Bootloader_ParseHexLine(line))
+                PROF_BEGIN(PROF_HEX_PARSE);
+                bool parsed = Bootloader_ParseHexLine(line);
+                PROF_END(PROF_HEX_PARSE);
+                if (parsed)
                 {
                     Bootloader_SendResponse(RSP_OK, "");
                 }
+#ifdef BL_AUTH
+                else if (blState == BL_STATE_ERROR)
+                {
+                    // EOF record of an upload whose MAC does not match
+                    Bootloader_SendResponse(RSP_ERROR, "Auth failed\r\n");
+                }
+#endif
                 else
                 {
                     Bootloader_SendResponse(RSP_ERROR, "HEX error\r\n");
@@ -178,11 +638,13 @@ static void ProcessLine(const char* line)
             // Flush any remaining data and verify
             FlushFlashBuffer();
             blState = BL_STATE_COMPLETE;
-            {
-                char msg[64];
-                sprintf(msg, "OK: %lu bytes, %lu pages\r\n", bytesWritten, pagesErased);
-                Bootloader_SendResponse(RSP_OK, msg);
-            }
+            txLine[0] = RSP_OK;
+            strcpy(&txLine[1], "OK: ");
+            StrCatDec(txLine, bytesWritten);
+            strcat(txLine, " bytes, ");
+            StrCatDec(txLine, pagesErased);
+            strcat(txLine, " pages\r\n");
+            SendTxLine();
             break;
             
         case CMD_JUMP_APP:
@@ -193,10 +655,84 @@ static void ProcessLine(const char* line)
             RequestResetToApplicationNow();
             break;
             
+#ifndef BL_SMALL
+        case CMD_LINK_TEST:
+            LinkTest(line);
+            break;
+#endif
+
+        case CMD_COUNTERS:
+            BL_CountersSnapshot(&replyBlock.counters);
+            Bootloader_SendHexBlock(CMD_COUNTERS, &replyBlock.counters, sizeof(replyBlock.counters));
+            break;
+
+#ifndef BL_SMALL
+        case CMD_PROFILE:
+            BL_ProfSnapshot(&replyBlock.profile);
+            Bootloader_SendHexBlock(CMD_PROFILE, &replyBlock.profile, sizeof(replyBlock.profile));
+            break;
+#endif
+
+        case CMD_STATUS:
+            BL_StatusRead(&replyBlock.status);
+            Bootloader_SendHexBlock(CMD_STATUS, &replyBlock.status, sizeof(replyBlock.status));
+            break;
+
+#ifndef BL_SMALL
+#ifndef BL_AUTH
+        case CMD_GOLDEN:
+            GoldenCommand(line);
+            break;
+#endif
+
+        case CMD_CRC_MAP:
+            CrcMapCommand(line);
+            break;
+
+        case CMD_READ_FLASH:
+            ReadRowCommand(line);
+            break;
+#endif
+
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+        case CMD_STAGE:
+            StageCommand(line);
+            break;
+
+        case CMD_WRITE_FLASH:
+            BL_StageCancel();
+            PatchCommand(line);
+            break;
+
+        case CMD_DELTA:
+            BL_StageCancel();
+            DeltaCommand(line);
+            break;
+#endif
+
+        case CMD_BOOT_LOG:
+            Bootloader_SendHexBlock(CMD_BOOT_LOG, &blBootLog, sizeof(blBootLog));
+            break;
+
+        case CMD_COUNTERS_CLEAR:
+            BL_CountersClear();
+            BL_ProfClear();
+            Bootloader_SendResponse(RSP_OK, "Counters cleared\r\n");
+            break;
+
+#ifdef BL_BENCH
+        case CMD_BENCH:
+            // Erases and reprograms the application area.
+            BL_BenchRun(BenchPrint);
+            Bootloader_SendResponse(RSP_OK, "Bench done\r\n");
+            break;
+#endif
+
         case CMD_RESET:
             // Reset device
             Bootloader_SendResponse(RSP_OK, "Resetting...\r\n");
             Bootloader_DelayMs(100);
+            BL_BootLogLeave();
             asm("RESET");
             break;
             
@@ -213,50 +749,94 @@ bool Bootloader_ShouldJumpToApp(void)
 
 void Bootloader_SendResponse(char code, const char* message)
 {
-    char response[80];
-    
-    if (message[0] != '\0')
-    {
-        sprintf(response, "%c%s", code, message);
-    }
-    else
+    txLine[0] = code;
+    strcpy(&txLine[1], (message[0] != '\0') ? message : "\r\n");
+    SendTxLine();
+}
+
+// Send the NUL-terminated line in txLine.
+static void SendTxLine(void)
+{
+    // Wait for USB to be ready
+    PROF_BEGIN(PROF_CDC_TX);
+    if (!USBUSARTIsTxTrfReady())
     {
-        sprintf(response, "%c\r\n", code);
+        blCounters.txStalls++;
     }
-    
-    // Wait for USB to be ready
     while (!USBUSARTIsTxTrfReady())
     {
         CDCTxService();
     }
     
-    putsUSBUSART(response);
+    putsUSBUSART(txLine);
     CDCTxService();
+    PROF_END(PROF_CDC_TX);
 }
 
 void Bootloader_SendVersion(void)
 {
-    char msg[128];
-    // Single-line response so readline() gets all diagnostics.
-    sprintf(
-        msg,
-        "%s SJ=%u JR=%u SR=%u BR=%04X AL=%04X AT=%u AS=%u\r\n",
-        VERSION_STRING,
-        (unsigned)blStubToAppCount,
-        (unsigned)blJumpReturnCount,
-        (unsigned)blSawResetStubMagic,
-        (unsigned)blLastRcon,
-        (unsigned)appLastRcon,
-        (unsigned)appTrapCode,
-        (unsigned)appStage
-    );
+    // Identification only; diagnostics are in the 'S' status record.
+    strcpy(txLine, VERSION_STRING " SN=");
+    strcat(txLine, BL_SerialString());
+    strcat(txLine, "\r\n");
+    SendTxLine();
+}
 
-    while (!USBUSARTIsTxTrfReady())
+// Append 'value' in decimal to the string at 's'. Replaces sprintf("%lu"),
+// which pulls the whole printf engine into the image.
+static void StrCatDec(char* s, uint32_t value)
+{
+    char digits[11];
+    uint8_t n = sizeof(digits) - 1U;
+
+    digits[n] = '\0';
+    do
     {
-        CDCTxService();
+        digits[--n] = (char)('0' + (value % 10U));
+        value /= 10U;
+    } while (value != 0U);
+    strcat(s, &digits[n]);
+}
+
+// Binary data as one text line, "+<tag><hex bytes>\r\n", so the host can
+// keep using readline(). Sent in packet-sized pieces; no length limit.
+void Bootloader_SendHexBlock(char tag, const void* data, uint16_t length)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    const uint8_t* bytes = (const uint8_t*)data;
+    char packet[64];
+    uint8_t n = 0;
+
+    packet[n++] = RSP_OK;
+    packet[n++] = tag;
+    for (uint16_t i = 0; i <= length; i++)
+    {
+        if (i == length)
+        {
+            packet[n++] = '\r';
+            packet[n++] = '\n';
+        }
+        else
+        {
+            packet[n++] = hexDigits[bytes[i] >> 4];
+            packet[n++] = hexDigits[bytes[i] & 0x0F];
+        }
+
+        if (n > sizeof(packet) - 2U || i == length)
+        {
+            if (!USBUSARTIsTxTrfReady())
+            {
+                blCounters.txStalls++;
+            }
+            while (!USBUSARTIsTxTrfReady())
+            {
+                CDCTxService();
+            }
+            putUSBUSART((uint8_t*)packet, n);
+            CDCTxService();
+            n = 0;
+        }
     }
-    putsUSBUSART(msg);
-    CDCTxService();
 }
 
 bool Bootloader_EraseAppArea(void)
@@ -264,6 +844,7 @@ bool Bootloader_EraseAppArea(void)
     uint32_t address;
     
     pagesErased = 0;
+    bytesWritten = 0;
     
     // Erase IVT/AIVT area first (for app's interrupt vectors)
     // Page containing 0x0000-0x01FF (but skip address 0 - reset vector points to bootloader)
@@ -276,45 +857,158 @@ bool Bootloader_EraseAppArea(void)
     for (address = APP_START_ADDRESS; address < APP_END_ADDRESS; 
          address += FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS)
     {
-        if (!FLASH_ErasePage(address))
+        if (IS_APP_DATA_ADDRESS(address))
+        {
+            continue;   // the application's own data stays
+        }
+
+        // A blank check costs ~1 ms of TBLRDs, an erase ~20 ms of stall
+        PROF_BEGIN(PROF_FLASH_BLANK);
+        bool blank = IsPageBlank(address);
+        PROF_END(PROF_FLASH_BLANK);
+        if (blank)
+        {
+            blCounters.pagesSkipped++;
+            continue;
+        }
+
+        PROF_BEGIN(PROF_FLASH_ERASE);
+        bool erased = FLASH_ErasePage(address);
+        PROF_END(PROF_FLASH_ERASE);
+        if (!erased)
         {
             return false;
         }
         pagesErased++;
+        blCounters.pagesErased++;
         
         // Keep USB alive during erase
-        USBDeviceTasks();
+        if (usbRunning)
+        {
+            PROF_BEGIN(PROF_USB_TASKS);
+            USBDeviceTasks();
+            PROF_END(PROF_USB_TASKS);
+        }
     }
+#ifdef BL_AUTH
+    BL_AuthBegin();     // the rows that follow must be signed
+#endif
     
     return true;
 }
 
+static bool IsPageBlank(uint32_t address)
+{
+    for (uint16_t i = 0; i < FLASH_ERASE_PAGE_SIZE_IN_PC_UNITS; i += 2)
+    {
+        if (FLASH_ReadWord24(address + i) != 0x00FFFFFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 static bool IsAddressInAppArea(uint32_t address)
 {
     // Only allow writes to application code area (0x4000+)
     // Do NOT allow writes to IVT at 0x0004 - bootloader handles that via remapping
-    return (address >= APP_START_ADDRESS && address <= APP_END_ADDRESS);
+    // Nor to the preserved application data (bl_shared.h)
+    return (address >= APP_START_ADDRESS && address <= APP_END_ADDRESS &&
+            !IS_APP_DATA_ADDRESS(address));
 }
 
+// Write every buffered row, oldest first.
 static void FlushFlashBuffer(void)
 {
-    if (flashBufferIndex > 0 && flashBufferAddress != 0xFFFFFFFF)
+    for (uint8_t n = 0; n < FLASH_ROW_BUFFERS; n++)
     {
-        // Pad remaining buffer with 0xFF
-        while (flashBufferIndex < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS)
-        {
-            flashBuffer[flashBufferIndex++] = 0x00FFFFFF;
-        }
-        
-        // Write the row
-        if (IsAddressInAppArea(flashBufferAddress))
+        WriteFlashRow(&flashBuffer.rows[flashRowNext]);
+        flashRowNext = (flashRowNext + 1U) % FLASH_ROW_BUFFERS;
+    }
+}
+
+// Mark every row buffer unused, e.g. after the memory held a delta page.
+static void FreeFlashRows(void)
+{
+    for (uint8_t r = 0; r < FLASH_ROW_BUFFERS; r++)
+    {
+        flashBuffer.rows[r].address = ROW_FREE;
+    }
+    flashRowNext = 0;
+}
+
+static void WriteFlashRow(FlashRow_t* row)
+{
+    if (row->address == ROW_FREE)
+    {
+        return;
+    }
+
+    // Unwritten words are still 0xFFFFFF from ClearFlashBuffer
+    if (IsAddressInAppArea(row->address) && BL_StageActive())
+    {
+        BL_StageWriteRow(row->address, row->word);
+    }
+#ifdef BL_AUTH
+    else if (IsAddressInAppArea(row->address) && BL_AuthRow(row->address, row->word))
+#else
+    else if (IsAddressInAppArea(row->address))
+#endif
+    {
+        BL_BENCH_BEGIN(t0);
+        PROF_BEGIN(PROF_FLASH_WRITE_ROW);
+        FLASH_WriteRow24(row->address, row->word);
+        PROF_END(PROF_FLASH_WRITE_ROW);
+        BL_BENCH_END(t0, flushTicks, flushes);
+        blCounters.rowsWritten++;
+    }
+
+    row->address = ROW_FREE;
+}
+
+// Buffer for 'rowAddress': the one already holding it, else a free one, else
+// the oldest after writing it out.
+static FlashRow_t* GetFlashRow(uint32_t rowAddress)
+{
+    FlashRow_t* row;
+
+    for (uint8_t r = 0; r < FLASH_ROW_BUFFERS; r++)
+    {
+        if (flashBuffer.rows[r].address == rowAddress)
         {
-            FLASH_WriteRow24(flashBufferAddress, flashBuffer);
+            return &flashBuffer.rows[r];
         }
-        
-        flashBufferIndex = 0;
-        flashBufferAddress = 0xFFFFFFFF;
     }
+
+    row = &flashBuffer.rows[flashRowNext];
+    for (uint8_t n = 0; n < FLASH_ROW_BUFFERS && row->address != ROW_FREE; n++)
+    {
+        flashRowNext = (flashRowNext + 1U) % FLASH_ROW_BUFFERS;
+        row = &flashBuffer.rows[flashRowNext];
+    }
+    if (row->address != ROW_FREE)
+    {
+        WriteFlashRow(row);
+    }
+    flashRowNext = (flashRowNext + 1U) % FLASH_ROW_BUFFERS;
+
+    row->address = rowAddress;
+    ClearFlashBuffer(row->word);
+    return row;
+}
+
+static void ClearFlashBuffer(uint32_t* words)
+{
+    BL_BENCH_BEGIN(t0);
+
+    // Initialize buffer with 0xFF
+    for (int j = 0; j < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; j++)
+    {
+        words[j] = 0x00FFFFFF;
+    }
+
+    BL_BENCH_END(t0, rowInitTicks, rowInits);
 }
 
 uint8_t Bootloader_HexToByte(const char* hex)
@@ -358,6 +1052,10 @@ bool Bootloader_ParseHexLine(const char* line)
     }
     
     uint8_t byteCount = Bootloader_HexToByte(&line[1]);
+    if (byteCount > HEX_RECORD_MAX_BYTES)
+    {
+        return false;   // cannot have fit the line buffer; also bounds data[]
+    }
     uint16_t address = (Bootloader_HexToByte(&line[3]) << 8) | Bootloader_HexToByte(&line[5]);
     uint8_t recordType = Bootloader_HexToByte(&line[7]);
     
@@ -365,7 +1063,7 @@ bool Bootloader_ParseHexLine(const char* line)
     uint8_t checksum = byteCount + (address >> 8) + (address & 0xFF) + recordType;
     
     // Parse data bytes
-    uint8_t data[64];
+    uint8_t data[HEX_RECORD_MAX_BYTES];
     for (uint8_t i = 0; i < byteCount; i++)
     {
         data[i] = Bootloader_HexToByte(&line[9 + i * 2]);
@@ -376,8 +1074,10 @@ bool Bootloader_ParseHexLine(const char* line)
     uint8_t expectedChecksum = Bootloader_HexToByte(&line[9 + byteCount * 2]);
     checksum = (~checksum) + 1;  // Two's complement
     
+    blCounters.recordsParsed++;
     if (checksum != expectedChecksum)
     {
+        blCounters.checksumErrors++;
         return false;  // Checksum error
     }
     
@@ -395,12 +1095,21 @@ bool Bootloader_ParseHexLine(const char* line)
             // Convert byte address to PC address
             uint32_t pcAddress = fullAddress / 2;
             
+#ifdef BL_AUTH
+            if (BL_AuthMacRecord(fullAddress, data, byteCount))
+            {
+                return true;
+            }
+#endif
+
             // Only program if in application area
             if (!IsAddressInAppArea(pcAddress))
             {
                 return true;  // Skip but don't error
             }
             
+            FlashRow_t* row = NULL;
+
             // Process data - PIC24 instructions are 24-bit (3 bytes in HEX = phantom + instruction)
             // HEX file format for PIC24: each instruction is 4 bytes (little endian, upper byte = 0)
             for (uint8_t i = 0; i < byteCount; i += 4)
@@ -419,29 +1128,17 @@ bool Bootloader_ParseHexLine(const char* line)
                     // Align to row boundary
                     uint32_t rowAddress = wordAddr & ~(FLASH_WRITE_ROW_SIZE_IN_PC_UNITS - 1);
                     
-                    // Check if we need to flush and start new row
-                    if (flashBufferAddress != rowAddress)
+                    // Same row as the previous word in the common case
+                    if (row == NULL || row->address != rowAddress)
                     {
-                        FlushFlashBuffer();
-                        flashBufferAddress = rowAddress;
-                        flashBufferIndex = 0;
-                        
-                        // Initialize buffer with 0xFF
-                        for (int j = 0; j < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS; j++)
-                        {
-                            flashBuffer[j] = 0x00FFFFFF;
-                        }
+                        row = GetFlashRow(rowAddress);
                     }
                     
                     // Calculate index within row
                     uint16_t rowIndex = (wordAddr - rowAddress) / 2;
                     if (rowIndex < FLASH_WRITE_ROW_SIZE_IN_INSTRUCTIONS)
                     {
-                        flashBuffer[rowIndex] = instruction;
-                        if (rowIndex >= flashBufferIndex)
-                        {
-                            flashBufferIndex = rowIndex + 1;
-                        }
+                        row->word[rowIndex] = instruction;
                         bytesWritten += 3;
                     }
                 }
@@ -452,6 +1149,14 @@ bool Bootloader_ParseHexLine(const char* line)
         case HEX_EOF_RECORD:
             // End of file - flush buffer
             FlushFlashBuffer();
+#ifdef BL_AUTH
+            // The digest is complete; the reset vector row goes in if it matches
+            if (!BL_AuthFinish())
+            {
+                blState = BL_STATE_ERROR;
+                return false;
+            }
+#endif
             blState = BL_STATE_COMPLETE;
             break;
             
@@ -483,47 +1188,43 @@ bool Bootloader_ParseHexLine(const char* line)
     return true;
 }
 
-bool Bootloader_WriteFlash(uint32_t address, uint8_t* data, uint16_t length)
+#ifndef BL_SMALL
+BlPatchResult_t Bootloader_PatchFlash(uint32_t address, const uint32_t* words, uint8_t count)
 {
-    // This function writes raw data to flash
-    // Used for direct programming without HEX parsing
-    
-    if (!IsAddressInAppArea(address))
+    uint32_t old;
+
+    if ((address & 1UL) != 0U)
     {
-        return false;
+        return BL_PATCH_RANGE;
     }
-    
-    // Write word by word
-    for (uint16_t i = 0; i < length; i += 4)
+    for (uint8_t i = 0; i < count; i++)
     {
-        uint32_t word = data[i] | 
-                       ((uint32_t)data[i + 1] << 8) | 
-                       ((uint32_t)data[i + 2] << 16);
-        
-        if (!FLASH_WriteWord24(address + i, word))
+        if (!IsAddressInAppArea(address + 2U * i))
         {
-            return false;
+            return BL_PATCH_RANGE;
+        }
+        old = FLASH_ReadWord24(address + 2U * i) & ERASED_WORD;
+        if ((words[i] & ~old & ERASED_WORD) != 0U)
+        {
+            return BL_PATCH_SETS_BITS;
         }
     }
-    
-    return true;
-}
 
-bool Bootloader_VerifyFlash(uint32_t address, uint8_t* data, uint16_t length)
-{
-    for (uint16_t i = 0; i < length; i += 4)
+    for (uint8_t i = 0; i < count; i++)
     {
-        uint32_t expected = data[i] | 
-                           ((uint32_t)data[i + 1] << 8) | 
-                           ((uint32_t)data[i + 2] << 16);
-        
-        uint32_t actual = FLASH_ReadWord24(address + i);
-        
-        if (actual != expected)
+        if ((FLASH_ReadWord24(address + 2U * i) & ERASED_WORD) == words[i])
         {
-            return false;
+            continue;
         }
+        PROF_BEGIN(PROF_FLASH_WRITE_WORD);
+        bool written = FLASH_WriteWord24(address + 2U * i, words[i]);
+        PROF_END(PROF_FLASH_WRITE_WORD);
+        if (!written || (FLASH_ReadWord24(address + 2U * i) & ERASED_WORD) != words[i])
+        {
+            return BL_PATCH_FLASH_ERROR;
+        }
+        blCounters.wordsWritten++;
     }
-    
-    return true;
+    return BL_PATCH_OK;
 }
+#endif
@@ -10,16 +10,32 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "mcc_generated_files/memory/flash.h"
+#include "bl_shared.h"
+
+// Bootloader version, reported by 'V' and in the 'S' status record
+#define BL_VERSION_MAJOR    1
+#define BL_VERSION_MINOR    2
 
 // Bootloader commands (received via USB CDC)
 #define CMD_READ_VERSION    'V'     // Read bootloader version
-#define CMD_READ_FLASH      'R'     // Read flash memory
-#define CMD_WRITE_FLASH     'W'     // Write flash memory
-#define CMD_ERASE_FLASH     'E'     // Erase flash page
+#define CMD_READ_FLASH      'R'     // Read one application row
+#define CMD_WRITE_FLASH     'W'     // Patch instructions in place (1->0 only)
+#define CMD_ERASE_FLASH     'E'     // Erase application area, or one page of it
+#define CMD_CRC_MAP         'M'     // CRC-32 of each of a run of application rows
+#define CMD_DELTA           'D'     // Rebuild a page from flash and host data (see bl_delta.h)
 #define CMD_VERIFY          'C'     // Verify checksum
 #define CMD_JUMP_APP        'J'     // Jump to application
 #define CMD_RESET           'X'     // Reset device
 #define CMD_HEX_RECORD      ':'     // Intel HEX record
+#define CMD_BENCH           'B'     // Run parser benchmark (BL_BENCH builds only)
+#define CMD_LINK_TEST       'L'     // Raw CDC throughput test (see bl_link.h)
+#define CMD_COUNTERS        'K'     // Read performance counters (see bl_counters.h)
+#define CMD_COUNTERS_CLEAR  'Z'     // Clear performance counters and profiler
+#define CMD_PROFILE         'P'     // Read section profiler table (see bl_prof.h)
+#define CMD_BOOT_LOG        'H'     // Read boot event log (see bl_bootlog.h)
+#define CMD_STATUS          'S'     // Read binary status record (see bl_status.h)
+#define CMD_STAGE           'T'     // External staging store (see bl_stage.h)
+#define CMD_GOLDEN          'G'     // Golden image save/restore (see bl_golden.h)
 
 // Response codes
 #define RSP_OK              '+'
@@ -30,13 +46,30 @@
 // IVT area (0x0004-0x01FF) is also writable for app's interrupt vectors
 #define IVT_START_ADDRESS       0x0004UL    // Hardware IVT location
 #define IVT_END_ADDRESS         0x01FFUL    // End of AIVT
-#define APP_START_ADDRESS       0x4000UL    // Application code starts after bootloader
+#define APP_START_ADDRESS       ((uint32_t)BL_APP_START)    // Application code starts after bootloader
 #define APP_END_ADDRESS         0xABFEUL    // Leave space for config
-#define BOOTLOADER_END_ADDRESS  0x3FFFUL
+#define BOOTLOADER_END_ADDRESS  (APP_START_ADDRESS - 1UL)
+// Preserved application data (bl_shared.h), inside the area above
+#define APP_DATA_START_ADDRESS  ((uint32_t)BL_APP_DATA_START)
+#define IS_APP_DATA_ADDRESS(a)  (((uint32_t)(a) - APP_DATA_START_ADDRESS) < BL_APP_DATA_SIZE)
 
 // Buffer sizes
 #define RX_BUFFER_SIZE      128
+// Longest HEX data field accepted: whole instructions whose record line
+// (":LLAAAATT" + 2 per byte + "CC") still fits RX_BUFFER_SIZE.
+#define HEX_RECORD_MAX_BYTES    ((((RX_BUFFER_SIZE - 1) - 11) / 2) & ~3)
+// HEX records a host may send before reading their replies. USB flow control
+// stalls the host while a record is parsed and programmed.
+#define HEX_WINDOW_DEPTH    8
 #define HEX_LINE_MAX        80
+// Response lines (code + text + CRLF + NUL), built in one static buffer. One
+// CDC IN packet at most, so the line is copied to the endpoint buffer before
+// it is sent and the buffer can be reused right away.
+#define TX_LINE_SIZE        64
+// Rows assembled in RAM at once. Records for a buffered row merge into it, so
+// records that alternate between rows cost one row write per row, not one per
+// switch. The oldest row is written out when a new one is needed.
+#define FLASH_ROW_BUFFERS   4
 
 // Bootloader state
 typedef enum {
@@ -70,6 +103,12 @@ extern volatile uint16_t blRconAtEntry;
 // Reset-stub entry marker (see main.c/reset_stub.s).
 extern volatile uint16_t blSawResetStubMagic;
 
+// Boot handoff descriptor published to the application (see bl_shared.h).
+extern volatile BlHandoff_t blHandoff;
+
+// App -> bootloader entry request mailbox (BL_ENTRY_REQUEST_ADDRESS).
+extern volatile uint16_t blEntryRequest;
+
 // Counts how many times the reset stub actually took the jump-to-app path.
 extern volatile uint16_t blStubToAppCount;
 
@@ -103,11 +142,34 @@ void Bootloader_ClearHostActivity(void);
 bool Bootloader_HadHostActivity(void);
 void Bootloader_SendResponse(char code, const char* message);
 void Bootloader_SendVersion(void);
+void Bootloader_SendHexBlock(char tag, const void* data, uint16_t length);
+
+// In-place patch of single instructions (Bootloader_PatchFlash)
+typedef enum {
+    BL_PATCH_OK,
+    BL_PATCH_RANGE,         // outside the application area, or in its preserved data
+    BL_PATCH_SETS_BITS,     // a word needs a 0 bit back to 1: erase the page instead
+    BL_PATCH_FLASH_ERROR    // write failed or reads back wrong
+} BlPatchResult_t;
+
+// Longest "W" line: address and then 6 hex digits per instruction
+#define PATCH_WORDS_MAX     ((RX_BUFFER_SIZE - 1 - 7) / 6)
 
 // Flash programming functions
 bool Bootloader_EraseAppArea(void);
-bool Bootloader_WriteFlash(uint32_t address, uint8_t* data, uint16_t length);
-bool Bootloader_VerifyFlash(uint32_t address, uint8_t* data, uint16_t length);
+// Program 'count' consecutive instructions from 'address' without an erase.
+// Nothing is written unless every one only clears bits of what flash holds.
+// Not in BL_SMALL builds.
+BlPatchResult_t Bootloader_PatchFlash(uint32_t address, const uint32_t* words, uint8_t count);
+
+// Put the golden image back (bl_golden.h) using the idle row buffers; for
+// main() before the application is started. Not in BL_SMALL or BL_AUTH
+// builds.
+bool Bootloader_RestoreGolden(void);
+
+// Install the image the application staged (bl_ota.h), same conditions.
+// The outcome is in BL_INSTALL_REPORT; true if the image is installed.
+bool Bootloader_InstallStaged(void);
 
 // Intel HEX parsing
 bool Bootloader_ParseHexLine(const char* line);
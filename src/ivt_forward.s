@@ -2,19 +2,28 @@
  * IVT Forwarder Stubs for PIC24FJ64GB002 bootloader.
  *
  * When blVectorToApp = 0 (bootloader mode): dispatch to bootloader handlers
- * When blVectorToApp = 1 (app mode): forward to application's IVT at 0x4004
+ * When blVectorToApp = 1 (app mode): forward to application's IVT
  *
- * Application IVT is at 0x4004 (APP_IVT_BASE).
+ * Application IVT is at BL_APP_START + 4 (APP_IVT_BASE, see src/bl_shared.h):
+ * 0x4004, or 0x2004 when assembled with --defsym BL_SMALL=1 (build.ps1 -Small).
  * Each vector entry is 2 instruction words (4 bytes in program memory address space).
  * Vector n is at: APP_IVT_BASE + (n * 2) in PC address units.
  */
 
-    .equ APP_IVT_BASE,   0x4004
-    .equ APP_AIVT_BASE,  0x4204
+.ifdef BL_SMALL
+    .equ APP_START,      0x2000
+.else
+    .equ APP_START,      0x4000
+.endif
+    .equ APP_IVT_BASE,   APP_START + 0x004
+    .equ APP_AIVT_BASE,  APP_START + 0x204
 
     ; External references
     .extern _blVectorToApp
     .extern __USB1Interrupt
+.ifndef BL_SMALL
+    .extern __SPI1Interrupt
+.endif
 
     .section .text
 
@@ -78,6 +87,17 @@ __bl_fwd_ivt_15:
     goto    APP_IVT_BASE + (15 * 2)
     goto    __bl_default_isr
 
+; Vector 18: SPI1 (bootloader async transfers, src/bl_spi.c; app may use it too)
+    .global __bl_fwd_ivt_18
+__bl_fwd_ivt_18:
+    btsc    _blVectorToApp, #0
+    goto    APP_IVT_BASE + (18 * 2)
+.ifdef BL_SMALL
+    goto    __bl_default_isr           ; bl_spi.c is not in the 8KB image
+.else
+    goto    __SPI1Interrupt
+.endif
+
 ; Vector 28: INT1 (app uses this for LoRa DIO0)
     .global __bl_fwd_ivt_28
 __bl_fwd_ivt_28:
@@ -138,6 +158,17 @@ __bl_fwd_aivt_15:
     goto    APP_AIVT_BASE + (15 * 2)
     goto    __bl_default_isr
 
+; AIVT Vector 18
+    .global __bl_fwd_aivt_18
+__bl_fwd_aivt_18:
+    btsc    _blVectorToApp, #0
+    goto    APP_AIVT_BASE + (18 * 2)
+.ifdef BL_SMALL
+    goto    __bl_default_isr
+.else
+    goto    __SPI1Interrupt
+.endif
+
 ; AIVT Vector 28
     .global __bl_fwd_aivt_28
 __bl_fwd_aivt_28:
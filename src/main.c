@@ -9,9 +9,16 @@
 #include "mcc_generated_files/usb/usb.h"
 #include "mcc_generated_files/tmr1.h"
 #include "bootloader.h"
+#include "bl_timebase.h"
+#include "bl_serial.h"
+#include "bl_counters.h"
+#include "bl_bootlog.h"
+#include "bl_stack.h"
+#include "bl_stage.h"
+#include "bl_golden.h"
+#include "bl_ota.h"
 #include <string.h>
 
-#define APP_START_ADDRESS       0x4000UL    // Application starts after bootloader
 #define APP_RESET_ADDRESS       (APP_START_ADDRESS)
 
 // Handoff + diagnostics: must survive RESET, but must NOT live in USB BDT RAM.
@@ -35,6 +42,14 @@ volatile uint16_t blSawResetStubMagic __attribute__((persistent, section(".bl_pe
 
 volatile uint16_t blStubToAppCount __attribute__((persistent, section(".bl_persist")));
 
+// Boot handoff descriptor for the application. Pinned to the start of
+// .bl_persist (BL_HANDOFF_ADDRESS) by the linker script.
+volatile BlHandoff_t blHandoff __attribute__((persistent, section(".bl_handoff")));
+
+// Entry request written by the application (see BL_CdcLineCodingTouch).
+// Pinned to BL_ENTRY_REQUEST_ADDRESS by the linker script.
+volatile uint16_t blEntryRequest __attribute__((persistent, section(".bl_request")));
+
 // Runtime flag used by the IVT trampoline:
 // 0 = bootloader is active (handle bootloader USB/ISRs)
 // 1 = application is running (forward vectors to relocated app IVT/AIVT)
@@ -64,6 +79,27 @@ static bool IsValidApplication(void)
     return !(resetVector == 0xFFFFFF || resetVector == 0x000000);
 }
 
+// Describe what is already initialized so the app can skip it. Must be the
+// last thing before control leaves the bootloader.
+static void PublishHandoff(void)
+{
+    uint16_t flags = BL_HANDOFF_CLOCK | BL_HANDOFF_PMD | BL_HANDOFF_DIGITAL_IO |
+                     BL_HANDOFF_RESET_CAUSE;
+
+    if (OSCCONbits.LOCK)
+    {
+        flags |= BL_HANDOFF_PLL_LOCK;
+    }
+
+    blHandoff.version = BL_HANDOFF_VERSION;
+    blHandoff.size = sizeof(BlHandoff_t);
+    blHandoff.flags = flags;
+    blHandoff.rcon = blLastRcon;
+    blHandoff.osccon = OSCCON;
+    blHandoff.magic = BL_HANDOFF_MAGIC;
+    blHandoff.check = BL_HandoffCheck(&blHandoff);
+}
+
 static void JumpToApplication(void)
 {
     __builtin_disi(0x3FFF);  // Disable interrupts
@@ -75,7 +111,8 @@ static void JumpToApplication(void)
     
     // Disable peripherals
     T1CONbits.TON = 0;
-    T2CONbits.TON = 0;
+    BL_BootLogLeave();
+    BL_TimebaseStop();
     SPI1STATbits.SPIEN = 0;
     U1CONbits.USBEN = 0;  // Disable USB module
     
@@ -83,19 +120,22 @@ static void JumpToApplication(void)
     IFS0 = 0; IFS1 = 0; IFS2 = 0; IFS3 = 0; IFS4 = 0; IFS5 = 0;
     IEC0 = 0; IEC1 = 0; IEC2 = 0; IEC3 = 0; IEC4 = 0; IEC5 = 0;
     
-    // Use primary IVT (not alternate) - app expects interrupts via IVT at 0x4004
+    // Use primary IVT (not alternate) - app expects interrupts via IVT at BL_APP_START + 4
     INTCON2bits.ALTIVT = 0;
     
     // Set flag so ISRs forward to app vectors
     blVectorToApp = 1;
+
+    PublishHandoff();
     
     // Jump to application reset vector using assembly GOTO
-    asm("goto 0x4000");
+    asm("goto " BL_STR(BL_APP_START));
 }
 
 static void ResetToApplication(void)
 {
     blJumpMagic = BL_JUMP_MAGIC_VALUE;
+    BL_BootLogLeave();
     asm("RESET");
 }
 
@@ -142,6 +182,32 @@ int main(void)
 {
     // Bootloader mode - IVT forwards to bootloader ISRs
     blVectorToApp = 0;
+
+    // Cycle timebase from C entry, so the boot log sees the whole stay
+    BL_TimebaseStart();
+
+    // Any handoff descriptor in RAM belongs to a previous boot.
+    blHandoff.magic = 0;
+
+    // Capture reset cause for diagnostics and the app handoff.
+    blRconAtEntry = RCON;
+    blLastRcon = blRconAtEntry;
+
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+    // How the last application start ended (bl_golden.h). The failure flags
+    // are sticky: clear them so each failed boot counts once. The
+    // application still gets them through the handoff's rcon.
+    bool goldenDue = BL_GoldenBootCheck(blRconAtEntry);
+    RCON &= ~BL_GOLDEN_FAILED_RESETS;
+#endif
+
+    // Consume an application entry request (CDC touch, staged install)
+    // exactly once.
+    bool stayInBootloader = (blEntryRequest == BL_ENTRY_REQUEST_MAGIC);
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+    bool installRequested = (blEntryRequest == BL_INSTALL_REQUEST_MAGIC);
+#endif
+    blEntryRequest = 0;
     
     // All pins digital first
     AD1PCFG = 0xFFFF;
@@ -153,7 +219,11 @@ int main(void)
     LATBbits.LATB14 = 0;
     
     // Check if we should jump to app (set by previous 'J' command before reset)
-    if (blJumpMagic == BL_JUMP_MAGIC_VALUE)
+    if (stayInBootloader)
+    {
+        blJumpMagic = 0;
+    }
+    else if (blJumpMagic == BL_JUMP_MAGIC_VALUE)
     {
         blJumpMagic = 0;  // Clear so we don't loop
         
@@ -163,18 +233,62 @@ int main(void)
         if (IsValidApplication())
         {
             blStubToAppCount++;
+            BL_BootLogBegin(BL_BOOT_PATH_JUMP, blRconAtEntry, appStage);
+            BL_GoldenLaunch();
             JumpToApplication();
         }
     }
     
     // On normal power cycle: if valid app exists, jump to it immediately
     CLOCK_Initialize();
-    if (IsValidApplication())
+#if !defined(BL_SMALL) && !defined(BL_AUTH)
+    if (installRequested)
+    {
+        // The application staged an image (bl_ota.h). Whatever the outcome,
+        // start what is in flash now; the report tells the application.
+        PIN_MANAGER_Initialize();       // NOR chip select
+        BL_StageInitialize();
+        Bootloader_InstallStaged();
+        BL_BootLogBegin(BL_BOOT_PATH_INSTALL, blRconAtEntry, appStage);
+        ResetToApplication();
+    }
+    if (!stayInBootloader && goldenDue)
+    {
+        // The application failed BL_GOLDEN_FAIL_LIMIT boots in a row: put
+        // the golden image back and start it through the 'J' path. If there
+        // is none, start what is there as before.
+        PIN_MANAGER_Initialize();       // NOR chip select
+        BL_StageInitialize();
+        if (Bootloader_RestoreGolden())
+        {
+            BL_BootLogBegin(BL_BOOT_PATH_GOLDEN, blRconAtEntry, appStage);
+            ResetToApplication();
+        }
+    }
+#endif
+    if (!stayInBootloader && IsValidApplication())
     {
         blStubToAppCount++;
+        BL_BootLogBegin(BL_BOOT_PATH_APP, blRconAtEntry, appStage);
+        BL_GoldenLaunch();
+        BL_BootLogLeave();
+        BL_TimebaseStop();
         blVectorToApp = 1;
-        asm("goto 0x4000");
+        PublishHandoff();
+        asm("goto " BL_STR(BL_APP_START));
     }
+
+    BL_BootLogBegin(stayInBootloader ? BL_BOOT_PATH_REQUEST : BL_BOOT_PATH_NO_APP,
+                    blRconAtEntry, appStage);
+
+    // iSerialNumber must be ready before enumeration. A first boot seeds
+    // the serial number from the power-up SRAM below SPLIM, so this comes
+    // before the stack paint overwrites it.
+    BL_SerialInitialize();
+
+    // Staying resident: paint the stack for the 'S' high-water mark. Not on
+    // the app paths above, they are timed. Interrupts are still off.
+    BL_StackPaint();
     
     // Initialize only what we need for USB CDC bootloader
     // Skip SPI1, TMR2, EXT_INT, TMR1 - they cause crashes with BOOTLOADER macro
@@ -195,6 +309,7 @@ int main(void)
     
     while(1)
     {
+        blCounters.mainLoops++;
         usbState = USBGetDeviceState();
         
         if (usbState >= CONFIGURED_STATE)
@@ -0,0 +1,356 @@
+#!/usr/bin/env python3
+"""
+PIC24 USB Bootloader Flashing Daemon
+
+Resident service for hardware-in-the-loop CI: owns every bootloader port,
+keeps them open between jobs, caches parsed HEX images by SHA-256 and runs
+flash/verify/jump jobs submitted over a local TCP socket, one queue per port
+ordered by priority.
+
+Usage:
+    python bl_daemon.py serve [--listen 127.0.0.1:5757]
+    python bl_daemon.py flash app.hex [--port COM5] [--priority 10] [--no-verify] [--no-jump]
+                              [--mode auto] [--strip-data]
+    python bl_daemon.py verify|jump|reset|version [--port COM5]
+    python bl_daemon.py status
+
+Wire protocol: one JSON object per line. The client sends a request, e.g.
+    {"op": "flash", "hex": "/abs/app.hex", "port": null, "priority": 0,
+     "verify": true, "jump": true, "mode": "auto", "strip": false}
+and receives {"job": n, "state": "queued", "port": ...} followed by the
+final {"job": n, "ok": true|false, "result": ..., "elapsed_s": ...}.
+"""
+
+import argparse
+import hashlib
+import itertools
+import json
+import queue
+import socket
+import socketserver
+import sys
+import threading
+import time
+from pathlib import Path
+
+import serial
+
+from upload_firmware import (UPLOAD_MODES, BootloaderUploader, PreparedImage, find_bootloader_ports,
+                             parse_hex_lines, send_image)
+
+DEFAULT_LISTEN = "127.0.0.1:5757"
+RESCAN_INTERVAL_S = 2.0
+REOPEN_TIMEOUT_S = 5.0
+
+JOB_OPS = ("flash", "verify", "jump", "reset", "version")
+
+
+class ImageCache:
+    """Prepared HEX images keyed by the SHA-256 of the file contents."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._images: dict[str, PreparedImage] = {}
+
+    def get(self, path: Path) -> tuple[str, PreparedImage]:
+        data = path.read_bytes()
+        digest = hashlib.sha256(data).hexdigest()
+        with self._lock:
+            prepared = self._images.get(digest)
+            if prepared is None:
+                records = parse_hex_lines(data.decode('ascii', errors='replace').splitlines(), path)
+                if not records:
+                    raise ValueError(f"no valid records in {path}")
+                prepared = PreparedImage(records)
+                self._images[digest] = prepared
+        return digest, prepared
+
+    def __len__(self):
+        with self._lock:
+            return len(self._images)
+
+
+class Job:
+    _ids = itertools.count(1)
+
+    def __init__(self, request: dict):
+        self.id = next(self._ids)
+        self.op = request["op"]
+        self.priority = int(request.get("priority", 0))
+        self.verify = bool(request.get("verify", True))
+        self.jump = bool(request.get("jump", True))
+        self.strip = bool(request.get("strip", False))
+        self.mode = request.get("mode", "auto")
+        if self.mode not in ("auto",) + UPLOAD_MODES:
+            raise ValueError(f"unknown mode: {self.mode}")
+        self.prepared: PreparedImage | None = None
+        self.image = ""
+        self.result: dict = {}
+        self.done = threading.Event()
+
+
+class PortWorker:
+    """Owns one bootloader port: a warm connection and a priority job queue."""
+
+    def __init__(self, port: str):
+        self.port = port
+        self.state = "idle"
+        self.current: Job | None = None
+        self.uploader: BootloaderUploader | None = None
+        self.jobs: queue.PriorityQueue = queue.PriorityQueue()
+        self._seq = itertools.count()
+        self.thread = threading.Thread(target=self._run, name=port, daemon=True)
+        self.thread.start()
+
+    def submit(self, job: Job) -> int:
+        # Highest priority first, FIFO within a priority
+        self.jobs.put((-job.priority, next(self._seq), job))
+        return self.jobs.qsize()
+
+    def _close(self):
+        if self.uploader is not None:
+            self.uploader.disconnect()
+            self.uploader = None
+
+    def _open(self) -> BootloaderUploader:
+        if self.uploader is not None and self.uploader.serial and self.uploader.serial.is_open:
+            return self.uploader
+        deadline = time.time() + REOPEN_TIMEOUT_S
+        while True:
+            uploader = BootloaderUploader(port=self.port, verbose=False)
+            if uploader.connect():
+                self.uploader = uploader
+                return uploader
+            if time.time() >= deadline:
+                raise RuntimeError("cannot open port")
+            time.sleep(0.1)
+
+    def _execute(self, job: Job) -> dict:
+        uploader = self._open()
+
+        if job.op == "version":
+            ok, response = uploader.send_command('V')
+            return {"ok": ok, "result": response}
+
+        if job.op == "verify":
+            ok, response = uploader.send_command('C')
+            return {"ok": ok, "result": response}
+
+        if job.op == "jump":
+            ok, response = uploader.send_command('J')
+            self._close()   # the device leaves the bus
+            return {"ok": ok, "result": response}
+
+        if job.op == "reset":
+            ok, _ = uploader.send_command('X', wait_response=False)
+            self._close()
+            return {"ok": ok, "result": "reset"}
+
+        # flash: the checks and data mode of a single upload (plan_upload)
+        self.state = "status"
+        try:
+            plan = job.prepared.plan(uploader.get_status(), job.strip, job.mode)
+        except ValueError as e:
+            return {"ok": False, "result": str(e)}
+
+        def progress(state: str, done: int):
+            self.state = state
+
+        try:
+            result = send_image(uploader, plan.records, plan.window, job.verify, job.jump, progress)
+        except RuntimeError as e:
+            return {"ok": False, "result": str(e), "mode": plan.mode}
+        if job.jump:
+            self._close()   # the device leaves the bus
+        return {"ok": True, "result": result, "mode": plan.mode}
+
+    def _run(self):
+        while True:
+            _, _, job = self.jobs.get()
+            self.current = job
+            self.state = job.op
+            start = time.perf_counter()
+            try:
+                try:
+                    job.result = self._execute(job)
+                except (serial.SerialException, OSError):
+                    # Stale handle (device re-enumerated since the last job): reopen once
+                    self._close()
+                    job.result = self._execute(job)
+            except (RuntimeError, serial.SerialException, OSError) as e:
+                self._close()
+                job.result = {"ok": False, "result": str(e)}
+            job.result.update(job=job.id, port=self.port,
+                              elapsed_s=round(time.perf_counter() - start, 3))
+            if job.image:
+                job.result["image"] = job.image
+            self.current = None
+            self.state = "idle"
+            job.done.set()
+
+
+class FlashDaemon:
+    def __init__(self):
+        self.images = ImageCache()
+        self.workers: dict[str, PortWorker] = {}
+        self._lock = threading.Lock()
+        self._last_scan = 0.0
+        self._present: set[str] = set()
+
+    def rescan(self, force: bool = False):
+        with self._lock:
+            if not force and time.time() - self._last_scan < RESCAN_INTERVAL_S:
+                return
+            self._last_scan = time.time()
+            self._present = set(find_bootloader_ports())
+            for port in self._present:
+                if port not in self.workers:
+                    self.workers[port] = PortWorker(port)
+
+    def pick_worker(self, port: str | None) -> PortWorker:
+        self.rescan()
+        with self._lock:
+            if port is not None:
+                if port not in self.workers:
+                    # Explicit ports are accepted even if discovery missed them
+                    self.workers[port] = PortWorker(port)
+                return self.workers[port]
+            # Ports that left the bus (jumped to the app) keep their worker but take no new jobs
+            present = [w for w in self.workers.values() if w.port in self._present]
+            if not present:
+                raise RuntimeError("no bootloader ports")
+            return min(present, key=lambda w: w.jobs.qsize() + (w.current is not None))
+
+    def status(self) -> dict:
+        self.rescan()
+        with self._lock:
+            ports = [{"port": w.port, "present": w.port in self._present,
+                      "state": w.state, "queued": w.jobs.qsize(),
+                      "job": w.current.id if w.current else None,
+                      "open": w.uploader is not None}
+                     for w in self.workers.values()]
+        return {"ok": True, "ports": ports, "images": len(self.images)}
+
+
+class RequestHandler(socketserver.StreamRequestHandler):
+    def _reply(self, obj: dict):
+        self.wfile.write((json.dumps(obj) + "\n").encode('utf-8'))
+        self.wfile.flush()
+
+    def handle(self):
+        daemon: FlashDaemon = self.server.daemon_state
+        line = self.rfile.readline()
+        try:
+            request = json.loads(line)
+            op = request.get("op")
+            if op == "status":
+                self._reply(daemon.status())
+                return
+            if op not in JOB_OPS:
+                raise ValueError(f"unknown op: {op}")
+
+            job = Job(request)
+            if op == "flash":
+                job.image, job.prepared = daemon.images.get(Path(request["hex"]))
+            worker = daemon.pick_worker(request.get("port"))
+        except (ValueError, KeyError, OSError, RuntimeError) as e:
+            self._reply({"ok": False, "result": str(e)})
+            return
+
+        position = worker.submit(job)
+        self._reply({"job": job.id, "state": "queued", "port": worker.port, "position": position})
+        job.done.wait()
+        self._reply(job.result)
+
+
+class ThreadingServer(socketserver.ThreadingTCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def _split_listen(listen: str) -> tuple[str, int]:
+    host, _, port = listen.rpartition(":")
+    return host or "127.0.0.1", int(port)
+
+
+def serve(listen: str) -> int:
+    state = FlashDaemon()
+    state.rescan(force=True)
+    host, port = _split_listen(listen)
+    with ThreadingServer((host, port), RequestHandler) as server:
+        server.daemon_state = state
+        print(f"Listening on {host}:{port}, ports: {', '.join(state.workers) or '(none yet)'}")
+        try:
+            server.serve_forever()
+        except KeyboardInterrupt:
+            pass
+    return 0
+
+
+def submit(listen: str, request: dict) -> int:
+    host, port = _split_listen(listen)
+    try:
+        sock = socket.create_connection((host, port))
+    except OSError as e:
+        print(f"ERROR: Cannot reach daemon at {listen}: {e}")
+        return 1
+    with sock, sock.makefile('rwb') as f:
+        f.write((json.dumps(request) + "\n").encode('utf-8'))
+        f.flush()
+        reply = {}
+        for line in f:
+            reply = json.loads(line)
+            if reply.get("state") == "queued":
+                print(f"Job {reply['job']} queued on {reply['port']} (position {reply['position']})")
+                continue
+            break
+    if request["op"] == "status":
+        print(json.dumps(reply, indent=2))
+    else:
+        print(f"{'OK' if reply.get('ok') else 'FAILED'}: {reply.get('result', '')}"
+              + (f" ({reply['elapsed_s']}s)" if "elapsed_s" in reply else ""))
+    return 0 if reply.get("ok") else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Resident flashing daemon for the PIC24 USB Bootloader")
+    parser.add_argument('--listen', default=DEFAULT_LISTEN,
+                        help=f'Daemon address (default {DEFAULT_LISTEN})')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+
+    sub.add_parser('serve', help='Run the daemon')
+    sub.add_parser('status', help='Show ports, queues and cached images')
+
+    flash = sub.add_parser('flash', help='Queue an upload')
+    flash.add_argument('hexfile', type=Path)
+    flash.add_argument('--no-verify', action='store_true')
+    flash.add_argument('--no-jump', action='store_true')
+    flash.add_argument('--mode', choices=('auto',) + UPLOAD_MODES, default='auto',
+                       help='Data transfer mode cap (default: fastest the device advertises)')
+    flash.add_argument('--strip-data', action='store_true',
+                       help='Drop content in the preserved application data instead of refusing it')
+
+    for name in ("verify", "jump", "reset", "version"):
+        sub.add_parser(name, help=f"Queue a '{name}' job")
+
+    for p in sub.choices.values():
+        if p.prog.split()[-1] in JOB_OPS:
+            p.add_argument('--port', '-p', default=None, help='Target port (default: least busy)')
+            p.add_argument('--priority', type=int, default=0, help='Higher runs first')
+
+    args = parser.parse_args()
+
+    if args.cmd == 'serve':
+        sys.exit(serve(args.listen))
+
+    request: dict[str, object] = {"op": args.cmd}
+    if args.cmd in JOB_OPS:
+        request.update(port=args.port, priority=args.priority)
+    if args.cmd == 'flash':
+        request.update(hex=str(args.hexfile.resolve()), verify=not args.no_verify, jump=not args.no_jump,
+                       mode=args.mode, strip=args.strip_data)
+    sys.exit(submit(args.listen, request))
+
+
+if __name__ == '__main__':
+    main()
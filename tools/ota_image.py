@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+PIC24 Bootloader Install Area Image
+
+Builds what an application stages in the SPI NOR install area before it
+asks the bootloader to install an image it received itself (e.g. over the
+radio): the manifest (BlOtaManifest_t) at offset 0, padded with 0xFF to
+BL_OTA_DATA_OFFSET, then the row stream (src/bl_pack.h). The application
+writes the file to BL_OTA_NOR_BASE as it is, stream first and manifest last,
+and calls BL_RequestInstall() (src/bl_shared.h).
+
+Rows that are all 0xFFFFFF are left out; the bootloader erases them. By
+default the image covers the whole application area, so whatever the old
+application had outside the new image is erased as well, except for the
+preserved application data (BL_APP_DATA_START), which the bootloader never
+touches. A HEX file with content there is refused unless --strip-data.
+
+Usage:
+    python ota_image.py app.hex app.ota
+    python ota_image.py app.hex app.ota --raw
+    python ota_image.py app.hex app.ota --small --start 0x8000 --end 0xAC00
+
+Test in the host simulator:
+    build/sim/bootloader_sim -n nor.bin -s -i app.ota
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+from pathlib import Path
+
+from upload_firmware import hex_image, image_data_overlap, parse_hex_file, row_bytes, strip_data
+
+APP_START = 0x4000          # BL_APP_START in src/bl_shared.h
+APP_START_SMALL = 0x2000    # BL_SMALL builds
+APP_END = 0xABFE            # APP_END_ADDRESS in src/bootloader.h
+APP_DATA = range(0xA400, 0xA400 + 0x0400)   # BL_APP_DATA_START/SIZE in src/bl_shared.h
+
+ROW_PC_UNITS = 128          # 64 instructions
+PAGE_PC_UNITS = 1024        # 512 instructions
+ROW_BYTES = 64 * 3
+
+# src/bl_shared.h
+OTA_MAGIC = 0x4D41544F
+OTA_DATA_OFFSET = 0x1000
+OTA_NOR_SIZE = 0x10000
+OTA_PACKBITS = 0x0001
+ROW_END = 0xFFFF
+
+# PackBits, as src/bl_pack.c encodes
+RUN_MIN = 3
+RUN_MAX = 128
+LITERAL_MAX = 128
+
+
+def _run_length(data: bytes, i: int) -> int:
+    n = 1
+    while i + n < len(data) and n < RUN_MAX and data[i + n] == data[i]:
+        n += 1
+    return n
+
+
+def packbits(data: bytes) -> bytes:
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        n = _run_length(data, i)
+        if n >= RUN_MIN:
+            out += bytes([257 - n, data[i]])
+            i += n
+            continue
+        n = 1
+        while i + n < len(data) and n < LITERAL_MAX and _run_length(data, i + n) < RUN_MIN:
+            n += 1
+        out.append(n - 1)
+        out += data[i:i + n]
+        i += n
+    return bytes(out)
+
+
+def build(image: dict[int, int], app_start: int, start: int, end: int,
+          packed: bool) -> tuple[bytes, dict]:
+    """Install area contents and a summary. Raises ValueError."""
+    if start % PAGE_PC_UNITS or end % PAGE_PC_UNITS:
+        raise ValueError("start and end must be page (0x400) aligned")
+    if not app_start <= start < end <= APP_END + 2:
+        raise ValueError(f"range 0x{start:05X}-0x{end:05X} is not inside the application area "
+                         f"0x{app_start:05X}-0x{APP_END + 2:05X}")
+    outside = sorted({(a // 4) * 2 for a in image
+                      if a < 0x1000000 and not start <= (a // 4) * 2 < end})
+    if outside:
+        raise ValueError(f"{len(outside)} instructions outside 0x{start:05X}-0x{end:05X} "
+                         f"(0x{outside[0]:05X} .. 0x{outside[-1]:05X})")
+    overlap = image_data_overlap(image, APP_DATA)
+    if overlap:
+        raise ValueError(f"{len(overlap)} instructions in the preserved application data "
+                         f"0x{APP_DATA.start:05X}-0x{APP_DATA.stop - 1:05X} "
+                         f"(0x{overlap[0]:05X} .. 0x{overlap[-1]:05X}); --strip-data drops them")
+
+    stream = bytearray()
+    crc = 0
+    rows = 0
+    for index, pc in enumerate(range(start, end, ROW_PC_UNITS)):
+        data = row_bytes(image, pc)
+        crc = zlib.crc32(data, crc)
+        if data == b"\xFF" * ROW_BYTES:
+            continue
+        stream += struct.pack("<H", index)
+        stream += packbits(data) if packed else data
+        rows += 1
+    stream += struct.pack("<H", ROW_END)
+    if len(stream) > OTA_NOR_SIZE - OTA_DATA_OFFSET:
+        raise ValueError(f"stream of {len(stream)} bytes does not fit the install area")
+
+    manifest = struct.pack("<6IHH", OTA_MAGIC, app_start, start, end, len(stream),
+                           crc & 0xFFFFFFFF, OTA_PACKBITS if packed else 0, 0)
+    area = manifest + b"\xFF" * (OTA_DATA_OFFSET - len(manifest)) + bytes(stream)
+    return area, {"rows": rows, "total_rows": (end - start) // ROW_PC_UNITS,
+                  "stream": len(stream), "crc": crc & 0xFFFFFFFF, "packed": packed}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build a bootloader install area image from a HEX file")
+    parser.add_argument("hexfile", type=Path)
+    parser.add_argument("output", type=Path)
+    parser.add_argument("--small", action="store_true",
+                        help="for a BL_SMALL bootloader (application at 0x2000)")
+    parser.add_argument("--start", type=lambda s: int(s, 0), default=None,
+                        help="first program address to install (default: application start)")
+    parser.add_argument("--end", type=lambda s: int(s, 0), default=APP_END + 2,
+                        help=f"first program address past the install (default: 0x{APP_END + 2:05X})")
+    parser.add_argument("--strip-data", action="store_true",
+                        help="drop content in the preserved application data instead of refusing it")
+    parser.add_argument("--raw", action="store_true",
+                        help="store rows without PackBits (default: PackBits if it is smaller)")
+    args = parser.parse_args()
+
+    app_start = APP_START_SMALL if args.small else APP_START
+    start = app_start if args.start is None else args.start
+    try:
+        image = hex_image(parse_hex_file(args.hexfile))
+        if args.strip_data:
+            image = strip_data(image, APP_DATA)
+        area, info = build(image, app_start, start, args.end, packed=False)
+        if not args.raw:
+            # PackBits unless it does not pay off for this image
+            packed_area, packed_info = build(image, app_start, start, args.end, packed=True)
+            if len(packed_area) < len(area):
+                area, info = packed_area, packed_info
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        sys.exit(1)
+
+    args.output.write_bytes(area)
+    print(f"{args.output}: 0x{start:05X}-0x{args.end:05X}, {info['rows']} of {info['total_rows']} rows, "
+          f"{'PackBits' if info['packed'] else 'raw'} stream {info['stream']} bytes, "
+          f"crc {info['crc']:08X}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""
+PIC24 Bootloader RAM Budget
+
+Reads the data memory tables of an XC16 link map (build.ps1 writes
+dist/default/production/bootloader.X.map) and shows where the 8 KB of RAM
+goes: USB buffers, static data, the fixed persistent windows shared with the
+application, heap and stack. With the stack high-water mark from a running
+bootloader ('S' stack_peak, or --port to read it) it also shows how much of
+the stack is never used and how many more row buffers (FLASH_ROW_BUFFERS in
+src/bootloader.h) that would pay for.
+
+Usage:
+    python ram_budget.py dist/default/production/bootloader.X.map
+    python ram_budget.py bootloader.X.map --stack-peak 412
+    python ram_budget.py bootloader.X.map --port COM10
+"""
+
+import argparse
+import re
+import sys
+from pathlib import Path
+
+RAM_START = 0x0800
+RAM_END = 0x2800            # exclusive
+USB_RAM_END = 0x0C00        # usb_ram region of the bootloader linker script
+
+# Fixed-address windows, see src/bl_shared.h and src/bl_bootlog.h
+PERSIST_SECTIONS = (".bl_persist", ".app_persist", ".bl_log")
+
+# One FlashRow_t: 4-byte address + 64 instructions of 4 bytes
+ROW_BUFFER_BYTES = 4 + 64 * 4
+
+# Stack kept free on top of the measured peak before any is handed out
+STACK_MARGIN = 128
+
+_NUM = r"(0x[0-9a-fA-F]+|\d+)"
+# "name  address  alignment-gaps  total-length  (dec)"
+DATA_ROW = re.compile(rf"^\s*(\S+)\s+{_NUM}\s+{_NUM}\s+{_NUM}\s+\((\d+)\)")
+# "heap|stack  address  maximum-length  (dec)"
+DYNAMIC_ROW = re.compile(rf"^\s*(heap|stack)\s+{_NUM}\s+{_NUM}\s+\((\d+)\)")
+
+
+def parse_map(text: str) -> tuple[list[tuple[str, int, int]], dict[str, tuple[int, int]]]:
+    """Return ([(section, address, bytes)], {"heap"|"stack": (address, bytes)})."""
+    sections = []
+    dynamic = {}
+    block = None
+    for line in text.splitlines():
+        if line.startswith("Data Memory"):
+            block = "data"
+            continue
+        if line.startswith("Dynamic Memory"):
+            block = "dynamic"
+            continue
+        if line.strip().startswith("Total") or line.strip().startswith("Maximum"):
+            block = None
+            continue
+        if block == "data":
+            m = DATA_ROW.match(line)
+            if m:
+                sections.append((m.group(1), int(m.group(2), 0), int(m.group(5))))
+        elif block == "dynamic":
+            m = DYNAMIC_ROW.match(line)
+            if m:
+                dynamic[m.group(1)] = (int(m.group(2), 0), int(m.group(4)))
+    return sections, dynamic
+
+
+def classify(name: str, address: int) -> str:
+    if name in PERSIST_SECTIONS:
+        return "persistent"
+    if "usb" in name.lower() or RAM_START <= address < USB_RAM_END:
+        return "usb"
+    return "static"
+
+
+def read_stack_peak(port: str) -> int | None:
+    from upload_firmware import BootloaderUploader
+
+    uploader = BootloaderUploader(port=port)
+    if not uploader.connect():
+        return None
+    try:
+        status = uploader.get_status() or {}
+    finally:
+        uploader.disconnect()
+    return status.get("stack_peak") or None
+
+
+def report(sections, dynamic, stack_peak: int | None) -> None:
+    total = RAM_END - RAM_START
+    groups = {"usb": 0, "static": 0, "persistent": 0}
+
+    print(f"RAM 0x{RAM_START:04X}-0x{RAM_END - 1:04X} ({total} bytes)\n")
+    print(f"  {'section':<24} {'address':<7}{'bytes':>8}  group")
+    for name, address, size in sorted(sections, key=lambda s: s[1]):
+        group = classify(name, address)
+        groups[group] += size
+        print(f"  {name:<24} 0x{address:04X} {size:>8}  {group}")
+    for name in ("heap", "stack"):
+        if name in dynamic:
+            address, size = dynamic[name]
+            print(f"  {name:<24} 0x{address:04X} {size:>8}  {name}")
+
+    heap = dynamic.get("heap", (0, 0))[1]
+    stack = dynamic.get("stack", (0, 0))[1]
+    used = sum(groups.values()) + heap + stack
+    print()
+    for group, size in groups.items():
+        print(f"  {group:<12} {size:>6}")
+    print(f"  {'heap':<12} {heap:>6}")
+    print(f"  {'stack':<12} {stack:>6}")
+    print(f"  {'unassigned':<12} {total - used:>6}")
+
+    if stack_peak and stack:
+        spare = stack - stack_peak - STACK_MARGIN
+        print(f"\n  stack peak {stack_peak} of {stack} bytes ({100 * stack_peak / stack:.0f}%)")
+        if spare > 0:
+            print(f"  {spare} bytes spare after a {STACK_MARGIN} byte margin: "
+                  f"{spare // ROW_BUFFER_BYTES} more row buffer(s) of {ROW_BUFFER_BYTES} bytes")
+        else:
+            print(f"  no spare stack above a {STACK_MARGIN} byte margin")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RAM budget of a PIC24 bootloader link map")
+    parser.add_argument('mapfile', type=Path, help='XC16 link map (-Wl,-Map=...)')
+    peak = parser.add_mutually_exclusive_group()
+    peak.add_argument('--stack-peak', type=int, default=None,
+                      help="Stack high-water mark in bytes ('S' stack_peak)")
+    peak.add_argument('--port', '-p', default=None,
+                      help='Read the stack high-water mark from the bootloader on this port')
+    args = parser.parse_args()
+
+    sections, dynamic = parse_map(args.mapfile.read_text(errors='replace'))
+    if not sections and not dynamic:
+        print(f"No data memory tables in {args.mapfile}", file=sys.stderr)
+        sys.exit(1)
+
+    stack_peak = args.stack_peak
+    if args.port:
+        stack_peak = read_stack_peak(args.port)
+        if stack_peak is None:
+            print("Could not read stack_peak from the bootloader", file=sys.stderr)
+
+    report(sections, dynamic, stack_peak)
+
+
+if __name__ == "__main__":
+    main()
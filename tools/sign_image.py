@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+PIC24 Bootloader Signed Image
+
+Signs a HEX file for a BL_AUTH bootloader (src/bl_auth.h): computes the
+HMAC-SHA256 of the rows an upload programs and writes the image back out
+with the MAC as 32 data bytes at program address 0xFE0000 (HEX byte address
+0x1FC0000), in address order as 16-byte records. A BL_AUTH bootloader
+programs the row with the application's reset vector only if the MAC
+matches; other bootloaders skip the MAC like any address outside the
+application area.
+
+The MAC covers each row the bootloader would program, in address order:
+its program address (3 bytes, low byte first), then its 64 instructions as
+3 bytes each. Rows outside the application area and in the preserved
+application data are not programmed and not covered.
+
+The key file holds the 32-byte key as 64 hex digits, the bytes of
+BL_AUTH_KEY in src/bl_auth_key.h.
+
+Usage:
+    python sign_image.py app.hex app.signed.hex --key auth.key
+    python upload_firmware.py --port COM10 app.signed.hex
+"""
+
+import argparse
+import hashlib
+import hmac
+import sys
+from pathlib import Path
+
+from ota_image import APP_DATA, APP_END, APP_START
+from upload_firmware import (AUTH_MAC_ADDRESS, AUTH_MAC_SIZE, CONFIG_SPACE_BYTE_ADDRESS,
+                             ROW_INSTRUCTIONS, hex_image, image_data_overlap, pack_records,
+                             parse_hex_file, row_bytes, strip_data)
+
+KEY_SIZE = 32
+ROW_PC_UNITS = ROW_INSTRUCTIONS * 2
+
+
+def read_key(path: Path) -> bytes:
+    """The key from a file of 64 hex digits. Raises ValueError."""
+    try:
+        key = bytes.fromhex(path.read_text().strip())
+    except ValueError:
+        raise ValueError(f"{path} does not hold hex digits")
+    if len(key) != KEY_SIZE:
+        raise ValueError(f"{path} holds {len(key)} bytes, not {KEY_SIZE}")
+    return key
+
+
+def image_mac(image: dict[int, int], key: bytes) -> bytes:
+    """HMAC-SHA256 of the rows a direct upload of 'image' programs."""
+    rows = sorted({(a // 4) * 2 - (a // 4) * 2 % ROW_PC_UNITS for a in image
+                   if a < CONFIG_SPACE_BYTE_ADDRESS and APP_START <= (a // 4) * 2 <= APP_END
+                   and (a // 4) * 2 not in APP_DATA})
+    mac = hmac.new(key, digestmod=hashlib.sha256)
+    for pc in rows:
+        mac.update(pc.to_bytes(3, "little"))
+        mac.update(row_bytes(image, pc))
+    return mac.digest()
+
+
+def sign(image: dict[int, int], key: bytes) -> tuple[list[str], bytes]:
+    """HEX records of the signed image and its MAC. Raises ValueError."""
+    mac_base = 2 * AUTH_MAC_ADDRESS
+    image = {a: v for a, v in image.items() if not mac_base <= a < mac_base + AUTH_MAC_SIZE}
+    if not any(APP_START <= (a // 4) * 2 < APP_START + ROW_PC_UNITS for a in image):
+        raise ValueError(f"no reset vector row at 0x{APP_START:05X}; the image would never boot")
+    overlap = image_data_overlap(image, APP_DATA)
+    if overlap:
+        raise ValueError(f"{len(overlap)} instructions in the preserved application data "
+                         f"0x{APP_DATA.start:05X}-0x{APP_DATA.stop - 1:05X} "
+                         f"(0x{overlap[0]:05X} .. 0x{overlap[-1]:05X}); --strip-data drops them")
+    mac = image_mac(image, key)
+    image.update({mac_base + i: b for i, b in enumerate(mac)})
+    return pack_records(image, 16), mac
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Sign a HEX file for a BL_AUTH bootloader")
+    parser.add_argument("hexfile", type=Path)
+    parser.add_argument("output", type=Path)
+    parser.add_argument("--key", type=Path, required=True,
+                        help="file with the 32-byte key as 64 hex digits")
+    parser.add_argument("--strip-data", action="store_true",
+                        help="drop content in the preserved application data instead of refusing it")
+    args = parser.parse_args()
+
+    try:
+        key = read_key(args.key)
+        image = hex_image(parse_hex_file(args.hexfile))
+        if args.strip_data:
+            image = strip_data(image, APP_DATA)
+        records, mac = sign(image, key)
+    except (OSError, ValueError) as e:
+        print(f"ERROR: {e}")
+        sys.exit(1)
+
+    args.output.write_text("\n".join(records) + "\n")
+    print(f"{args.output}: {len(records)} records, MAC {mac.hex().upper()}")
+
+
+if __name__ == "__main__":
+    main()
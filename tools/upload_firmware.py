@@ -14,6 +14,13 @@ Protocol:
     C - Verify/complete
     J - Jump to application
     X - Reset device
+    S - Binary status record (memory map, capabilities, transfer limits)
+    T - External SPI NOR staging store (TB begin, TC<crc> commit, TI install,
+        TR roll back, T slot info)
+
+Entering the bootloader from a running application (--touch):
+    Opening the app's CDC port at 1200 baud makes an app built with the
+    bl_shared.h hooks reset into the bootloader (see README).
 """
 
 import argparse
@@ -22,30 +29,121 @@ import serial.tools.list_ports
 import time
 import sys
 import re
+import struct
 import csv
+import glob
+import json
+import os
+import math
+import platform
+import threading
+import zlib
+from collections import deque
+from contextlib import contextmanager
 from datetime import datetime
 from pathlib import Path
 
 
+TOUCH_BAUD = 1200   # BL_TOUCH_BAUD in src/bl_shared.h
+FCY_HZ = 16000000   # BL_TIMEBASE_HZ in src/bl_timebase.h
+
+# BlCounters_t after the version/size header, in order (src/bl_counters.h)
+COUNTER_FIELDS = (
+    "records_parsed", "checksum_errors", "rows_written", "pages_erased", "pages_skipped",
+    "rx_overruns", "tx_stalls", "usb_bus_errors", "main_loops", "words_written",
+)
+
+# BlProfSection_t, in order (src/bl_prof.h)
+PROFILE_SECTIONS = (
+    "usb_isr", "usb_tasks", "command", "hex_parse", "cdc_tx",
+    "flash_erase", "flash_blank", "flash_write_row", "flash_write_word", "auth_hash",
+)
+
+# BlStatus_t after the 8-byte header, in order (src/bl_status.h)
+STATUS_FIELDS = (
+    ("app_start", "I"), ("app_end", "I"),
+    ("stub_to_app", "H"), ("jump_returns", "H"), ("saw_reset_stub", "H"), ("last_rcon", "H"),
+    ("last_cmd", "H"), ("cmd_count", "H"), ("boot_seq", "H"),
+    ("app_trap_code", "H"), ("app_trap_count", "H"), ("app_trap_intcon1", "H"),
+    ("app_trap_rcon", "H"), ("app_boot_count", "H"), ("app_stage", "H"), ("app_last_rcon", "H"),
+    ("serial", "12s"),
+    ("max_line", "H"), ("max_record_bytes", "H"), ("window_depth", "H"),
+    ("row_size", "H"), ("page_size", "H"), ("compression", "B"), ("crc", "B"),
+    ("stack_size", "H"), ("stack_peak", "H"),
+    ("app_data_start", "I"), ("app_data_size", "I"),
+)
+
+# BlStatus_t.capabilities
+CAPABILITIES = {0x0001: "link_test", 0x0002: "counters", 0x0004: "profile",
+                0x0008: "boot_log", 0x0010: "bench", 0x0020: "hex_window",
+                0x0040: "staging", 0x0080: "golden", 0x0100: "patch", 0x0200: "delta",
+                0x0400: "auth"}
+
+# BlStageInfo_t / BlStageHeader_t (src/bl_stage.h)
+STAGE_MAGIC = 0x47545342
+STAGE_NO_SLOT = 0xFF
+
+# BlGoldenInfo_t / BlGoldenHeader_t / BlRecovery_t (src/bl_golden.h)
+GOLDEN_MAGIC = 0x4E444C47
+
+# Data transfer modes, slowest first (select_upload_mode)
+UPLOAD_MODES = ("basic", "packed", "windowed")
+
+# Program rows ('M', 'R'): 64 instructions, 3 bytes each on the wire
+ROW_INSTRUCTIONS = 64
+ROW_BYTES = ROW_INSTRUCTIONS * 3
+CRC_MAP_ROWS = 64           # most rows one 'M' covers
+ERASED_INSTRUCTION = 0xFFFFFF
+
+# Delta page operations ('D', src/bl_delta.h)
+DELTA_OP_COPY = 0x80
+DELTA_OP_ERASED = 0xC0
+DELTA_LITERAL_MAX = 128
+DELTA_SEED = 4              # instructions a copy must share to be found
+DELTA_CANDIDATES = 32       # most recent copy sources tried per seed
+
+# HEX byte addresses from here up are configuration space (PC 0x800000+)
+CONFIG_SPACE_BYTE_ADDRESS = 0x1000000
+
+# Signed images (src/bl_auth.h): MAC at this program address
+AUTH_MAC_ADDRESS = 0xFE0000
+AUTH_MAC_SIZE = 32
+
+# BlBootEvent_t.path (src/bl_bootlog.h)
+BOOT_PATHS = {1: "app", 2: "jump", 3: "no-app", 4: "request", 5: "golden", 6: "install"}
+BOOT_TIME_OPEN = 0xFFFF
+
+# RCON reset-cause bits
+RCON_BITS = ((15, "TRAPR"), (14, "IOPUWR"), (9, "CM"), (7, "EXTR"), (6, "SWR"),
+             (4, "WDTO"), (1, "BOR"), (0, "POR"))
+
+
 class BootloaderUploader:
     """USB CDC Bootloader communication class."""
     
-    def __init__(self, port: str = None, baudrate: int = 115200, timeout: float = 5.0):
+    def __init__(self, port: str = None, baudrate: int = 115200, timeout: float = 5.0,
+                 verbose: bool = True, settle_s: float = 0.5):
         self.port = port
         self.baudrate = baudrate
         self.timeout = timeout
+        self.verbose = verbose
+        self.settle_s = settle_s
         self.serial = None
         
+    @staticmethod
+    def is_bootloader_port(port) -> bool:
+        """Microchip USB CDC device (VID 0x04D8) or a generic CDC port."""
+        vid_str = f"{port.vid:04X}" if port.vid else ""
+        return "04D8" in vid_str or \
+               "Microchip" in (port.manufacturer or "") or \
+               "CDC" in (port.description or "").upper()
+
     def find_bootloader_port(self) -> str:
         """Auto-detect the bootloader COM port."""
         ports = serial.tools.list_ports.comports()
         
         for port in ports:
-            # Look for Microchip USB CDC devices (VID 0x04D8)
-            vid_str = f"{port.vid:04X}" if port.vid else ""
-            if "04D8" in vid_str or \
-               "Microchip" in (port.manufacturer or "") or \
-               "CDC" in (port.description or "").upper():
+            if self.is_bootloader_port(port):
                 print(f"Found bootloader at {port.device}: {port.description}")
                 return port.device
         
@@ -72,7 +170,7 @@ class BootloaderUploader:
                 timeout=self.timeout,
                 write_timeout=self.timeout
             )
-            time.sleep(0.5)  # Wait for connection to stabilize
+            time.sleep(self.settle_s)  # Wait for connection to stabilize
             self.serial.reset_input_buffer()
             return True
         except serial.SerialException as e:
@@ -87,33 +185,235 @@ class BootloaderUploader:
     def send_command(self, cmd: str, wait_response: bool = True) -> tuple[bool, str]:
         """Send a command and optionally wait for response."""
         try:
-            self.serial.write((cmd + "\r\n").encode('ascii'))
+            self.write_line(cmd)
             self.serial.flush()
             
             if not wait_response:
                 return True, ""
-            
-            # Read response with timeout tracking
-            import time as t
-            start = t.time()
-            response = self.serial.readline().decode('ascii', errors='ignore').strip()
-            elapsed = t.time() - start
-            
-            if elapsed > 0.5:
-                print(f"\n  [Slow response: {elapsed:.2f}s]", end="")
-            
-            if response.startswith('+'):
-                return True, response[1:]
-            elif response.startswith('-'):
-                return False, response[1:]
-            elif response.startswith('?'):
-                return False, "Unknown command"
-            else:
-                return True, response  # Version string or other data
+            return self.read_reply()
                 
         except serial.SerialException as e:
             return False, str(e)
+
+    def write_line(self, cmd: str):
+        """Queue one command line without waiting for its reply."""
+        self.serial.write((cmd + "\r\n").encode('ascii'))
+
+    def read_reply(self) -> tuple[bool, str]:
+        """Read one reply line: (ok, text without the '+'/'-' code)."""
+        # Read response with timeout tracking
+        start = time.time()
+        response = self.serial.readline().decode('ascii', errors='ignore').strip()
+        elapsed = time.time() - start
+        
+        if elapsed > 0.5 and self.verbose:
+            print(f"\n  [Slow response: {elapsed:.2f}s]", end="")
+        
+        if response.startswith('+'):
+            return True, response[1:]
+        elif response.startswith('-'):
+            return False, response[1:]
+        elif response.startswith('?'):
+            return False, "Unknown command"
+        elif not response:
+            return False, "No response"
+        else:
+            return True, response  # Version string or other data
     
+    def link_test(self, mode: str, nbytes: int) -> dict | None:
+        """Run one 'L' link self-test: S sink, O source, E echo. None on protocol error."""
+        # Printable pattern: never starts with CR/LF (see src/bl_link.h)
+        payload = bytes(0x30 + (i & 0x3F) for i in range(nbytes))
+        old_timeout = self.serial.timeout
+        self.serial.timeout = max(self.timeout, nbytes / 20000.0)
+        try:
+            ok, response = self.send_command(f"L{mode}{nbytes}")
+            if not ok or not response.startswith("Link ready"):
+                return None
+
+            start = time.perf_counter()
+            data = b""
+            if mode == "S":
+                self.serial.write(payload)
+                self.serial.flush()
+            elif mode == "O":
+                data = self.serial.read(nbytes)
+            else:
+                # Write from a thread so neither side's buffers can fill up
+                writer = threading.Thread(target=self.serial.write, args=(payload,), daemon=True)
+                writer.start()
+                data = self.serial.read(nbytes)
+                writer.join()
+            line = self.serial.readline().decode('ascii', errors='ignore').strip()
+            host_s = time.perf_counter() - start
+        finally:
+            self.serial.timeout = old_timeout
+
+        match = re.search(r"bytes=(\d+) cycles=(\d+)", line)
+        if not match:
+            return None
+        device_bytes = int(match.group(1))
+        device_cycles = int(match.group(2))
+        intact = line.startswith('+') and device_bytes == nbytes and \
+            (mode == "S" or data == payload)
+        return {
+            "mode": {"S": "sink", "O": "source", "E": "echo"}[mode],
+            "bytes": nbytes,
+            "ok": intact,
+            "host_s": round(host_s, 4),
+            "host_Bps": round(nbytes / host_s) if host_s > 0 else 0,
+            "device_bytes": device_bytes,
+            "device_cycles": device_cycles,
+            "device_Bps": round(device_bytes * FCY_HZ / device_cycles) if device_cycles else 0,
+        }
+
+    def read_hex_block(self, cmd: str, tag: str | None = None) -> bytes | None:
+        """Send a command that answers with a hex-encoded "+<tag><hex>" line.
+
+        'tag' defaults to the command itself.
+        """
+        tag = tag or cmd
+        success, response = self.send_command(cmd)
+        if not success or not response.startswith(tag):
+            return None
+        try:
+            return bytes.fromhex(response[len(tag):])
+        except ValueError:
+            return None
+
+    def read_crc_map(self, address: int, rows: int) -> list[int] | None:
+        """CRC-32 of each of 'rows' program rows from 'address' ('M')."""
+        block = self.read_hex_block(f"M{address:06X}{rows:02X}", "M")
+        if block is None or len(block) != 4 * rows:
+            return None
+        return list(struct.unpack(f"<{rows}I", block))
+
+    def read_row(self, address: int) -> bytes | None:
+        """One program row, 3 bytes per instruction, low byte first ('R')."""
+        block = self.read_hex_block(f"R{address:06X}", "R")
+        return block if block is not None and len(block) == ROW_BYTES else None
+
+    def get_counters(self) -> dict | None:
+        """Read the performance counter block ('K'). None if unsupported."""
+        block = self.read_hex_block('K')
+        if block is None or len(block) < 4:
+            return None
+        version, size = block[0], block[1]
+        # Append-only layout: decode the counters this device has
+        count = min(len(COUNTER_FIELDS), (min(size, len(block)) - 4) // 4)
+        values = struct.unpack_from(f"<{count}I", block, 4)
+        counters = dict(zip(COUNTER_FIELDS, values))
+        counters["version"] = version
+        return counters
+
+    def clear_counters(self) -> bool:
+        """Clear the performance counters and the section profiler ('Z')."""
+        success, _ = self.send_command('Z')
+        return success
+
+    def get_profile(self) -> dict | None:
+        """Read the section profiler table ('P'). None if unsupported."""
+        block = self.read_hex_block('P')
+        if block is None or len(block) < 8:
+            return None
+        version, sections, entry_size, _, elapsed = struct.unpack_from("<BBBBI", block)
+        profile = {"version": version, "elapsed": elapsed, "sections": {}}
+        for i in range(sections):
+            offset = 8 + i * entry_size
+            if entry_size < 16 or offset + 16 > len(block):
+                break
+            name = PROFILE_SECTIONS[i] if i < len(PROFILE_SECTIONS) else f"section{i}"
+            count, total, lo, hi = struct.unpack_from("<4I", block, offset)
+            profile["sections"][name] = {"count": count, "total": total, "min": lo, "max": hi}
+        return profile
+
+    def get_boot_log(self) -> list[dict] | None:
+        """Read the boot event log ('H'), oldest first. None if unsupported."""
+        block = self.read_hex_block('H')
+        if block is None or len(block) < 8:
+            return None
+        _, _, entries, head, count, _ = struct.unpack_from("<HBBBBH", block)
+        if entries == 0 or len(block) < 8 + entries * 8:
+            return None
+        events = []
+        for i in range(min(count, entries)):
+            index = (head - count + 1 + i) % entries
+            rcon, stage, time_ms, path, seq = struct.unpack_from("<HHHBB", block, 8 + index * 8)
+            events.append({"seq": seq, "path": BOOT_PATHS.get(path, str(path)), "rcon": rcon,
+                           "app_stage": stage,
+                           "time_ms": None if time_ms == BOOT_TIME_OPEN else time_ms})
+        return events
+
+    def get_status(self) -> dict | None:
+        """Read the binary status record ('S'). None if unsupported."""
+        block = self.read_hex_block('S')
+        if block is None or len(block) < 8:
+            return None
+        schema, size, major, minor, caps, _ = struct.unpack_from("<BBBBHH", block)
+        status: dict[str, object] = {
+            "schema": schema, "version": f"{major}.{minor}", "capabilities": caps,
+            "caps": [name for bit, name in CAPABILITIES.items() if caps & bit],
+        }
+        # Append-only layout: decode the fields this device has
+        offset = 8
+        end = min(size, len(block))
+        for name, fmt in STATUS_FIELDS:
+            width = struct.calcsize("<" + fmt)
+            if offset + width > end:
+                break
+            value = struct.unpack_from("<" + fmt, block, offset)[0]
+            status[name] = value.decode('ascii', errors='replace') if isinstance(value, bytes) else value
+            offset += width
+        return status
+
+    def get_stage_info(self) -> dict | None:
+        """Read the staging store slot table ('T'). None if unsupported."""
+        block = self.read_hex_block('T')
+        if block is None or len(block) < 8:
+            return None
+        jedec_id, newest, receiving, slots, header_size = struct.unpack_from("<IBBBB", block)
+        info = {"jedec_id": jedec_id, "newest": None if newest == STAGE_NO_SLOT else newest,
+                "receiving": None if receiving == STAGE_NO_SLOT else receiving, "slots": []}
+        for i in range(slots):
+            offset = 8 + i * header_size
+            if header_size < 16 or offset + 16 > len(block):
+                break
+            magic, seq, crc, app_start = struct.unpack_from("<4I", block, offset)
+            valid = magic == STAGE_MAGIC
+            info["slots"].append({"valid": valid, "seq": seq if valid else None,
+                                  "crc": crc if valid else None,
+                                  "app_start": app_start if valid else None})
+        return info
+
+    def get_golden_info(self) -> dict | None:
+        """Read the golden image header and failed-boot state ('G'). None if unsupported."""
+        block = self.read_hex_block('G')
+        if block is None or len(block) < 36:
+            return None
+        magic, crc, app_start, length, stream_crc, rows = struct.unpack_from("<5IH", block)
+        (_, launched, fail_streak, trap_count, restores,
+         restored) = struct.unpack_from("<HBBHHB", block, 24)
+        available, fail_limit = struct.unpack_from("<BB", block, 34)
+        valid = magic == GOLDEN_MAGIC
+        return {"available": bool(available), "valid": valid,
+                "crc": crc if valid else None, "app_start": app_start if valid else None,
+                "length": length if valid else None, "rows": rows if valid else None,
+                "stream_crc": stream_crc if valid else None,
+                "launched": bool(launched), "fail_streak": fail_streak, "fail_limit": fail_limit,
+                "trap_count": trap_count, "restores": restores, "restored": bool(restored)}
+
+    def stage_command(self, cmd: str, label: str, timeout: float) -> bool:
+        """Run one long 'T' or 'G' sub-command (erase/CRC/program on the device)."""
+        print(f"{label}...", end=" ", flush=True)
+        old_timeout = self.serial.timeout
+        self.serial.timeout = timeout
+        try:
+            success, response = self.send_command(cmd)
+        finally:
+            self.serial.timeout = old_timeout
+        print("OK" if success else f"FAILED: {response}")
+        return success
+
     def get_version(self) -> str:
         """Get bootloader version."""
         success, response = self.send_command('V')
@@ -160,22 +460,609 @@ class BootloaderUploader:
         return success
 
 
-def parse_hex_file(filepath: Path) -> list[str]:
-    """Parse an Intel HEX file and return list of records."""
+def _port_present(port: str) -> bool:
+    if Path(port).exists():
+        return True
+    return any(p.device == port for p in serial.tools.list_ports.comports())
+
+
+class DeviceWatcher:
+    """Follows one USB CDC device appearing and disappearing.
+
+    Matches an explicit port name, or else the first port whose USB device has
+    the given VID (and PID / serial number, if set). On Linux the USB
+    attributes are read from sysfs, and kernel uevents wake the waits if
+    pyudev is installed; other hosts poll the port list.
+    """
+
+    def __init__(self, port: str | None = None, vid: int = 0x04D8, pid: int | None = None,
+                 serial_number: str | None = None):
+        self.port = port
+        self.vid = vid
+        self.pid = pid
+        self.serial_number = serial_number
+        self._sysfs = sys.platform.startswith('linux') and os.path.isdir('/sys/class/tty')
+        self._poll_s = 0.002 if (self._sysfs or port is not None) else 0.02
+        self._monitor = None
+        if self._sysfs:
+            try:
+                import pyudev
+                self._monitor = pyudev.Monitor.from_netlink(pyudev.Context())
+                self._monitor.filter_by('tty')
+                self._monitor.start()
+            except Exception:
+                self._monitor = None
+
+    @staticmethod
+    def _read_attr(path: str, name: str) -> str:
+        try:
+            with open(os.path.join(path, name), encoding='ascii') as f:
+                return f.read().strip()
+        except OSError:
+            return ""
+
+    def _find_sysfs(self) -> str | None:
+        for tty in sorted(glob.glob('/sys/class/tty/ttyACM*')):
+            # .../usbX/X-Y (idVendor, serial) / X-Y:1.0 (interface) / tty/ttyACMn
+            usb_dev = os.path.dirname(os.path.realpath(os.path.join(tty, 'device')))
+            if self._read_attr(usb_dev, 'idVendor') != f"{self.vid:04x}":
+                continue
+            if self.pid is not None and self._read_attr(usb_dev, 'idProduct') != f"{self.pid:04x}":
+                continue
+            if self.serial_number is not None:
+                if self._read_attr(usb_dev, 'serial') != self.serial_number:
+                    continue
+                return by_id_path('/dev/' + os.path.basename(tty))
+            return '/dev/' + os.path.basename(tty)
+        return None
+
+    def find(self) -> str | None:
+        """Current port of the device, or None if it is not enumerated."""
+        if self.port is not None:
+            return self.port if _port_present(self.port) else None
+        if self._sysfs:
+            return self._find_sysfs()
+        for p in serial.tools.list_ports.comports():
+            if p.vid == self.vid and (self.pid is None or p.pid == self.pid) and \
+               (self.serial_number is None or p.serial_number == self.serial_number):
+                return p.device
+        return None
+
+    def wait(self, present: bool, timeout_s: float) -> float | None:
+        """Seconds until the device is present (or gone), None on timeout."""
+        start = time.perf_counter()
+        deadline = start + timeout_s
+        while True:
+            if (self.find() is not None) == present:
+                return time.perf_counter() - start
+            remaining = deadline - time.perf_counter()
+            if remaining <= 0:
+                return None
+            if self._monitor is not None:
+                self._monitor.poll(timeout=min(remaining, 0.05))
+            else:
+                time.sleep(self._poll_s)
+
+    def wait_reenumeration(self, timeout_s: float) -> float | None:
+        """Seconds until the device has dropped off and come back, or None."""
+        gone = self.wait(False, timeout_s)
+        if gone is None:
+            return None
+        back = self.wait(True, timeout_s - gone)
+        return None if back is None else gone + back
+
+
+def touch_into_bootloader(port: str | None, timeout_s: float = 5.0) -> str | None:
+    """Reset a running application into the bootloader via a 1200 baud touch.
+
+    Returns the bootloader port once it answers 'V', or None.
+    """
+    if port is None:
+        port = BootloaderUploader().find_bootloader_port()
+        if port is None:
+            print("ERROR: No device found to touch")
+            return None
+
+    watcher = DeviceWatcher(port=port)
+    print(f"Touching {port} at {TOUCH_BAUD} baud...")
+    try:
+        s = serial.Serial(port=port, baudrate=TOUCH_BAUD)
+        s.close()
+    except serial.SerialException as e:
+        print(f"ERROR: Cannot open {port}: {e}")
+        return None
+
+    # The app resets ~10 ms after the touch; wait for it to drop off the bus
+    # so the version probe below cannot reach the app instead.
+    reenum = None
+    gone = watcher.wait(False, 1.0)
+    if gone is not None:
+        back = watcher.wait(True, timeout_s)
+        if back is not None:
+            reenum = gone + back
+            print(f"Re-enumerated in {reenum * 1000:.0f} ms")
+
+    # The node can exist a moment before udev has applied its permissions
+    version = get_version_with_retry(port, timeout_s=1.0 if reenum is not None else timeout_s,
+                                     poll_s=0.01, settle_s=0.0)
+    if not version:
+        print("ERROR: Bootloader did not enumerate after touch")
+        return None
+    print(f"Bootloader: {version}")
+    return port
+
+
+# Upper bucket edges (ms) of the --bench per-record latency histogram
+LATENCY_BUCKETS_MS = (0.25, 0.5, 1, 2, 5, 10, 20, 50, 100, 500)
+
+
+class UploadBench:
+    """Per-phase timing and per-record latency of one upload (--bench)."""
+
+    PHASES = ("connect", "version", "erase", "data", "verify", "jump", "reenum")
+
+    def __init__(self):
+        self.phases: dict[str, float] = {}
+        self.record_latency_s: list[float] = []
+        self.payload_bytes = 0
+        self.version = ""
+        self.mode = ""
+        self.counters: dict = {}
+        self.ok = False
+
+    @contextmanager
+    def phase(self, name: str):
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.phases[name] = time.perf_counter() - start
+
+    def summary(self) -> dict:
+        lat = sorted(self.record_latency_s)
+        data_s = self.phases.get("data", 0.0)
+        result: dict[str, object] = {
+            "ts": datetime.now().isoformat(timespec="seconds"),
+            "host": platform.node(),
+            "version": self.version,
+            "mode": self.mode,
+            "ok": self.ok,
+            "records": len(lat),
+            "payload_bytes": self.payload_bytes,
+            "payload_Bps": round(self.payload_bytes / data_s) if data_s > 0 else 0,
+        }
+        for name in self.PHASES:
+            value = self.phases.get(name)
+            result[f"{name}_s"] = round(value, 4) if value is not None else ""
+        result["total_s"] = round(sum(self.phases.values()), 4)
+        for pct in (50, 95, 99):
+            result[f"rec_p{pct}_ms"] = round(_percentile(lat, pct) * 1000.0, 3)
+        result["rec_max_ms"] = round(lat[-1] * 1000.0, 3) if lat else 0.0
+        for name in COUNTER_FIELDS:
+            result[f"cnt_{name}"] = self.counters.get(name, "")
+        return result
+
+    def histogram(self) -> list[int]:
+        counts = [0] * (len(LATENCY_BUCKETS_MS) + 1)
+        for value in self.record_latency_s:
+            ms = value * 1000.0
+            i = 0
+            while i < len(LATENCY_BUCKETS_MS) and ms > LATENCY_BUCKETS_MS[i]:
+                i += 1
+            counts[i] += 1
+        return counts
+
+
+def _percentile(sorted_values: list[float], pct: float) -> float:
+    """Nearest-rank percentile of an already sorted list."""
+    if not sorted_values:
+        return 0.0
+    k = max(0, math.ceil(pct / 100.0 * len(sorted_values)) - 1)
+    return sorted_values[k]
+
+
+def print_bench(runs: list[UploadBench]):
+    print(f"\n{'='*50}")
+    print(" Upload Benchmark")
+    print(f"{'='*50}")
+    for i, run in enumerate(runs, 1):
+        s = run.summary()
+        phases = " ".join(f"{n}={s[n + '_s']}" for n in UploadBench.PHASES if s[n + '_s'] != "")
+        print(f"Run {i}: {'OK' if s['ok'] else 'FAILED'} total={s['total_s']}s {phases}")
+        print(f"  {s['records']} records, {s['payload_bytes']} payload bytes, "
+              f"{s['payload_Bps']} B/s; record p50={s['rec_p50_ms']} p95={s['rec_p95_ms']} "
+              f"p99={s['rec_p99_ms']} max={s['rec_max_ms']} ms")
+    counts = [0] * (len(LATENCY_BUCKETS_MS) + 1)
+    for run in runs:
+        counts = [a + b for a, b in zip(counts, run.histogram())]
+    total = sum(counts) or 1
+    print("Record latency (all runs):")
+    labels = [f"<= {b:g} ms" for b in LATENCY_BUCKETS_MS] + [f" > {LATENCY_BUCKETS_MS[-1]:g} ms"]
+    for label, count in zip(labels, counts):
+        if count:
+            print(f"  {label:>11} {count:7d} {'#' * max(1, count * 40 // total)}")
+
+
+def print_profile(profile: dict):
+    """Time breakdown of a 'P' snapshot, in order of total time."""
+    elapsed = profile["elapsed"] or 1
+    us = 1e6 / FCY_HZ
+    print(f"Elapsed since clear: {elapsed / FCY_HZ:.3f} s")
+    print(f"  {'section':<17} {'count':>8} {'total ms':>10} {'%':>6} "
+          f"{'avg us':>9} {'min us':>9} {'max us':>9}")
+    for name, e in sorted(profile["sections"].items(), key=lambda kv: -kv[1]["total"]):
+        if not e["count"]:
+            continue
+        print(f"  {name:<17} {e['count']:8d} {e['total'] * us / 1000:10.3f} "
+              f"{100.0 * e['total'] / elapsed:6.2f} {e['total'] * us / e['count']:9.1f} "
+              f"{e['min'] * us:9.1f} {e['max'] * us:9.1f}")
+    # Sections nest: command covers hex_parse, cdc_tx and the flash/erase
+    # sections, and every main-loop section includes usb_isr preemption.
+    command = profile["sections"].get("command", {}).get("total", 0)
+    print(f"  outside commands: {100.0 * max(0, elapsed - command) / elapsed:.2f} % "
+          "(main loop polling and USB interrupts)")
+
+
+def rcon_names(rcon: int) -> str:
+    return "|".join(name for bit, name in RCON_BITS if rcon & (1 << bit)) or "-"
+
+
+def print_boot_log(events: list[dict]):
+    """One line per boot, oldest first."""
+    print(f"  {'seq':>4} {'path':<8} {'rcon':>6} {'cause':<16} {'app_stage':>9} {'bl_ms':>7}")
+    for e in events:
+        # An open entry that is not the current boot ended in an unexpected reset
+        time_ms = "open" if e["time_ms"] is None else str(e["time_ms"])
+        print(f"  {e['seq']:4d} {e['path']:<8} {e['rcon']:06X} {rcon_names(e['rcon']):<16} "
+              f"{e['app_stage']:9d} {time_ms:>7}")
+
+
+def _write_results(path: Path, doc: dict, rows: list[dict]):
+    """.json gets 'doc', anything else gets 'rows' appended as CSV."""
+    path.parent.mkdir(parents=True, exist_ok=True)
+    if path.suffix.lower() == ".json":
+        path.write_text(json.dumps(doc, indent=2) + "\n", encoding="utf-8")
+        return
+
+    with open(path, "a", newline="", encoding="utf-8") as f:
+        writer = csv.DictWriter(f, fieldnames=list(rows[0].keys()))
+        if f.tell() == 0:
+            writer.writeheader()
+        writer.writerows(rows)
+
+
+def write_bench(path: Path, runs: list[UploadBench], port: str | None, hexfile: Path):
+    """Write --bench results: .json gets full detail, anything else appends CSV rows."""
+    doc = {
+        "port": port,
+        "hexfile": str(hexfile),
+        "latency_buckets_ms": list(LATENCY_BUCKETS_MS),
+        "runs": [dict(run.summary(), histogram=run.histogram()) for run in runs],
+    }
+    rows = [dict(run.summary(), port=port or "", hexfile=str(hexfile)) for run in runs]
+    _write_results(path, doc, rows)
+
+
+def bench_link(port: str | None, nbytes: int, out: Path | None = None) -> bool:
+    """Raw CDC throughput ceiling: sink, source and echo 'L' tests (src/bl_link.h)."""
+    uploader = BootloaderUploader(port=port)
+    if not uploader.connect():
+        return False
+    try:
+        version = uploader.get_version() or ""
+        results = []
+        for mode in ("S", "O", "E"):
+            result = uploader.link_test(mode, nbytes)
+            if result is None:
+                print(f"ERROR: Link test {mode} failed (bootloader without 'L'?)")
+                return False
+            results.append(result)
+    finally:
+        uploader.disconnect()
+
+    print(f"\n{'='*50}")
+    print(f" CDC Link Benchmark ({nbytes} bytes)")
+    print(f"{'='*50}")
+    print(f"{'Mode':<8} {'Host B/s':>10} {'Device B/s':>11} {'Host s':>8}  Data")
+    for r in results:
+        print(f"{r['mode']:<8} {r['host_Bps']:>10} {r['device_Bps']:>11} {r['host_s']:>8}  "
+              f"{'ok' if r['ok'] else 'MISMATCH'}")
+
+    if out is not None:
+        ts = datetime.now().isoformat(timespec="seconds")
+        rows = [dict(r, ts=ts, host=platform.node(), version=version, port=uploader.port) for r in results]
+        _write_results(out, {"port": uploader.port, "version": version, "runs": rows}, rows)
+        print(f"Results written to {out}")
+    return all(r["ok"] for r in results)
+
+
+def _hex_record(rec_type: int, address: int, data: bytes) -> str:
+    raw = bytes([len(data), (address >> 8) & 0xFF, address & 0xFF, rec_type]) + data
+    return ":" + raw.hex().upper() + f"{(-sum(raw)) & 0xFF:02X}"
+
+
+def hex_image(records: list[str]) -> dict[int, int]:
+    """Data bytes of a record list keyed by HEX byte address (PC * 2). Raises ValueError."""
+    image: dict[int, int] = {}
+    upper = 0
+    for record in records:
+        raw = bytes.fromhex(record[1:])
+        if len(raw) < 5 or len(raw) != raw[0] + 5:
+            raise ValueError(f"malformed record {record[:20]}")
+        rec_type, address, data = raw[3], (raw[1] << 8) | raw[2], raw[4:-1]
+        if rec_type == 0x00:
+            for i, value in enumerate(data):
+                image[upper + address + i] = value
+        elif rec_type == 0x04 and len(data) == 2:
+            upper = ((data[0] << 8) | data[1]) << 16
+        elif rec_type == 0x02 and len(data) == 2:
+            upper = ((data[0] << 8) | data[1]) << 4
+    return image
+
+
+def check_image_fits(image: dict[int, int], status: dict) -> str | None:
+    """Why the image does not fit the device's application area, or None.
+
+    The bootloader skips program memory outside the area without an error,
+    so an image linked for another memory map would upload "fine" and not run.
+    """
+    app_start, app_end = status["app_start"], status["app_end"]
+    outside = sorted({(a // 4) * 2 for a in image
+                      if a < CONFIG_SPACE_BYTE_ADDRESS and not app_start <= (a // 4) * 2 <= app_end})
+    if not outside:
+        return None
+    return (f"{len(outside)} instructions outside the application area "
+            f"0x{app_start:05X}-0x{app_end:05X} (0x{outside[0]:05X} .. 0x{outside[-1]:05X})")
+
+
+def app_data_range(status: dict | None) -> range:
+    """PC addresses of the device's preserved application data, maybe empty.
+
+    The bootloader never erases or programs them (BL_APP_DATA_START in
+    src/bl_shared.h); older bootloaders do not advertise any.
+    """
+    start = (status or {}).get("app_data_start", 0)
+    return range(start, start + (status or {}).get("app_data_size", 0))
+
+
+def image_data_overlap(image: dict[int, int], data: range) -> list[int]:
+    """PC addresses of the image's instructions inside 'data', in order."""
+    return sorted({(a // 4) * 2 for a in image
+                   if a < CONFIG_SPACE_BYTE_ADDRESS and (a // 4) * 2 in data})
+
+
+def strip_data(image: dict[int, int], data: range) -> dict[int, int]:
+    """The image without its content inside 'data'."""
+    return {a: v for a, v in image.items()
+            if a >= CONFIG_SPACE_BYTE_ADDRESS or (a // 4) * 2 not in data}
+
+
+def fit_to_device(image: dict[int, int], status: dict, strip: bool) -> tuple[dict[int, int], str | None]:
+    """The image to upload to this device and a note on what was changed, if anything.
+
+    Raises ValueError for an image outside the application area or with
+    content in the preserved application data; with 'strip' that content is
+    dropped instead.
+    """
+    problem = check_image_fits(image, status)
+    if problem:
+        raise ValueError(f"Image does not fit this bootloader: {problem}")
+    data = app_data_range(status)
+    overlap = image_data_overlap(image, data)
+    if overlap and not strip:
+        raise ValueError(f"{len(overlap)} instructions in the preserved application data "
+                         f"0x{data.start:05X}-0x{data.stop - 1:05X} (0x{overlap[0]:05X} .. "
+                         f"0x{overlap[-1]:05X}); --strip-data uploads the image without them")
+    if overlap:
+        return strip_data(image, data), f"Stripping {len(overlap)} instructions in the preserved application data"
+    return image, None
+
+
+def fit_image(image: dict[int, int], status: dict, strip: bool) -> dict[int, int] | None:
+    """fit_to_device with the reason printed: the image to upload, or None."""
+    try:
+        image, note = fit_to_device(image, status, strip)
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return None
+    if note:
+        print(note)
+    return image
+
+
+def has_mac(image: dict[int, int]) -> bool:
+    """Whether the image carries a signature for BL_AUTH bootloaders (sign_image.py)."""
+    return all(a in image for a in range(2 * AUTH_MAC_ADDRESS, 2 * AUTH_MAC_ADDRESS + AUTH_MAC_SIZE))
+
+
+def row_bytes(image: dict[int, int], pc: int) -> bytes:
+    """One row as 3-byte instructions, low byte first, 0xFF where the image has none."""
+    data = bytearray()
+    for k in range(ROW_INSTRUCTIONS):
+        address = (pc + 2 * k) * 2
+        data += bytes(image.get(address + b, 0xFF) for b in range(3))
+    return bytes(data)
+
+
+def pack_records(image: dict[int, int], max_bytes: int) -> list[str]:
+    """Re-emit an image as the longest records the device takes, in address order.
+
+    Records hold whole instructions and never cross a 64 KB boundary; gaps
+    inside an instruction are filled with the erased value.
+    """
+    max_insns = max(1, max_bytes // 4)
+    insns = sorted({a & ~3 for a in image})
     records = []
-    
-    with open(filepath, 'r') as f:
-        for line in f:
-            line = line.strip()
-            if line.startswith(':'):
-                records.append(line)
-    
+    upper = None
+    i = 0
+    while i < len(insns):
+        start = insns[i]
+        n = 1
+        while (i + n < len(insns) and n < max_insns and insns[i + n] == start + 4 * n
+               and (start + 4 * n) >> 16 == start >> 16):
+            n += 1
+        if start >> 16 != upper:
+            upper = start >> 16
+            records.append(_hex_record(0x04, 0, bytes([upper >> 8, upper & 0xFF])))
+        data = bytes(image.get(start + k, 0x00 if k % 4 == 3 else 0xFF) for k in range(4 * n))
+        records.append(_hex_record(0x00, start & 0xFFFF, data))
+        i += n
+    records.append(_hex_record(0x01, 0, b""))
     return records
 
 
+def image_crc(image: dict[int, int], app_start: int, app_end: int) -> int:
+    """CRC-32 of the application area as the staging store computes it.
+
+    3 bytes per instruction, low byte first, 0xFF where the image has none
+    (src/bl_stage.h). Also the CRC of internal flash after an install. The
+    preserved application data counts as erased, so strip it first.
+    """
+    data = bytearray()
+    for pc in range(app_start, app_end + 1, 2):
+        address = pc * 2
+        data += bytes(image.get(address + k, 0xFF) for k in range(3))
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+def select_upload_mode(status: dict | None, records: list[str], requested: str = "auto") -> str:
+    """Fastest data mode the device supports, capped at 'requested'."""
+    supported = ["basic"]
+    if status and status.get("max_record_bytes", 0) > 0:
+        longest = max((int(r[1:3], 16) for r in records if r[7:9] == "00"), default=0)
+        if status["max_record_bytes"] > longest:
+            supported.append("packed")
+            if "hex_window" in status.get("caps", []) and status.get("window_depth", 1) > 1:
+                supported.append("windowed")
+    if requested == "auto":
+        return supported[-1]
+    if requested not in supported:
+        print(f"WARNING: Bootloader does not support '{requested}' mode, using '{supported[-1]}'")
+        return supported[-1]
+    return requested
+
+
+def hex_record_error(record: str) -> str | None:
+    """What is wrong with one Intel HEX record line, or None."""
+    try:
+        raw = bytes.fromhex(record[1:])
+    except ValueError:
+        return "not hex digits"
+    if len(raw) < 5 or len(raw) != raw[0] + 5:
+        return "length does not match the byte count"
+    if sum(raw) & 0xFF:
+        return "bad checksum"
+    return None
+
+
+def parse_hex_lines(lines, source) -> list[str]:
+    """The records of an Intel HEX file's lines. Raises ValueError on a bad record.
+
+    Lines that do not start with ':' are skipped.
+    """
+    records = []
+    for number, line in enumerate(lines, 1):
+        line = line.strip()
+        if not line.startswith(':'):
+            continue
+        problem = hex_record_error(line)
+        if problem:
+            raise ValueError(f"{source} line {number}: {problem}")
+        records.append(line)
+    return records
+
+
+class UploadPlan:
+    """What one device gets: the fitted image, its records and the data mode."""
+
+    def __init__(self, image: dict[int, int], records: list[str], mode: str, window: int,
+                 notes: list[str]):
+        self.image = image
+        self.records = records
+        self.mode = mode
+        self.window = window
+        self.notes = notes
+
+
+def plan_upload(image: dict[int, int], records: list[str], status: dict | None,
+                strip: bool = False, mode: str = "auto") -> UploadPlan:
+    """Fit an image to a device's status record and pick its data mode.
+
+    The checks every upload path makes before erasing: the memory map and
+    preserved application data (fit_to_device), a signature for 'auth'
+    devices and the fastest mode up to 'mode' (select_upload_mode). Raises
+    ValueError if the device must not get the image.
+    """
+    notes = []
+    if status and "app_start" in status:
+        fitted, note = fit_to_device(image, status, strip)
+        if note:
+            notes.append(note)
+        if fitted is not image:
+            image = fitted
+            records = pack_records(image, 16)     # plain 16-byte records, as HEX files hold
+    else:
+        notes.append("WARNING: Bootloader has no status record; memory map not checked")
+    if "auth" in (status or {}).get("caps", []) and not has_mac(image):
+        raise ValueError("Bootloader takes signed images only (tools/sign_image.py)")
+
+    mode = select_upload_mode(status, records, mode)
+    window = 1
+    if mode != "basic":
+        records = pack_records(image, status["max_record_bytes"])
+    if mode == "windowed":
+        window = status["window_depth"]
+    return UploadPlan(image, records, mode, window, notes)
+
+
+class PreparedImage:
+    """A parsed HEX file shared read-only by every device it goes to (--fleet, bl_daemon.py).
+
+    Plans are cached by the status fields they depend on, so a set of
+    identical boards fits and packs the image once. Raises ValueError.
+    """
+
+    PLAN_FIELDS = ("capabilities", "app_start", "app_end", "app_data_start", "app_data_size",
+                   "max_record_bytes", "window_depth")
+
+    def __init__(self, records: list[str]):
+        self.records = records
+        self.image = hex_image(records)
+        self._plans: dict[tuple, UploadPlan] = {}
+        self._lock = threading.Lock()
+
+    def plan(self, status: dict | None, strip: bool = False, mode: str = "auto") -> UploadPlan:
+        key = (strip, mode, status is None) + tuple((status or {}).get(f) for f in self.PLAN_FIELDS)
+        with self._lock:
+            plan = self._plans.get(key)
+            if plan is None:
+                plan = plan_upload(self.image, self.records, status, strip, mode)
+                self._plans[key] = plan
+        return plan
+
+
+def parse_hex_file(filepath: Path) -> list[str]:
+    """Parse an Intel HEX file and return list of records. Raises ValueError on a bad record."""
+    with open(filepath, 'r') as f:
+        return parse_hex_lines(f, filepath)
+
+
 def upload_firmware(hexfile: Path, port: str = None, verify: bool = True, 
-                   jump_to_app: bool = True) -> bool:
-    """Upload firmware to the bootloader."""
+                   jump_to_app: bool = True, bench: UploadBench = None,
+                   mode: str = "auto", stage: bool = False, strip: bool = False) -> bool:
+    """Upload firmware to the bootloader.
+
+    With 'bench', phase times and per-record latencies are recorded into it.
+    'mode' caps the data transfer mode (UPLOAD_MODES); "auto" picks the
+    fastest one the bootloader's status record advertises. With 'stage' the
+    image goes to the device's SPI NOR staging store first and is installed
+    from there once its CRC checks out. An image with content in the
+    device's preserved application data is refused, or with 'strip'
+    uploaded without it.
+    """
+    measure_reenum = bench is not None
+    if bench is None:
+        bench = UploadBench()
     
     print(f"\n{'='*50}")
     print(" PIC24 Bootloader Firmware Upload")
@@ -187,29 +1074,63 @@ def upload_firmware(hexfile: Path, port: str = None, verify: bool = True,
         print(f"ERROR: File not found: {hexfile}")
         return False
     
-    records = parse_hex_file(hexfile)
+    try:
+        records = parse_hex_file(hexfile)
+        image = hex_image(records)
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return False
     if not records:
         print("ERROR: No valid records in HEX file")
         return False
-    
+
     print(f"HEX records: {len(records)}")
     
     # Connect to bootloader
     uploader = BootloaderUploader(port=port)
     
-    if not uploader.connect():
+    with bench.phase("connect"):
+        connected = uploader.connect()
+    if not connected:
         return False
     
     try:
         # Get version
-        version = uploader.get_version()
+        with bench.phase("version"):
+            version = uploader.get_version()
         if version:
             print(f"Bootloader: {version}")
+            bench.version = version
         else:
             print("WARNING: Could not get bootloader version")
+
+        # Memory map and transfer limits (older bootloaders answer '?')
+        status = uploader.get_status()
+        try:
+            plan = plan_upload(image, records, status, strip, mode)
+        except ValueError as e:
+            print(f"ERROR: {e}")
+            return False
+        for note in plan.notes:
+            print(note)
+        if stage and "staging" not in (status or {}).get("caps", []):
+            print("ERROR: Bootloader has no staging store (no SPI NOR fitted?)")
+            return False
+
+        image, records, mode, window = plan.image, plan.records, plan.mode, plan.window
+        bench.mode = mode
+        print(f"Mode: {mode} ({len(records)} records, window {window})")
+
+        # Counters cover this upload only (older bootloaders answer '?')
+        uploader.clear_counters()
         
-        # Erase application area
-        if not uploader.erase_application():
+        # Erase application area, or the staging slot the image goes to
+        with bench.phase("erase"):
+            if stage:
+                erased = uploader.stage_command("TB", "Erasing staging slot", 10.0)
+            else:
+                erased = uploader.erase_application()
+        if not erased:
             print("ERROR: Erase failed")
             return False
         
@@ -218,6 +1139,8 @@ def upload_firmware(hexfile: Path, port: str = None, verify: bool = True,
         
         errors = 0
         bytes_sent = 0
+        in_flight: deque = deque()
+        data_start = time.perf_counter()
         for i, record in enumerate(records):
             # Parse record to show address info
             if record.startswith(':') and len(record) >= 11:
@@ -225,36 +1148,69 @@ def upload_firmware(hexfile: Path, port: str = None, verify: bool = True,
                 rec_addr = int(record[3:7], 16)
                 rec_len = int(record[1:3], 16)
                 bytes_sent += rec_len
+                if rec_type == 0x00:
+                    bench.payload_bytes += rec_len
             
-            if not uploader.send_hex_record(record):
-                errors += 1
-                print(f"\n  ERROR on record {i}: {record[:30]}...")
-                if errors > 5:
-                    print(f"\nERROR: Too many errors, aborting")
+            # Up to 'window' records in flight; window 1 is stop-and-wait
+            uploader.write_line(record)
+            in_flight.append((i, record, time.perf_counter()))
+            while in_flight and (len(in_flight) >= window or i == len(records) - 1):
+                sent_index, sent_record, rec_start = in_flight.popleft()
+                sent, reply = uploader.read_reply()
+                bench.record_latency_s.append(time.perf_counter() - rec_start)
+                if not sent and reply.startswith("Auth failed"):
+                    print("\nERROR: Bootloader rejected the image signature; the application "
+                          "is not bootable")
                     return False
+                if not sent:
+                    errors += 1
+                    print(f"\n  ERROR on record {sent_index}: {sent_record[:30]}...")
+                    if errors > 5:
+                        print(f"\nERROR: Too many errors, aborting")
+                        return False
             
             # Progress indicator every 100 records or on specific types
             if (i + 1) % 100 == 0 or i == len(records) - 1:
                 pct = (i + 1) * 100 // len(records)
                 print(f"\r  Progress: {i+1}/{len(records)} ({pct}%) - {bytes_sent} bytes", end="", flush=True)
         
+        bench.phases["data"] = time.perf_counter() - data_start
         print()  # Newline after progress
         
+        if stage:
+            crc = image_crc(image, status["app_start"], status["app_end"])
+            with bench.phase("verify"):
+                staged = uploader.stage_command(f"TC{crc:08X}", f"Checking staged image (CRC {crc:08X})", 10.0)
+            if not staged:
+                return False
+            with bench.phase("install"):
+                installed = uploader.stage_command("TI", "Installing from staging store", 30.0)
+            if not installed:
+                return False
+
         # Verify
-        if verify:
+        elif verify:
             print("Verifying...", end=" ", flush=True)
-            success, result = uploader.verify_complete()
+            with bench.phase("verify"):
+                success, result = uploader.verify_complete()
             if success:
                 print(f"OK - {result}")
             else:
                 print(f"FAILED: {result}")
                 return False
+
+        counters = uploader.get_counters()
+        if counters:
+            bench.counters = counters
+            print("Counters: " + " ".join(f"{k}={v}" for k, v in counters.items() if k != "version"))
         
         # Jump to application
         if jump_to_app:
             time.sleep(0.2)
-            uploader.jump_to_app()
+            with bench.phase("jump"):
+                uploader.jump_to_app()
         
+        bench.ok = True
         print(f"\n{'='*50}")
         print(" UPLOAD SUCCESSFUL")
         print(f"{'='*50}\n")
@@ -266,62 +1222,598 @@ def upload_firmware(hexfile: Path, port: str = None, verify: bool = True,
     
     finally:
         uploader.disconnect()
+        if measure_reenum and bench.ok and jump_to_app and uploader.port:
+            # Detach of the bootloader until the app's port is back
+            reenum = DeviceWatcher(port=uploader.port).wait_reenumeration(5.0)
+            if reenum is not None:
+                bench.phases["reenum"] = reenum
 
 
-def _parse_version_fields(version_line: str) -> dict:
-    """Extract numeric fields from a single-line bootloader version response."""
-    if not version_line:
-        return {}
-    fields: dict[str, object] = {}
-
-    # Examples:
-    #   BLv1.2 SJ=49159 JRC=2 CC=27423
-    #   BLv1.2 SJ=... JRC=... CC=... RC=00A4
-    patterns = {
-        "sj": r"\bSJ=(\d+)",
-        "jrc": r"\bJRC=(\d+)",
-        "cc": r"\bCC=(\d+)",
-        "rc": r"\bRC=([0-9A-Fa-f]+)",
-    }
+def read_device_crcs(uploader: BootloaderUploader, rows: list[int]) -> list[int] | None:
+    """Device CRC of each row in 'rows' (consecutive program rows)."""
+    crcs = []
+    for i in range(0, len(rows), CRC_MAP_ROWS):
+        chunk = uploader.read_crc_map(rows[i], min(CRC_MAP_ROWS, len(rows) - i))
+        if chunk is None:
+            print(f"ERROR: Could not read the CRC map at 0x{rows[i]:05X}")
+            return None
+        crcs += chunk
+    return crcs
 
-    for key, pattern in patterns.items():
-        match = re.search(pattern, version_line)
-        if not match:
+
+def patch_device(uploader: BootloaderUploader, image: dict[int, int], status: dict) -> bool:
+    """Bring the device's application area up to 'image' in place.
+
+    Rows whose device CRC matches are left alone. In the others, instructions
+    that only clear bits are programmed one by one ('W', no erase); a page
+    with any other change is erased ('E<addr>') and its rows sent again.
+    """
+    row_pc, page_pc = status["row_size"] * 2, status["page_size"] * 2
+    data = app_data_range(status)
+    rows = list(range(status["app_start"], status["app_end"] + 2, row_pc))
+    crcs = read_device_crcs(uploader, rows)
+    if crcs is None:
+        return False
+    changed = [pc for pc, crc in zip(rows, crcs)
+               if pc not in data and zlib.crc32(row_bytes(image, pc)) != crc]
+    if not changed:
+        print("Device already holds this image")
+        return True
+
+    words: dict[int, int] = {}
+    pages: set[int] = set()
+    for pc in changed:
+        old = uploader.read_row(pc)
+        if old is None:
+            print(f"ERROR: Could not read row 0x{pc:05X}")
+            return False
+        new = row_bytes(image, pc)
+        for k in range(ROW_INSTRUCTIONS):
+            before = int.from_bytes(old[3 * k:3 * k + 3], "little")
+            after = int.from_bytes(new[3 * k:3 * k + 3], "little")
+            if after & ~before:
+                pages.add(pc - pc % page_pc)
+            elif after != before:
+                words[pc + 2 * k] = after
+    words = {pc: w for pc, w in words.items() if pc - pc % page_pc not in pages}
+    print(f"{len(changed)} rows differ: {len(words)} instructions to patch, "
+          f"{len(pages)} pages to rewrite")
+
+    # Runs of consecutive instructions, as many as fit one command line
+    max_words = (status["max_line"] - 7) // 6
+    runs: list[tuple[int, list[int]]] = []
+    for pc in sorted(words):
+        if runs and pc == runs[-1][0] + 2 * len(runs[-1][1]) and len(runs[-1][1]) < max_words:
+            runs[-1][1].append(words[pc])
+        else:
+            runs.append((pc, [words[pc]]))
+    for start, run in runs:
+        ok, reply = uploader.send_command(f"W{start:06X}" + "".join(f"{w:06X}" for w in run))
+        if not ok:
+            print(f"ERROR: Patch at 0x{start:05X} failed: {reply}")
+            return False
+
+    if pages:
+        for page in sorted(pages):
+            if not uploader.stage_command(f"E{page:06X}", f"Erasing page 0x{page:05X}", 5.0):
+                return False
+        page_image = {a: v for a, v in image.items()
+                      if a < CONFIG_SPACE_BYTE_ADDRESS and (a // 4) * 2 - (a // 4) * 2 % page_pc in pages}
+        records = pack_records(page_image, status["max_record_bytes"])
+        print(f"Uploading {len(records)} records...")
+        for record in records:
+            ok, reply = uploader.send_command(record)
+            if not ok:
+                print(f"ERROR: Record {record[:30]}... failed: {reply}")
+                return False
+
+    print("Verifying...", end=" ", flush=True)
+    crcs = read_device_crcs(uploader, rows)
+    if crcs is None:
+        return False
+    wrong = [pc for pc, crc in zip(rows, crcs)
+             if pc not in data and zlib.crc32(row_bytes(image, pc)) != crc]
+    if wrong:
+        print(f"FAILED: {len(wrong)} rows differ (first 0x{wrong[0]:05X})")
+        return False
+    print("OK")
+    return True
+
+
+def delta_ops(target: list[int], flash: list[int | None], first: int, max_literal: int) -> list[bytes]:
+    """Operations that rebuild 'target' (one page of instructions) from 'flash'.
+
+    'flash' is the device's application area as it is now, one instruction
+    per entry from instruction index 'first' (PC address / 2), None where
+    the content is not known. Greedy: the longest copy found through a
+    DELTA_SEED-instruction index, runs of erased instructions, literals for
+    the rest. See src/bl_delta.h for the encoding.
+    """
+    index: dict[tuple, list[int]] = {}
+    for k in range(len(flash) - DELTA_SEED + 1):
+        seed = tuple(flash[k:k + DELTA_SEED])
+        if None not in seed and seed != (ERASED_INSTRUCTION,) * DELTA_SEED:
+            index.setdefault(seed, []).append(k)
+
+    ops: list[bytes] = []
+    literal: list[int] = []
+
+    def flush():
+        for i in range(0, len(literal), max_literal):
+            chunk = literal[i:i + max_literal]
+            ops.append(bytes([len(chunk) - 1]) + b"".join(w.to_bytes(3, "little") for w in chunk))
+        literal.clear()
+
+    i = 0
+    while i < len(target):
+        n = 0
+        while i + n < len(target) and target[i + n] == ERASED_INSTRUCTION:
+            n += 1
+        if n:
+            flush()
+            ops.append(bytes([DELTA_OP_ERASED | (n - 1) >> 8, (n - 1) & 0xFF]))
+            i += n
             continue
-        value_str = match.group(1)
-        if key == "rc":
-            try:
-                fields[key] = int(value_str, 16)
-            except ValueError:
-                fields[key] = value_str
+        best, source = 0, 0
+        for k in index.get(tuple(target[i:i + DELTA_SEED]), [])[-DELTA_CANDIDATES:]:
+            n = 0
+            while i + n < len(target) and k + n < len(flash) and flash[k + n] == target[i + n]:
+                n += 1
+            if n > best:
+                best, source = n, k
+        if best:
+            flush()
+            ops.append(bytes([DELTA_OP_COPY | (best - 1) >> 8, (best - 1) & 0xFF])
+                       + (first + source).to_bytes(2, "little"))
+            i += best
         else:
-            fields[key] = int(value_str)
+            literal.append(target[i])
+            i += 1
+    flush()
+    return ops
+
 
-    return fields
+def delta_device(uploader: BootloaderUploader, image: dict[int, int], status: dict,
+                 base: dict[int, int] | None = None) -> bool:
+    """Bring the device's application area up to 'image' with delta pages ('D').
 
+    The host's copy of the device flash comes from the image itself for rows
+    whose device CRC already matches it, from 'base' (the image the device
+    was last given, if known) for rows that match that, and from reading the
+    row back otherwise. Pages go in address order, the application's first
+    page (reset vector) last.
+    """
+    row_pc, page_pc = status["row_size"] * 2, status["page_size"] * 2
+    data = app_data_range(status)
+    start, end = status["app_start"], status["app_end"] + 2
+    rows = list(range(start, end, row_pc))
+    crcs = read_device_crcs(uploader, rows)
+    if crcs is None:
+        return False
+
+    flash: list[int | None] = []
+    pages: list[int] = []
+    read_back = 0
+    for pc, crc in zip(rows, crcs):
+        new = row_bytes(image, pc)
+        if zlib.crc32(new) == crc:
+            known = new
+        elif pc in data:
+            known = None
+        elif base is not None and zlib.crc32(row_bytes(base, pc)) == crc:
+            known = row_bytes(base, pc)
+        else:
+            known = uploader.read_row(pc)
+            if known is None:
+                print(f"ERROR: Could not read row 0x{pc:05X}")
+                return False
+            read_back += 1
+        if known is None:
+            flash += [None] * ROW_INSTRUCTIONS
+        else:
+            flash += [int.from_bytes(known[3 * k:3 * k + 3], "little") for k in range(ROW_INSTRUCTIONS)]
+        if known != new and pc not in data and pc - pc % page_pc not in pages:
+            pages.append(pc - pc % page_pc)
+    if not pages:
+        print("Device already holds this image")
+        return True
+    pages.sort(key=lambda page: (page == start, page))
+    print(f"{len(pages)} pages differ ({read_back} rows read back)")
+
+    payload = (status["max_line"] - 2) // 2
+    max_literal = min(DELTA_LITERAL_MAX, (payload - 1) // 3)
+    page_insns = page_pc // 2
+    sent = 0
+    for page in pages:
+        target = []
+        for pc in range(page, page + page_pc, row_pc):
+            new = row_bytes(image, pc)
+            target += [int.from_bytes(new[3 * k:3 * k + 3], "little") for k in range(ROW_INSTRUCTIONS)]
+        lines = [f"DO{page:06X}"]
+        chunk = b""
+        for op in delta_ops(target, flash, start // 2, max_literal):
+            if len(chunk) + len(op) > payload:
+                lines.append("DD" + chunk.hex().upper())
+                chunk = b""
+            chunk += op
+        lines.append("DD" + chunk.hex().upper())
+        packed = b"".join(w.to_bytes(3, "little") for w in target)
+        lines.append(f"DC{zlib.crc32(packed):08X}")
+        for line in lines:
+            ok, reply = uploader.send_command(line)
+            if not ok:
+                print(f"ERROR: Delta for page 0x{page:05X} failed at {line[:12]}: {reply}")
+                return False
+            sent += len(line) + 2
+        offset = (page - start) // 2
+        flash[offset:offset + page_insns] = target
+
+    full = sum(len(record) + 2 for record in pack_records(
+        {a: v for a, v in image.items()
+         if a < CONFIG_SPACE_BYTE_ADDRESS and (a // 4) * 2 - (a // 4) * 2 % page_pc in pages},
+        status["max_record_bytes"]))
+    print(f"Sent {sent} bytes for {len(pages)} pages ({full} as HEX records)")
+
+    print("Verifying...", end=" ", flush=True)
+    crcs = read_device_crcs(uploader, rows)
+    if crcs is None:
+        return False
+    wrong = [pc for pc, crc in zip(rows, crcs)
+             if pc not in data and zlib.crc32(row_bytes(image, pc)) != crc]
+    if wrong:
+        print(f"FAILED: {len(wrong)} rows differ (first 0x{wrong[0]:05X})")
+        return False
+    print("OK")
+    return True
+
+
+def patch_firmware(hexfile: Path, port: str = None, jump_to_app: bool = True,
+                   strip: bool = False, delta: bool = False, base: Path | None = None) -> bool:
+    """Update the device to 'hexfile' with as few flash writes as possible.
+
+    See patch_device; with 'delta', delta_device against 'base' (the HEX file
+    the device was last given, optional). Needs the bootloader's 'patch'
+    capability, and 'delta' for a delta update.
+    """
+    print(f"\n{'='*50}")
+    print(" PIC24 Bootloader Firmware " + ("Delta Update" if delta else "Patch"))
+    print(f"{'='*50}")
+    print(f"File: {hexfile}")
+
+    if not hexfile.exists():
+        print(f"ERROR: File not found: {hexfile}")
+        return False
+    try:
+        image = hex_image(parse_hex_file(hexfile))
+        base_image = hex_image(parse_hex_file(base)) if base else None
+    except (OSError, ValueError) as e:
+        print(f"ERROR: {e}")
+        return False
 
-def _get_version_once(port: str | None) -> str | None:
     uploader = BootloaderUploader(port=port)
     if not uploader.connect():
-        return None
+        return False
     try:
-        return uploader.get_version()
+        status = uploader.get_status()
+        needed = "delta" if delta else "patch"
+        if not status or needed not in status.get("caps", []):
+            print(f"ERROR: Bootloader has no '{needed}' capability (older, -Small or -Auth build)")
+            return False
+        image = fit_image(image, status, strip)
+        if image is None:
+            return False
+
+        uploader.clear_counters()
+        start = time.perf_counter()
+        if delta:
+            done = delta_device(uploader, image, status, base_image)
+        else:
+            done = patch_device(uploader, image, status)
+        if not done:
+            return False
+        print(f"{'Delta applied' if delta else 'Patched'} in {time.perf_counter() - start:.2f} s")
+
+        counters = uploader.get_counters()
+        if counters:
+            print("Counters: " + " ".join(f"{k}={v}" for k, v in counters.items() if k != "version"))
+        if jump_to_app:
+            time.sleep(0.2)
+            uploader.jump_to_app()
+
+        print(f"\n{'='*50}")
+        print(" DELTA UPDATE SUCCESSFUL" if delta else " PATCH SUCCESSFUL")
+        print(f"{'='*50}\n")
+        return True
+
+    except Exception as e:
+        print(f"\nERROR: {e}")
+        return False
+
     finally:
         uploader.disconnect()
 
 
-def get_version_with_retry(port: str | None, timeout_s: float = 3.0, poll_s: float = 0.3) -> str | None:
-    """Try to connect+read version for up to timeout_s. Returns None if unreachable."""
+class FleetDevice:
+    """State of one port in --fleet mode, updated by its worker thread."""
+
+    def __init__(self, port: str):
+        self.port = port
+        self.state = "queued"
+        self.done = 0
+        self.attempts = 0
+        self.ok = False
+        self.error = ""
+        self.version = ""
+        self.mode = ""
+        self.total = 0
+        self.elapsed = 0.0
+
+
+def by_id_path(device: str) -> str:
+    """/dev/serial/by-id name of a Linux tty (stable across re-enumeration), else 'device'."""
+    real = os.path.realpath(device)
+    for link in glob.glob('/dev/serial/by-id/*'):
+        if os.path.realpath(link) == real:
+            return link
+    return device
+
+
+def find_bootloader_ports() -> list[str]:
+    """All ports that look like a bootloader, sorted by name.
+
+    Linux ports are returned by their /dev/serial/by-id name, which carries
+    the board's USB serial number.
+    """
+    return sorted(by_id_path(p.device) for p in serial.tools.list_ports.comports()
+                  if BootloaderUploader.is_bootloader_port(p))
+
+
+def send_image(uploader: BootloaderUploader, records: list[str], window: int = 1,
+               verify: bool = True, jump: bool = True, progress=None) -> str:
+    """Erase, send 'records', verify and jump on an open uploader, without console output.
+
+    The upload of --fleet and bl_daemon.py. Up to 'window' records are in
+    flight. 'progress(state, records_done)' is called as the upload goes.
+    Returns the verify reply (or a record count); raises RuntimeError.
+    """
+    def report(state: str, done: int = 0):
+        if progress is not None:
+            progress(state, done)
+
+    report("erase")
+    uploader.serial.timeout = 10.0
+    ok, response = uploader.send_command('E')
+    uploader.serial.timeout = uploader.timeout
+    if not ok:
+        raise RuntimeError(f"erase failed: {response}")
+
+    report("data")
+    in_flight: deque = deque()
+    for i, record in enumerate(records):
+        uploader.write_line(record)
+        in_flight.append(i)
+        while in_flight and (len(in_flight) >= window or i == len(records) - 1):
+            sent = in_flight.popleft()
+            ok, response = uploader.read_reply()
+            if not ok:
+                for _ in in_flight:
+                    uploader.read_reply()   # keep replies in step for the next command
+                if response.startswith("Auth failed"):
+                    raise RuntimeError("image signature rejected")
+                raise RuntimeError(f"record {sent} rejected: {response}")
+            report("data", sent + 1)
+
+    result = f"{len(records)} records"
+    if verify:
+        report("verify")
+        ok, response = uploader.verify_complete()
+        if not ok:
+            raise RuntimeError(f"verify failed: {response}")
+        result = response
+
+    if jump:
+        report("jump")
+        uploader.send_command('J')
+    return result
+
+
+def _flash_device(dev: FleetDevice, prepared: PreparedImage, verify: bool, jump: bool,
+                  strip: bool, mode: str):
+    """One upload attempt on dev.port.
+
+    Raises RuntimeError on failure, ValueError if the device must not get
+    the image (plan_upload).
+    """
+    uploader = BootloaderUploader(port=dev.port, verbose=False)
+    dev.state = "connect"
+    if not uploader.connect():
+        raise RuntimeError("cannot open port")
+    try:
+        dev.state = "version"
+        dev.version = uploader.get_version() or ""
+        if not dev.version:
+            raise RuntimeError("no version response")
+
+        dev.state = "status"
+        plan = prepared.plan(uploader.get_status(), strip, mode)
+        dev.mode, dev.total = plan.mode, len(plan.records)
+
+        def progress(state: str, done: int):
+            dev.state, dev.done = state, done
+
+        send_image(uploader, plan.records, plan.window, verify, jump, progress)
+    finally:
+        uploader.disconnect()
+
+
+def _fleet_worker(dev: FleetDevice, prepared: PreparedImage, verify: bool, jump: bool,
+                  strip: bool, mode: str, retries: int):
+    start = time.perf_counter()
+    while dev.attempts <= retries and not dev.ok:
+        dev.attempts += 1
+        try:
+            _flash_device(dev, prepared, verify, jump, strip, mode)
+            dev.ok = True
+            dev.error = ""
+        except ValueError as e:
+            dev.error = str(e)      # refused before erasing: a retry would not help
+            break
+        except (RuntimeError, serial.SerialException, OSError) as e:
+            dev.error = str(e)
+            time.sleep(0.5)
+    dev.state = "pass" if dev.ok else "FAIL"
+    dev.elapsed = time.perf_counter() - start
+
+
+def fleet_upload(hexfile: Path, ports: list[str] | None, verify: bool = True,
+                 jump_to_app: bool = True, retries: int = 2, strip: bool = False,
+                 mode: str = "auto") -> bool:
+    """Upload the same image to several bootloaders concurrently, one thread per port.
+
+    Each device gets the checks and data mode of a single upload (plan_upload).
+    """
+    if not hexfile.exists():
+        print(f"ERROR: File not found: {hexfile}")
+        return False
+
+    # Parsed once and shared read-only by every worker
+    try:
+        records = parse_hex_file(hexfile)
+        prepared = PreparedImage(records)
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return False
+    if not records:
+        print("ERROR: No valid records in HEX file")
+        return False
+
+    if not ports:
+        ports = find_bootloader_ports()
+    if not ports:
+        print("ERROR: No bootloader ports found")
+        return False
+
+    print(f"\n{'='*50}")
+    print(f" Fleet upload: {len(ports)} devices, {len(records)} records")
+    print(f"{'='*50}")
+
+    devices = [FleetDevice(port) for port in ports]
+    threads = [threading.Thread(target=_fleet_worker,
+                                args=(dev, prepared, verify, jump_to_app, strip, mode, retries),
+                                name=dev.port, daemon=True)
+               for dev in devices]
+    start = time.perf_counter()
+    for t in threads:
+        t.start()
+
+    while any(t.is_alive() for t in threads):
+        status = []
+        for dev in devices:
+            if dev.state == "data" and dev.total:
+                status.append(f"{dev.port}:{dev.done * 100 // dev.total}%")
+            else:
+                status.append(f"{dev.port}:{dev.state}")
+        print("\r  " + " ".join(status), end="", flush=True)
+        time.sleep(0.25)
+    for t in threads:
+        t.join()
+    total = time.perf_counter() - start
+    print()
+
+    print(f"\n{'Port':<16} {'Result':<6} {'Tries':>5} {'Time':>7}  Detail")
+    for dev in devices:
+        detail = dev.error if not dev.ok else f"{dev.version} ({dev.mode})"
+        print(f"{dev.port:<16} {dev.state:<6} {dev.attempts:>5} {dev.elapsed:>6.1f}s  {detail}")
+    passed = sum(1 for dev in devices if dev.ok)
+    print(f"\n{passed}/{len(devices)} passed in {total:.1f}s")
+    return passed == len(devices)
+
+
+def _loop_columns(prefix: str, status: dict) -> dict:
+    """--ralph-loop CSV columns from a status record ({} if unreachable)."""
+    return {
+        f"{prefix}_sj": status.get("stub_to_app", ""),
+        f"{prefix}_jrc": status.get("jump_returns", ""),
+        f"{prefix}_rc": status.get("last_rcon", ""),
+    }
+
+
+def print_status(status: dict):
+    for key, value in status.items():
+        if key == "capabilities":
+            value = f"0x{value:04X}"
+        elif key in ("app_start", "app_end", "app_data_start", "app_data_size"):
+            value = f"0x{value:05X}"
+        elif key.endswith("rcon"):
+            value = f"0x{value:04X} ({rcon_names(value)})"
+        elif key == "caps":
+            value = ", ".join(value) or "-"
+        print(f"  {key:<17} {value}")
+
+
+def print_stage_info(info: dict):
+    jedec_id = info["jedec_id"]
+    print(f"  NOR JEDEC ID   {f'{jedec_id:06X}' if jedec_id else 'none'}")
+    for i, slot in enumerate(info["slots"]):
+        marks = [m for m, on in (("newest", info["newest"] == i),
+                                 ("receiving", info["receiving"] == i)) if on]
+        if slot["valid"]:
+            text = f"seq={slot['seq']} crc={slot['crc']:08X} app_start=0x{slot['app_start']:05X}"
+        else:
+            text = "empty"
+        print(f"  slot {i}         {text}{'  (' + ', '.join(marks) + ')' if marks else ''}")
+
+
+def print_golden_info(info: dict):
+    if not info["available"]:
+        print("  golden image   no SPI NOR of 256 KB or more")
+    elif info["valid"]:
+        image_bytes = info["rows"] * 64 * 3
+        ratio = f"{100 * info['length'] / image_bytes:.0f}%" if image_bytes else "-"
+        print(f"  golden image   crc={info['crc']:08X} app_start=0x{info['app_start']:05X} "
+              f"rows={info['rows']} stored={info['length']} bytes ({ratio} of the rows)")
+    else:
+        print("  golden image   none saved")
+    print(f"  failed boots   {info['fail_streak']} in a row (restore at {info['fail_limit']})"
+          f"{', restore tried' if info['restored'] else ''}")
+    print(f"  restores       {info['restores']} since power-up")
+
+
+def _get_version_once(port: str | None, settle_s: float = 0.5) -> tuple[str | None, dict]:
+    uploader = BootloaderUploader(port=port, settle_s=settle_s)
+    if not uploader.connect():
+        return None, {}
+    try:
+        version = uploader.get_version()
+        status = (uploader.get_status() or {}) if version else {}
+        return version, status
+    finally:
+        uploader.disconnect()
+
+
+def get_status_with_retry(port: str | None, timeout_s: float = 3.0, poll_s: float = 0.3,
+                          settle_s: float = 0.5) -> tuple[str | None, dict]:
+    """Try to connect and read version + status for up to timeout_s.
+
+    Returns (None, {}) if unreachable; the status is {} for bootloaders
+    without 'S'.
+    """
     deadline = time.time() + timeout_s
-    last = None
+    last = (None, {})
     while time.time() < deadline:
-        last = _get_version_once(port)
-        if last:
+        last = _get_version_once(port, settle_s)
+        if last[0]:
             return last
         time.sleep(poll_s)
     return last
 
 
+def get_version_with_retry(port: str | None, timeout_s: float = 3.0, poll_s: float = 0.3,
+                           settle_s: float = 0.5) -> str | None:
+    """Try to connect+read version for up to timeout_s. Returns None if unreachable."""
+    return get_status_with_retry(port, timeout_s, poll_s, settle_s)[0]
+
+
 def ralph_loop(
     *,
     port: str | None,
@@ -342,7 +1834,11 @@ def ralph_loop(
         if not hexfile.exists():
             print(f"ERROR: File not found: {hexfile}")
             return 1
-        records = parse_hex_file(hexfile)
+        try:
+            records = parse_hex_file(hexfile)
+        except ValueError as e:
+            print(f"ERROR: {e}")
+            return 1
         if not records:
             print("ERROR: No valid records in HEX file")
             return 1
@@ -366,18 +1862,20 @@ def ralph_loop(
                 "pre_rc",
                 "post_rc",
                 "note",
+                "reenum_ms",
             ],
         )
         if csv_file.tell() == 0:
             writer.writeheader()
 
+    watcher = DeviceWatcher(port=port)
     exit_code = 0
     try:
         for i in range(1, iterations + 1):
             ts = datetime.now().isoformat(timespec="seconds")
             print(f"\n--- Ralph loop {i}/{iterations} ---")
 
-            pre_version = get_version_with_retry(port, timeout_s=3.0)
+            pre_version, pre_status = get_status_with_retry(port, timeout_s=3.0)
             if pre_version:
                 print(f"Pre:  {pre_version}")
             else:
@@ -395,22 +1893,16 @@ def ralph_loop(
                 if not ok:
                     exit_code = 1
                     note = "upload_failed"
-                    post_version = get_version_with_retry(port, timeout_s=3.0)
+                    post_version, post_status = get_status_with_retry(port, timeout_s=3.0)
                     if writer:
-                        pre_fields = _parse_version_fields(pre_version or "")
-                        post_fields = _parse_version_fields(post_version or "")
                         writer.writerow(
                             {
                                 "ts": ts,
                                 "iter": i,
                                 "pre_version": pre_version or "",
                                 "post_version": post_version or "",
-                                "pre_sj": pre_fields.get("sj", ""),
-                                "post_sj": post_fields.get("sj", ""),
-                                "pre_jrc": pre_fields.get("jrc", ""),
-                                "post_jrc": post_fields.get("jrc", ""),
-                                "pre_rc": pre_fields.get("rc", ""),
-                                "post_rc": post_fields.get("rc", ""),
+                                **_loop_columns("pre", pre_status),
+                                **_loop_columns("post", post_status),
                                 "note": note,
                             }
                         )
@@ -426,9 +1918,18 @@ def ralph_loop(
                 else:
                     print("Jump: (bootloader not reachable; skipping jump)")
 
-            time.sleep(max(0.0, after_jump_delay_s))
+            # Wait for the detach (at most after_jump_delay_s) and the
+            # re-enumeration instead of sleeping a fixed time.
+            reenum = None
+            gone = watcher.wait(False, max(0.0, after_jump_delay_s))
+            if gone is not None:
+                back = watcher.wait(True, 2.0)
+                if back is not None:
+                    reenum = gone + back
+                    print(f"Re-enumerated in {reenum * 1000:.0f} ms")
 
-            post_version = get_version_with_retry(port, timeout_s=2.0)
+            post_version, post_status = get_status_with_retry(
+                port, timeout_s=2.0, poll_s=0.05, settle_s=0.0 if reenum is not None else 0.5)
             note = ""
             if post_version:
                 print(f"Post: {post_version}")
@@ -439,8 +1940,6 @@ def ralph_loop(
                 note = "bootloader_gone"
 
             if writer:
-                pre_fields = _parse_version_fields(pre_version or "")
-                post_fields = _parse_version_fields(post_version or "")
                 if did_upload:
                     note = (note + ";uploaded").lstrip(";")
                 writer.writerow(
@@ -449,13 +1948,10 @@ def ralph_loop(
                         "iter": i,
                         "pre_version": pre_version or "",
                         "post_version": post_version or "",
-                        "pre_sj": pre_fields.get("sj", ""),
-                        "post_sj": post_fields.get("sj", ""),
-                        "pre_jrc": pre_fields.get("jrc", ""),
-                        "post_jrc": post_fields.get("jrc", ""),
-                        "pre_rc": pre_fields.get("rc", ""),
-                        "post_rc": post_fields.get("rc", ""),
+                        **_loop_columns("pre", pre_status),
+                        **_loop_columns("post", post_status),
                         "note": note,
+                        "reenum_ms": round(reenum * 1000.0, 1) if reenum is not None else "",
                     }
                 )
 
@@ -476,11 +1972,21 @@ Examples:
   python upload_firmware.py firmware.hex
   python upload_firmware.py firmware.hex --port COM5
   python upload_firmware.py firmware.hex --no-jump
+  python upload_firmware.py firmware.hex --touch     # app running, no button press
+  python upload_firmware.py firmware.hex --bench 5 --bench-out bench.csv
+  python upload_firmware.py firmware.hex --fleet     # every bootloader port at once
+  python upload_firmware.py --port COM5 --bench-link # raw CDC throughput ceiling
 
   # Control-only (no erase/upload):
   python upload_firmware.py --port COM5 --version-only
   python upload_firmware.py --port COM5 --jump-only
   python upload_firmware.py --port COM5 --reset-only
+  python upload_firmware.py --port COM5 --profile    # time per code section
+  python upload_firmware.py --port COM5 --boot-log   # last 15 boots
+  python upload_firmware.py --port COM5 --status     # decoded status record
+  python upload_firmware.py --port COM5 --stage-info # staging store slots
+  python upload_firmware.py --port COM5 --rollback   # reinstall the previous staged image
+  python upload_firmware.py --port COM5 --golden-save # keep the current app for recovery
         """
     )
 
@@ -488,6 +1994,8 @@ Examples:
                         help='Intel HEX file to upload (omit when using --*-only commands)')
     parser.add_argument('--port', '-p', type=str, default=None,
                         help='COM port (auto-detect if not specified)')
+    parser.add_argument('--serial', type=str, default=None,
+                        help='Select the device by USB serial number instead of --port')
 
     action_group = parser.add_mutually_exclusive_group()
     action_group.add_argument('--version-only', action='store_true',
@@ -496,6 +2004,22 @@ Examples:
                               help='Only command the bootloader to jump to the application, then exit')
     action_group.add_argument('--reset-only', action='store_true',
                               help='Only command the bootloader to reset the device, then exit')
+    action_group.add_argument('--profile', action='store_true',
+                              help='Print the section profiler time breakdown (since the last upload), then exit')
+    action_group.add_argument('--status', action='store_true',
+                              help='Print the decoded status record (memory map, diagnostics, app faults), then exit')
+    action_group.add_argument('--boot-log', action='store_true',
+                              help='Print the boot event log (reset cause, path, app stage, time), then exit')
+    action_group.add_argument('--stage-info', action='store_true',
+                              help='Print the SPI NOR staging store slots, then exit')
+    action_group.add_argument('--rollback', action='store_true',
+                              help='Install the previous image from the staging store, then jump (unless --no-jump)')
+    action_group.add_argument('--golden-info', action='store_true',
+                              help='Print the golden (recovery) image and the failed-boot count, then exit')
+    action_group.add_argument('--golden-save', action='store_true',
+                              help='Save the application in flash as the golden image restored after repeated failed boots')
+    action_group.add_argument('--golden-restore', action='store_true',
+                              help='Restore the golden image now, then jump (unless --no-jump)')
 
     parser.add_argument('--no-verify', action='store_true',
                         help='Skip verification after upload')
@@ -503,6 +2027,43 @@ Examples:
                         help='Do not jump to application after upload')
     parser.add_argument('--reset', action='store_true',
                         help='Reset device instead of jumping to app (after upload)')
+    parser.add_argument('--mode', choices=('auto',) + UPLOAD_MODES, default='auto',
+                        help='Data transfer mode: basic (file records, one at a time), packed '
+                             '(longest records the device takes), windowed (packed and pipelined). '
+                             'Default: fastest the bootloader advertises')
+    parser.add_argument('--stage', action='store_true',
+                        help='Upload into the SPI NOR staging store, check its CRC there, then install')
+    parser.add_argument('--patch', action='store_true',
+                        help='Update in place: patch instructions that only clear bits, rewrite '
+                             'only the pages with other changes')
+    parser.add_argument('--delta', action='store_true',
+                        help='Update in place with delta pages: rebuild each changed page on the device '
+                             'from its current flash plus the bytes that are new')
+    parser.add_argument('--base', type=Path, default=None,
+                        help='With --delta: HEX file the device was last given, so fewer rows are read back')
+    parser.add_argument('--strip-data', action='store_true',
+                        help="Drop image content in the device's preserved application data "
+                             "instead of refusing the image")
+    parser.add_argument('--touch', action='store_true',
+                        help=f'Reset a running app into the bootloader first ({TOUCH_BAUD} baud touch)')
+
+    # Throughput benchmark
+    parser.add_argument('--bench', type=int, default=0, metavar='N',
+                        help='Upload N times and report phase timing, record latency and B/s')
+    parser.add_argument('--bench-out', type=Path, default=None,
+                        help='Write --bench/--bench-link results to a .json file or append rows to a CSV file')
+    parser.add_argument('--bench-link', action='store_true',
+                        help='Measure raw CDC sink/source/echo throughput (no flash, no parser), then exit')
+    parser.add_argument('--bench-link-bytes', type=int, default=65536,
+                        help='Bytes per --bench-link transfer')
+
+    # Multi-device flashing
+    parser.add_argument('--fleet', action='store_true',
+                        help='Upload to every detected bootloader port concurrently')
+    parser.add_argument('--ports', type=str, default=None,
+                        help='In --fleet mode: comma-separated ports instead of auto-detect')
+    parser.add_argument('--retries', type=int, default=2,
+                        help='In --fleet mode: extra attempts per device after a failure')
 
     # Rapid iteration mode
     parser.add_argument('--ralph-loop', type=int, default=0,
@@ -510,7 +2071,7 @@ Examples:
     parser.add_argument('--loop-upload', choices=['once', 'each'], default='once',
                         help='In --ralph-loop mode: upload once (first iter) or each iteration')
     parser.add_argument('--after-jump-delay', type=float, default=0.5,
-                        help='Seconds to wait after jump before post-version probe')
+                        help='Max seconds to wait for the device to detach after jump')
     parser.add_argument('--between-iter-delay', type=float, default=0.5,
                         help='Seconds to wait between iterations')
     parser.add_argument('--log-csv', type=Path, default=None,
@@ -518,8 +2079,26 @@ Examples:
 
     args = parser.parse_args()
 
-    if args.ralph_loop > 0 and (args.version_only or args.jump_only or args.reset_only):
-        parser.error("--ralph-loop cannot be combined with --version-only/--jump-only/--reset-only")
+    control_only = (args.version_only or args.jump_only or args.reset_only or
+                    args.profile or args.boot_log or args.status or
+                    args.stage_info or args.rollback or
+                    args.golden_info or args.golden_save or args.golden_restore)
+    if args.ralph_loop > 0 and control_only:
+        parser.error("--ralph-loop cannot be combined with control-only options")
+
+    if args.serial and args.port is None:
+        args.port = DeviceWatcher(serial_number=args.serial).find()
+        if args.port is None:
+            print(f"ERROR: No device with serial number {args.serial}")
+            sys.exit(1)
+
+    if args.touch:
+        args.port = touch_into_bootloader(args.port)
+        if args.port is None:
+            sys.exit(1)
+
+    if args.bench_link:
+        sys.exit(0 if bench_link(args.port, args.bench_link_bytes, args.bench_out) else 1)
 
     if args.ralph_loop > 0:
         # In loop mode, hexfile is optional (if omitted, this becomes a jump-only loop).
@@ -536,7 +2115,7 @@ Examples:
         sys.exit(exit_code)
 
     # Control-only actions: no HEX required
-    if args.version_only or args.jump_only or args.reset_only:
+    if control_only:
         uploader = BootloaderUploader(port=args.port)
         if not uploader.connect():
             sys.exit(1)
@@ -549,6 +2128,68 @@ Examples:
                 print(version)
                 sys.exit(0)
 
+            if args.profile:
+                profile = uploader.get_profile()
+                if profile is None:
+                    print("ERROR: Failed to read profile (bootloader without 'P'?)")
+                    sys.exit(1)
+                print_profile(profile)
+                sys.exit(0)
+
+            if args.status:
+                status = uploader.get_status()
+                if status is None:
+                    print("ERROR: Failed to read status (bootloader without 'S'?)")
+                    sys.exit(1)
+                print_status(status)
+                sys.exit(0)
+
+            if args.boot_log:
+                events = uploader.get_boot_log()
+                if events is None:
+                    print("ERROR: Failed to read boot log (bootloader without 'H'?)")
+                    sys.exit(1)
+                print_boot_log(events)
+                sys.exit(0)
+
+            if args.stage_info:
+                info = uploader.get_stage_info()
+                if info is None:
+                    print("ERROR: Failed to read staging store (bootloader without 'T'?)")
+                    sys.exit(1)
+                print_stage_info(info)
+                sys.exit(0)
+
+            if args.rollback:
+                if not uploader.stage_command("TR", "Rolling back", 30.0):
+                    sys.exit(1)
+                if not args.no_jump:
+                    uploader.jump_to_app()
+                sys.exit(0)
+
+            if args.golden_info:
+                info = uploader.get_golden_info()
+                if info is None:
+                    print("ERROR: Failed to read golden image info (bootloader without 'G'?)")
+                    sys.exit(1)
+                print_golden_info(info)
+                sys.exit(0)
+
+            if args.golden_save:
+                if not uploader.stage_command("GS", "Saving golden image", 60.0):
+                    sys.exit(1)
+                info = uploader.get_golden_info()
+                if info is not None:
+                    print_golden_info(info)
+                sys.exit(0)
+
+            if args.golden_restore:
+                if not uploader.stage_command("GR", "Restoring golden image", 30.0):
+                    sys.exit(1)
+                if not args.no_jump:
+                    uploader.jump_to_app()
+                sys.exit(0)
+
             if args.jump_only:
                 if uploader.jump_to_app():
                     sys.exit(0)
@@ -565,13 +2206,66 @@ Examples:
 
     # Normal upload path requires a HEX file
     if args.hexfile is None:
-        parser.error("hexfile is required unless using --version-only/--jump-only/--reset-only")
+        parser.error("hexfile is required unless using a control-only option (--version-only, --profile, ...)")
+
+    if args.fleet:
+        ports = [p.strip() for p in args.ports.split(",") if p.strip()] if args.ports else None
+        success = fleet_upload(
+            hexfile=args.hexfile,
+            ports=ports,
+            verify=not args.no_verify,
+            jump_to_app=not args.no_jump and not args.reset,
+            retries=args.retries,
+            strip=args.strip_data,
+            mode=args.mode,
+        )
+        sys.exit(0 if success else 1)
+
+    if args.bench > 0:
+        runs = []
+        for i in range(args.bench):
+            run = UploadBench()
+            runs.append(run)
+            upload_firmware(
+                hexfile=args.hexfile,
+                port=args.port,
+                verify=not args.no_verify,
+                jump_to_app=not args.no_jump and not args.reset,
+                bench=run,
+                mode=args.mode,
+            )
+            if not run.ok:
+                break
+            if i + 1 < args.bench and not args.no_jump:
+                # The app owns the port now; bring the bootloader back
+                args.port = touch_into_bootloader(args.port)
+                if args.port is None:
+                    break
+        print_bench(runs)
+        if args.bench_out is not None:
+            write_bench(args.bench_out, runs, args.port, args.hexfile)
+            print(f"Results written to {args.bench_out}")
+        sys.exit(0 if runs and all(run.ok for run in runs) else 1)
+
+    if args.patch or args.delta:
+        success = patch_firmware(
+            hexfile=args.hexfile,
+            port=args.port,
+            jump_to_app=not args.no_jump and not args.reset,
+            strip=args.strip_data,
+            delta=args.delta,
+            base=args.base,
+        )
+        sys.exit(0 if success else 1)
 
     success = upload_firmware(
         hexfile=args.hexfile,
         port=args.port,
         verify=not args.no_verify,
-        jump_to_app=not args.no_jump and not args.reset
+        jump_to_app=not args.no_jump and not args.reset,
+        mode=args.mode,
+        stage=args.stage,
+        strip=args.strip_data,
     )
 
     sys.exit(0 if success else 1)